@@ -38,6 +38,8 @@ static const struct debug_named_value debug_control[] = {
      "Dump descriptor set and pipeline layouts." },
    { "info", PVR_DEBUG_INFO,
      "Display information about the driver and device." },
+   { "hw_pass", PVR_DEBUG_HW_PASS,
+     "Report how render pass subpasses are merged into HW renders." },
    DEBUG_NAMED_VALUE_END
 };
 /* clang-format on */
@@ -38,6 +38,7 @@ extern uint32_t PVR_DEBUG;
 #define PVR_DEBUG_TRACK_BOS BITFIELD_BIT(1)
 #define PVR_DEBUG_VK_DUMP_DESCRIPTOR_SET_LAYOUT BITFIELD_BIT(2)
 #define PVR_DEBUG_INFO BITFIELD_BIT(3)
+#define PVR_DEBUG_HW_PASS BITFIELD_BIT(4)
 
 void pvr_process_debug_variable(void);
 
@@ -0,0 +1,169 @@
+/*
+ * Copyright © 2024 Imagination Technologies Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pvr_twiddle.h"
+#include "util/macros.h"
+#include "util/u_math.h"
+
+void pvr_twiddle_layout_init(struct pvr_twiddle_layout *layout,
+                             uint32_t width,
+                             uint32_t height,
+                             uint32_t depth)
+{
+   const uint32_t x_bits = util_logbase2(width);
+   const uint32_t y_bits = util_logbase2(height);
+   const uint32_t z_bits = util_logbase2(depth);
+   uint32_t bit = 0;
+
+   assert(util_is_power_of_two_nonzero(width));
+   assert(util_is_power_of_two_nonzero(height));
+   assert(util_is_power_of_two_nonzero(depth));
+
+   memset(layout, 0, sizeof(*layout));
+
+   for (uint32_t i = 0; i < MAX3(x_bits, y_bits, z_bits); i++) {
+      if (i < y_bits)
+         layout->mask_y |= BITFIELD64_BIT(bit++);
+
+      if (i < x_bits)
+         layout->mask_x |= BITFIELD64_BIT(bit++);
+
+      if (i < z_bits)
+         layout->mask_z |= BITFIELD64_BIT(bit++);
+   }
+}
+
+/* Scatters the bits of value into the set bits of mask, lowest first. */
+static inline uint64_t pvr_twiddle_deposit(uint32_t value, uint64_t mask)
+{
+   uint64_t result = 0;
+
+   for (uint32_t i = 0; mask; i++) {
+      const uint64_t lowest = mask & -mask;
+
+      if (value & BITFIELD_BIT(i))
+         result |= lowest;
+
+      mask &= mask - 1;
+   }
+
+   return result;
+}
+
+/* Returns the deposited form of the coordinate following the one deposited in
+ * value, without having to deposit it from scratch: filling the gaps in
+ * between the mask bits with ones lets the carry of the addition ripple
+ * through them.
+ */
+static inline uint64_t pvr_twiddle_next(uint64_t value, uint64_t mask)
+{
+   return ((value | ~mask) + 1) & mask;
+}
+
+uint64_t pvr_twiddle_index(const struct pvr_twiddle_layout *layout,
+                           uint32_t x,
+                           uint32_t y,
+                           uint32_t z)
+{
+   return pvr_twiddle_deposit(x, layout->mask_x) |
+          pvr_twiddle_deposit(y, layout->mask_y) |
+          pvr_twiddle_deposit(z, layout->mask_z);
+}
+
+/* Walks the region in linear order while stepping the twiddled coordinates
+ * incrementally. It's always inlined with a constant cpp so the per element
+ * memcpy() becomes a single load/store (vector load/store for 16 bytes).
+ */
+static ALWAYS_INLINE void
+pvr_twiddle_copy(const struct pvr_twiddle_layout *layout,
+                 const struct pvr_twiddle_region *region,
+                 uint8_t *twiddled,
+                 uint8_t *linear,
+                 const uint32_t cpp,
+                 const bool store)
+{
+   const uint64_t tx_start = pvr_twiddle_deposit(region->x, layout->mask_x);
+   uint64_t tz = pvr_twiddle_deposit(region->z, layout->mask_z);
+
+   for (uint32_t z = 0; z < region->depth; z++) {
+      uint64_t ty = pvr_twiddle_deposit(region->y, layout->mask_y);
+
+      for (uint32_t y = 0; y < region->height; y++) {
+         uint8_t *row =
+            linear + z * region->slice_pitch + y * region->row_pitch;
+         const uint64_t tyz = ty | tz;
+         uint64_t tx = tx_start;
+
+         for (uint32_t x = 0; x < region->width; x++) {
+            uint8_t *const element = twiddled + (tx | tyz) * cpp;
+
+            if (store)
+               memcpy(element, row, cpp);
+            else
+               memcpy(row, element, cpp);
+
+            row += cpp;
+            tx = pvr_twiddle_next(tx, layout->mask_x);
+         }
+
+         ty = pvr_twiddle_next(ty, layout->mask_y);
+      }
+
+      tz = pvr_twiddle_next(tz, layout->mask_z);
+   }
+}
+
+/* Always inlined with a constant store, so each direction gets its own set of
+ * per cpp loops.
+ */
+static ALWAYS_INLINE void
+pvr_twiddle_copy_cpp(const struct pvr_twiddle_layout *layout,
+                     const struct pvr_twiddle_region *region,
+                     uint8_t *twiddled,
+                     uint8_t *linear,
+                     const bool store)
+{
+   switch (region->cpp) {
+#define CASE(_cpp)                                                      \
+   case _cpp:                                                           \
+      pvr_twiddle_copy(layout, region, twiddled, linear, _cpp, store); \
+      break;
+
+      CASE(1)
+      CASE(2)
+      CASE(4)
+      CASE(8)
+      CASE(16)
+
+#undef CASE
+
+   default:
+      pvr_twiddle_copy(layout, region, twiddled, linear, region->cpp, store);
+      break;
+   }
+}
+
+void pvr_twiddle_store(const struct pvr_twiddle_layout *layout,
+                       const struct pvr_twiddle_region *region,
+                       void *twiddled,
+                       const void *linear)
+{
+   pvr_twiddle_copy_cpp(layout, region, twiddled, (uint8_t *)linear, true);
+}
+
+void pvr_twiddle_load(const struct pvr_twiddle_layout *layout,
+                      const struct pvr_twiddle_region *region,
+                      void *linear,
+                      const void *twiddled)
+{
+   pvr_twiddle_copy_cpp(layout, region, (uint8_t *)twiddled, linear, false);
+}
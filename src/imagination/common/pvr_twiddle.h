@@ -0,0 +1,106 @@
+/*
+ * Copyright © 2024 Imagination Technologies Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef PVR_TWIDDLE_H
+#define PVR_TWIDDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \file pvr_twiddle.h
+ *
+ * \brief CPU conversion between linear and twiddled surface layouts.
+ *
+ * Twiddled surfaces store texels (or compressed blocks) in Morton order: the
+ * bits of the coordinates are interleaved, starting with y in the least
+ * significant bit, then x, then z for 3D twiddling. Once the smaller
+ * dimensions have run out of bits the remaining bits of the larger ones are
+ * used in the same order, so non-square power of two surfaces are laid out as
+ * a linear sequence of square twiddled blocks.
+ */
+
+/* Precomputed per-axis bit masks of the twiddled index. */
+struct pvr_twiddle_layout {
+   uint64_t mask_x;
+   uint64_t mask_y;
+   uint64_t mask_z;
+};
+
+/**
+ * \brief Initializes the twiddle masks for a surface.
+ *
+ * \param[out] layout Layout to initialize.
+ * \param[in]  width  Power of two width of the surface.
+ * \param[in]  height Power of two height of the surface.
+ * \param[in]  depth  Power of two depth for 3D twiddling, 1 otherwise.
+ */
+void pvr_twiddle_layout_init(struct pvr_twiddle_layout *layout,
+                             uint32_t width,
+                             uint32_t height,
+                             uint32_t depth);
+
+/**
+ * \brief Returns the twiddled index of an element.
+ *
+ * \param[in] layout Surface layout.
+ * \param[in] x      X coordinate.
+ * \param[in] y      Y coordinate.
+ * \param[in] z      Z coordinate, 0 for 2D twiddling.
+ * \return Index of the element in the twiddled surface.
+ */
+uint64_t pvr_twiddle_index(const struct pvr_twiddle_layout *layout,
+                           uint32_t x,
+                           uint32_t y,
+                           uint32_t z);
+
+/* Region of a twiddled surface to convert to or from a linear copy. */
+struct pvr_twiddle_region {
+   /* Element size in bytes, any of 1, 2, 4, 8 or 16 (or e.g. 3 or 6, which
+    * take a slower path).
+    */
+   uint32_t cpp;
+
+   /* Region of the twiddled surface in elements. */
+   uint32_t x;
+   uint32_t y;
+   uint32_t z;
+   uint32_t width;
+   uint32_t height;
+   uint32_t depth;
+
+   /* Pitches of the linear copy in bytes. */
+   size_t row_pitch;
+   size_t slice_pitch;
+};
+
+/**
+ * \brief Writes a linear region into a twiddled surface.
+ *
+ * \param[in]  layout   Layout of the twiddled surface.
+ * \param[in]  region   Region to write.
+ * \param[out] twiddled Start of the twiddled surface.
+ * \param[in]  linear   Start of the linear data of the region.
+ */
+void pvr_twiddle_store(const struct pvr_twiddle_layout *layout,
+                       const struct pvr_twiddle_region *region,
+                       void *twiddled,
+                       const void *linear);
+
+/**
+ * \brief Reads a region of a twiddled surface into linear memory.
+ *
+ * \param[in]  layout   Layout of the twiddled surface.
+ * \param[in]  region   Region to read.
+ * \param[out] linear   Start of the linear destination of the region.
+ * \param[in]  twiddled Start of the twiddled surface.
+ */
+void pvr_twiddle_load(const struct pvr_twiddle_layout *layout,
+                      const struct pvr_twiddle_region *region,
+                      void *linear,
+                      const void *twiddled);
+
+#endif /* PVR_TWIDDLE_H */
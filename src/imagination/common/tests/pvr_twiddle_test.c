@@ -0,0 +1,182 @@
+/*
+ * Copyright © 2024 Imagination Technologies Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Round trips regions through pvr_twiddle_store() and pvr_twiddle_load() for
+ * each element size, checking the twiddled copy against pvr_twiddle_index().
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pvr_twiddle.h"
+#include "util/macros.h"
+
+struct pvr_twiddle_test {
+   uint32_t width;
+   uint32_t height;
+   uint32_t depth;
+
+   /* Region of the surface to round trip, zero sized for all of it. */
+   uint32_t x;
+   uint32_t y;
+   uint32_t z;
+   uint32_t region_width;
+   uint32_t region_height;
+   uint32_t region_depth;
+
+   /* Bytes of padding after each linear row and slice. */
+   uint32_t row_padding;
+   uint32_t slice_padding;
+};
+
+static const struct pvr_twiddle_test tests[] = {
+   { .width = 1, .height = 1, .depth = 1 },
+   { .width = 64, .height = 64, .depth = 1 },
+   { .width = 32, .height = 4, .depth = 1 },
+   { .width = 2, .height = 128, .depth = 1 },
+   { .width = 16, .height = 8, .depth = 4 },
+   {
+      .width = 32,
+      .height = 32,
+      .depth = 1,
+      .x = 3,
+      .y = 5,
+      .region_width = 17,
+      .region_height = 9,
+      .region_depth = 1,
+      .row_padding = 5,
+   },
+   {
+      .width = 8,
+      .height = 16,
+      .depth = 8,
+      .x = 1,
+      .y = 2,
+      .z = 3,
+      .region_width = 6,
+      .region_height = 11,
+      .region_depth = 4,
+      .row_padding = 3,
+      .slice_padding = 16,
+   },
+};
+
+/* 3 and 6 byte elements take the generic path. */
+static const uint32_t cpps[] = { 1, 2, 3, 4, 6, 8, 16 };
+
+static bool run_test(const struct pvr_twiddle_test *test, uint32_t cpp)
+{
+   const uint64_t nr_elements =
+      (uint64_t)test->width * test->height * test->depth;
+   struct pvr_twiddle_region region = {
+      .cpp = cpp,
+      .x = test->x,
+      .y = test->y,
+      .z = test->z,
+      .width = test->region_width ? test->region_width : test->width,
+      .height = test->region_height ? test->region_height : test->height,
+      .depth = test->region_depth ? test->region_depth : test->depth,
+   };
+   struct pvr_twiddle_layout layout;
+   uint8_t *twiddled;
+   uint8_t *linear;
+   uint8_t *result;
+   size_t linear_size;
+   bool ret = true;
+
+   region.row_pitch = region.width * cpp + test->row_padding;
+   region.slice_pitch = region.height * region.row_pitch + test->slice_padding;
+   linear_size = region.depth * region.slice_pitch;
+
+   twiddled = calloc(nr_elements, cpp);
+   linear = malloc(linear_size);
+   result = calloc(linear_size, 1);
+   if (!twiddled || !linear || !result) {
+      ret = false;
+      goto out_free;
+   }
+
+   for (size_t i = 0; i < linear_size; i++)
+      linear[i] = (uint8_t)(i * 7 + i / 251 + 1);
+
+   pvr_twiddle_layout_init(&layout, test->width, test->height, test->depth);
+   pvr_twiddle_store(&layout, &region, twiddled, linear);
+
+   for (uint32_t z = 0; z < region.depth; z++) {
+      for (uint32_t y = 0; y < region.height; y++) {
+         for (uint32_t x = 0; x < region.width; x++) {
+            const uint64_t index = pvr_twiddle_index(&layout,
+                                                     region.x + x,
+                                                     region.y + y,
+                                                     region.z + z);
+            const size_t offset =
+               z * region.slice_pitch + y * region.row_pitch + x * cpp;
+
+            if (memcmp(&twiddled[index * cpp], &linear[offset], cpp)) {
+               printf("  element (%u, %u, %u) stored at the wrong index\n",
+                      region.x + x,
+                      region.y + y,
+                      region.z + z);
+               ret = false;
+               goto out_free;
+            }
+         }
+      }
+   }
+
+   pvr_twiddle_load(&layout, &region, result, twiddled);
+
+   /* Padding is left alone, so compare the rows only. */
+   for (uint32_t z = 0; z < region.depth; z++) {
+      for (uint32_t y = 0; y < region.height; y++) {
+         const size_t offset = z * region.slice_pitch + y * region.row_pitch;
+
+         if (memcmp(&result[offset], &linear[offset], region.width * cpp)) {
+            printf("  row (%u, %u) differs after loading\n",
+                   region.y + y,
+                   region.z + z);
+            ret = false;
+            goto out_free;
+         }
+      }
+   }
+
+out_free:
+   free(result);
+   free(linear);
+   free(twiddled);
+
+   return ret;
+}
+
+int main(void)
+{
+   int retval = 0;
+
+   for (uint32_t i = 0; i < ARRAY_SIZE(tests); i++) {
+      const struct pvr_twiddle_test *const test = &tests[i];
+
+      for (uint32_t j = 0; j < ARRAY_SIZE(cpps); j++) {
+         const bool pass = run_test(test, cpps[j]);
+
+         printf("%s %" PRIu32 "x%" PRIu32 "x%" PRIu32 " cpp %" PRIu32 "\n",
+                pass ? "PASS" : "FAIL",
+                test->width,
+                test->height,
+                test->depth,
+                cpps[j]);
+
+         if (!pass)
+            retval = 1;
+      }
+   }
+
+   return retval;
+}
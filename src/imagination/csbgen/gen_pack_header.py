@@ -418,6 +418,56 @@ class Struct(Node):
 
         print("}\n")
 
+    def _emit_repack_functions(self, root: Csbgen) -> None:
+        # Fields can only be repacked by name if the name is unique, which
+        # isn't the case for fields redefined across condition branches.
+        names = [f.name for f in self.fields]
+
+        for field in self.fields:
+            if names.count(field.name) > 1:
+                continue
+
+            index = field.start // 32
+            dword_start = index * 32
+            start = field.start - dword_start
+            end = field.end - dword_start
+
+            # Only fields within a 64 bit word are handled.
+            if end >= 64:
+                continue
+
+            if field.type in ("uint", "bool") or root.is_known_enum(field.type):
+                value = "__pvr_uint(value, %d, %d)" % (start, end)
+            elif field.type == "int":
+                value = "__pvr_sint(value, %d, %d)" % (start, end)
+            elif field.type == "offset":
+                value = "__pvr_offset(value, %d, %d)" % (start, end)
+            elif field.type == "address":
+                value = "__pvr_address(value, %d, %d, %d)" % (field.shift, start, end)
+            elif field.type == "float" and start == 0 and end == 31:
+                value = "__pvr_float(value)"
+            else:
+                continue
+
+            name = "%s_%s_repack" % (self.full_name, field.name)
+            print(textwrap.dedent("""\
+                static inline __attribute__((always_inline)) void
+                %s(void * restrict dst,
+                %s %s value)
+                {""") % (name, " " * len(name), field._get_c_type(root)))
+            print("    uint32_t * restrict dw = (uint32_t * restrict) dst;")
+            print("    const uint64_t mask = __pvr_mbo(%d, %d);" % (start, end))
+
+            if end < 32:
+                print("    dw[%d] = (dw[%d] & ~mask) | %s;" % (index, index, value))
+            else:
+                print("    const uint64_t v = ((uint64_t)dw[%d] << 32) | dw[%d];" % (index + 1, index))
+                print("    const uint64_t packed = (v & ~mask) | %s;" % value)
+                print("    dw[%d] = packed;" % index)
+                print("    dw[%d] = packed >> 32;" % (index + 1))
+
+            print("}\n")
+
     def emit(self, root: Csbgen) -> None:
         print("#define %-33s %6d" % (self.full_name + "_length", self.length))
 
@@ -432,6 +482,7 @@ class Struct(Node):
 
         self._emit_pack_function(root)
         self._emit_unpack_function(root)
+        self._emit_repack_functions(root)
 
 
 class Stream(Node):
@@ -154,6 +154,11 @@ pco_func *pco_func_create(pco_shader *shader,
 
    list_inithead(&func->body);
 
+   /* The function's IR is only ever freed along with the function (deleted
+    * instructions are just unlinked), so allocate it linearly.
+    */
+   func->lin_ctx = linear_context(func);
+
    func->num_params = num_params;
    if (num_params) {
       func->params =
@@ -175,7 +180,7 @@ pco_func *pco_func_create(pco_shader *shader,
  */
 pco_block *pco_block_create(pco_func *func)
 {
-   pco_block *block = rzalloc_size(func, sizeof(*block));
+   pco_block *block = linear_zalloc(func->lin_ctx, pco_block);
 
    init_cf_node(&block->cf_node, PCO_CF_NODE_TYPE_BLOCK);
    block->parent_func = func;
@@ -193,7 +198,7 @@ pco_block *pco_block_create(pco_func *func)
  */
 pco_if *pco_if_create(pco_func *func)
 {
-   pco_if *pif = rzalloc_size(func, sizeof(*pif));
+   pco_if *pif = linear_zalloc(func->lin_ctx, pco_if);
 
    init_cf_node(&pif->cf_node, PCO_CF_NODE_TYPE_IF);
    pif->parent_func = func;
@@ -212,7 +217,7 @@ pco_if *pco_if_create(pco_func *func)
  */
 pco_loop *pco_loop_create(pco_func *func)
 {
-   pco_loop *loop = rzalloc_size(func, sizeof(*loop));
+   pco_loop *loop = linear_zalloc(func->lin_ctx, pco_loop);
 
    init_cf_node(&loop->cf_node, PCO_CF_NODE_TYPE_LOOP);
    loop->parent_func = func;
@@ -241,7 +246,7 @@ pco_instr *pco_instr_create(pco_func *func,
    size += num_dests * sizeof(*instr->dest);
    size += num_srcs * sizeof(*instr->src);
 
-   instr = rzalloc_size(func, size);
+   instr = linear_zalloc_child(func->lin_ctx, size);
 
    instr->parent_func = func;
 
@@ -268,7 +273,7 @@ pco_instr *pco_instr_create(pco_func *func,
  */
 pco_igrp *pco_igrp_create(pco_func *func)
 {
-   pco_igrp *igrp = rzalloc_size(func, sizeof(*igrp));
+   pco_igrp *igrp = linear_zalloc(func->lin_ctx, pco_igrp);
 
    igrp->parent_func = func;
    igrp->index = func->next_igrp++;
@@ -279,12 +284,13 @@ pco_igrp *pco_igrp_create(pco_func *func)
 /**
  * \brief Deletes a PCO instruction.
  *
+ * The instruction's memory is released along with its parent function.
+ *
  * \param[in,out] instr PCO instruction.
  */
 void pco_instr_delete(pco_instr *instr)
 {
    list_del(&instr->link);
-   ralloc_free(instr);
 }
 
 /**
@@ -86,6 +86,14 @@ typedef struct _pco_common_data {
 
    unsigned entry_offset; /** Offset of the shader entrypoint. */
 
+   /** Shared registers written by the preamble. */
+   struct {
+      unsigned start; /** First shared register available to the preamble. */
+      unsigned max; /** Max shared registers the preamble may use. */
+      unsigned count; /** Shared registers used by the preamble. */
+      unsigned temps; /** Temps used by the preamble. */
+   } preamble;
+
    struct {
       bool atomics; /** Whether the shader uses atomics. */
       bool barriers; /** Whether the shader uses barriers. */
@@ -25,6 +25,23 @@
  */
 bool pco_end(pco_shader *shader)
 {
+   /* The preamble runs as its own (shared register update) task, so it needs
+    * to be terminated separately.
+    */
+   pco_func *preamble = pco_preamble(shader);
+   if (preamble) {
+      pco_block *last_block = pco_func_last_block(preamble);
+      pco_instr *last_instr = pco_last_instr(last_block);
+
+      if (last_instr && pco_instr_has_end(last_instr)) {
+         pco_instr_set_end(last_instr, true);
+      } else {
+         pco_builder b =
+            pco_builder_create(preamble, pco_cursor_after_block(last_block));
+         pco_nop_end(&b);
+      }
+   }
+
    /* TODO: Support for multiple end points. */
    pco_func *entry = pco_entrypoint(shader);
    pco_block *last_block = pco_func_last_block(entry);
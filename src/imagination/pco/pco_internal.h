@@ -24,6 +24,7 @@
 #include "util/hash_table.h"
 #include "util/macros.h"
 #include "util/list.h"
+#include "util/ralloc.h"
 #include "util/u_dynarray.h"
 #include "util/u_math.h"
 
@@ -311,6 +312,8 @@ typedef struct _pco_func {
 
    struct list_head body; /** List of pco_cf_nodes for function body. */
 
+   linear_ctx *lin_ctx; /** Linear allocator for the function's IR. */
+
    unsigned num_params;
    pco_ref *params;
 
@@ -1119,6 +1122,7 @@ bool pco_dce(pco_shader *shader);
 bool pco_end(pco_shader *shader);
 bool pco_group_instrs(pco_shader *shader);
 bool pco_index(pco_shader *shader, bool skip_ssa);
+bool pco_nir_opt_preamble(nir_shader *nir, pco_common_data *common);
 bool pco_nir_pfo(nir_shader *nir, pco_fs_data *fs);
 bool pco_nir_pvi(nir_shader *nir, pco_vs_data *vs);
 bool pco_opt(pco_shader *shader);
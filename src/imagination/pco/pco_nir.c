@@ -216,6 +216,16 @@ void pco_lower_nir(pco_ctx *ctx, nir_shader *nir, pco_data *data)
       NIR_PASS(_, nir, nir_opt_cse);
    } while (progress);
 
+   /* Hoist uniform computations into the shared register preamble. */
+   if (nir->info.stage == MESA_SHADER_VERTEX ||
+       nir->info.stage == MESA_SHADER_FRAGMENT) {
+      NIR_PASS(progress, nir, pco_nir_opt_preamble, &data->common);
+      if (progress) {
+         NIR_PASS(_, nir, nir_copy_prop);
+         NIR_PASS(_, nir, nir_opt_dce);
+      }
+   }
+
    nir_variable_mode vec_modes = nir_var_shader_in;
    /* Fragment shader needs scalar writes after pfo. */
    if (nir->info.stage != MESA_SHADER_FRAGMENT)
@@ -0,0 +1,201 @@
+/*
+ * Copyright © 2024 Imagination Technologies Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * \file pco_nir_preamble.c
+ *
+ * \brief PCO NIR preamble (uniform value hoisting) pass.
+ *
+ * Computations which only depend on uniform data (push constants, UBOs,
+ * constants, etc.) are moved into a preamble function. The preamble is run
+ * once per draw as the PDS secondary (shared register update) program, and
+ * stores its results in shared registers which the main program then reads
+ * in place of re-computing the values per-instance.
+ */
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "pco.h"
+#include "pco_internal.h"
+#include "util/macros.h"
+
+#include <assert.h>
+#include <stdbool.h>
+
+/**
+ * \brief Returns the size and alignment of a NIR def in shared registers.
+ *
+ * \param[in] def NIR def.
+ * \param[out] size Size in shared registers.
+ * \param[out] align Alignment in shared registers.
+ */
+static void def_size(nir_def *def, unsigned *size, unsigned *align)
+{
+   unsigned dwords = DIV_ROUND_UP(def->bit_size, 32);
+
+   *size = dwords * def->num_components;
+   *align = dwords;
+}
+
+/**
+ * \brief Returns the cost of an ALU instruction.
+ *
+ * \param[in] alu NIR ALU instruction.
+ * \return The cost.
+ */
+static float alu_cost(nir_alu_instr *alu)
+{
+   switch (alu->op) {
+   case nir_op_mov:
+   case nir_op_vec2:
+   case nir_op_vec3:
+   case nir_op_vec4:
+      return 0.0f;
+
+   case nir_op_frcp:
+   case nir_op_frsq:
+   case nir_op_fsqrt:
+   case nir_op_fexp2:
+   case nir_op_flog2:
+   case nir_op_fsin:
+   case nir_op_fcos:
+   case nir_op_fdiv:
+   case nir_op_idiv:
+   case nir_op_udiv:
+   case nir_op_imod:
+   case nir_op_umod:
+      return 4.0f;
+
+   default:
+      return 1.0f;
+   }
+}
+
+/**
+ * \brief Returns the cost of an instruction.
+ *
+ * \param[in] instr NIR instruction.
+ * \param[in] data User data.
+ * \return The cost.
+ */
+static float instr_cost(nir_instr *instr, UNUSED const void *data)
+{
+   switch (instr->type) {
+   case nir_instr_type_alu:
+      return alu_cost(nir_instr_as_alu(instr));
+
+   case nir_instr_type_tex:
+      /* Uniform texture fetches are a memory access per-instance. */
+      return 10.0f;
+
+   case nir_instr_type_intrinsic:
+      switch (nir_instr_as_intrinsic(instr)->intrinsic) {
+      case nir_intrinsic_load_push_constant:
+      case nir_intrinsic_load_ubo:
+      case nir_intrinsic_load_ubo_vec4:
+      case nir_intrinsic_load_global_constant:
+      case nir_intrinsic_load_constant:
+         return 10.0f;
+
+      default:
+         return 0.0f;
+      }
+
+   default:
+      return 0.0f;
+   }
+}
+
+/**
+ * \brief Returns the cost of rewriting a def to be read from a shared
+ *        register.
+ *
+ * ALU instructions can source shared registers directly; any other use will
+ * require a move per-channel.
+ *
+ * \param[in] def NIR def.
+ * \param[in] data User data.
+ * \return The cost.
+ */
+static float rewrite_cost(nir_def *def, UNUSED const void *data)
+{
+   nir_foreach_use_including_if (use, def) {
+      if (nir_src_is_if(use))
+         return (float)def->num_components;
+
+      nir_instr *parent_instr = nir_src_parent_instr(use);
+      if (parent_instr->type != nir_instr_type_alu)
+         return (float)def->num_components;
+
+      nir_alu_instr *alu = nir_instr_as_alu(parent_instr);
+      if (alu->op == nir_op_mov || alu->op == nir_op_vec2 ||
+          alu->op == nir_op_vec3 || alu->op == nir_op_vec4) {
+         return (float)def->num_components;
+      }
+   }
+
+   return 0.0f;
+}
+
+/**
+ * \brief Filters out instructions whose results shouldn't be placed into
+ *        shared registers.
+ *
+ * \param[in] instr NIR instruction.
+ * \param[in] data User data.
+ * \return True if the instruction result shouldn't be rewritten.
+ */
+static bool avoid_instr(const nir_instr *instr, UNUSED const void *data)
+{
+   const nir_def *def = nir_instr_def((nir_instr *)instr);
+
+   /* TODO: 64-bit/f16 support. */
+   return def && def->bit_size != 32;
+}
+
+/**
+ * \brief Hoists uniform computations into a preamble which writes its results
+ *        to shared registers.
+ *
+ * The driver provides the first shared register available to the preamble and
+ * how many may be used, in common->preamble.start and common->preamble.max.
+ * On return, common->preamble.count holds the number actually used.
+ *
+ * \param[in,out] nir NIR shader.
+ * \param[in,out] common Common shader data.
+ * \return True if the pass made progress.
+ */
+bool pco_nir_opt_preamble(nir_shader *nir, pco_common_data *common)
+{
+   common->preamble.count = 0;
+
+   if (!common->preamble.max)
+      return false;
+
+   const nir_opt_preamble_options options = {
+      .drawid_uniform = true,
+      .subgroup_size_uniform = true,
+      .load_workgroup_size_allowed = false,
+      .def_size = def_size,
+      .preamble_storage_size = common->preamble.max,
+      .instr_cost_cb = instr_cost,
+      .rewrite_cost_cb = rewrite_cost,
+      .avoid_instr_cb = avoid_instr,
+   };
+
+   unsigned size = 0;
+   bool progress = nir_opt_preamble(nir, &options, &size);
+
+   if (!progress || !size)
+      return progress;
+
+   assert(size <= common->preamble.max);
+   common->preamble.count = size;
+   common->shareds =
+      MAX2(common->shareds, common->preamble.start + common->preamble.count);
+
+   return true;
+}
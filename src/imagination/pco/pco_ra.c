@@ -364,7 +364,7 @@ bool pco_ra(pco_shader *shader)
     * unsigned opt_temps = rogue_get_optimal_temps(shader->ctx->dev_info);
     */
 
-   /* TODO: different number of temps available if preamble/phase change. */
+   /* TODO: different number of temps available if phase change. */
    /* TODO: different number of temps available if barriers are in use. */
    /* TODO: support for internal and vtxin registers. */
    unsigned allocable_temps = hw_temps;
@@ -379,6 +379,14 @@ bool pco_ra(pco_shader *shader)
                               allocable_vtxins,
                               allocable_interns);
 
+      /* The preamble is kicked as a task of its own, so its temps are
+       * allocated separately from the main program's.
+       */
+      if (func->type == PCO_FUNC_TYPE_PREAMBLE) {
+         shader->data.common.preamble.temps = func->temps;
+         continue;
+      }
+
       shader->data.common.temps = MAX2(shader->data.common.temps, func->temps);
    }
 
@@ -408,6 +408,55 @@ trans_store_output_fs(trans_ctx *tctx, nir_intrinsic_instr *intr, pco_ref src)
    return pco_mov(&tctx->b, dest, src, .olchk = true);
 }
 
+/**
+ * \brief Translates a NIR load_preamble intrinsic into PCO.
+ *
+ * \param[in,out] tctx Translation context.
+ * \param[in] intr load_preamble intrinsic.
+ * \param[in] dest Instruction destination.
+ * \return The translated PCO instruction.
+ */
+static pco_instr *
+trans_load_preamble(trans_ctx *tctx, nir_intrinsic_instr *intr, pco_ref dest)
+{
+   const pco_common_data *common = &tctx->shader->data.common;
+   unsigned base = nir_intrinsic_base(intr);
+   unsigned chans = pco_ref_get_chans(dest);
+
+   assert(pco_ref_get_bits(dest) == 32);
+   assert(base + chans <= common->preamble.count);
+
+   pco_ref src = pco_ref_hwreg_vec(common->preamble.start + base,
+                                   PCO_REG_CLASS_SHARED,
+                                   chans);
+   return pco_mov(&tctx->b, dest, src, .rpt = chans);
+}
+
+/**
+ * \brief Translates a NIR store_preamble intrinsic into PCO.
+ *
+ * \param[in,out] tctx Translation context.
+ * \param[in] intr store_preamble intrinsic.
+ * \param[in] src Instruction source.
+ * \return The translated PCO instruction.
+ */
+static pco_instr *
+trans_store_preamble(trans_ctx *tctx, nir_intrinsic_instr *intr, pco_ref src)
+{
+   const pco_common_data *common = &tctx->shader->data.common;
+   unsigned base = nir_intrinsic_base(intr);
+   unsigned chans = pco_ref_get_chans(src);
+
+   assert(tctx->func->type == PCO_FUNC_TYPE_PREAMBLE);
+   assert(pco_ref_get_bits(src) == 32);
+   assert(base + chans <= common->preamble.count);
+
+   pco_ref dest = pco_ref_hwreg_vec(common->preamble.start + base,
+                                    PCO_REG_CLASS_SHARED,
+                                    chans);
+   return pco_mov(&tctx->b, dest, src, .rpt = chans);
+}
+
 /**
  * \brief Translates a NIR intrinsic instruction into PCO.
  *
@@ -446,6 +495,14 @@ static pco_instr *trans_intr(trans_ctx *tctx, nir_intrinsic_instr *intr)
          unreachable("Unsupported stage for \"nir_intrinsic_store_output\".");
       break;
 
+   case nir_intrinsic_load_preamble:
+      instr = trans_load_preamble(tctx, intr, dest);
+      break;
+
+   case nir_intrinsic_store_preamble:
+      instr = trans_store_preamble(tctx, intr, src[0]);
+      break;
+
    default:
       printf("Unsupported intrinsic: \"");
       nir_print_instr(&intr->instr, stdout);
@@ -28,6 +28,7 @@
 #include <vulkan/vulkan.h>
 
 #include "pvr_blit.h"
+#include "pvr_bo.h"
 #include "pvr_clear.h"
 #include "pvr_csb.h"
 #include "pvr_formats.h"
@@ -39,6 +40,7 @@
 #include "util/bitscan.h"
 #include "util/list.h"
 #include "util/macros.h"
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "vk_alloc.h"
 #include "vk_command_buffer.h"
@@ -756,6 +758,48 @@ void pvr_CmdCopyImage2(VkCommandBuffer commandBuffer,
    }
 }
 
+/* Buffer copies and fills, and buffer to image copies, of up to this many
+ * bytes may be done with the CPU at submit time instead of with a transfer
+ * job. Can be overridden with the
+ * PVR_CPU_TRANSFER_MAX_SIZE environment variable, 0 disables it.
+ */
+DEBUG_GET_ONCE_NUM_OPTION(cpu_transfer_max_size,
+                          "PVR_CPU_TRANSFER_MAX_SIZE",
+                          1024)
+
+/* Returns whether a copy of a single slice of the region can be done with the
+ * CPU, see pvr_process_transfer_cmds_on_cpu().
+ */
+static bool
+pvr_copy_buffer_to_image_can_use_cpu(const struct pvr_image *const image,
+                                     const VkBufferImageCopy2 *const region,
+                                     const VkFormat src_format,
+                                     const VkFormat dst_format,
+                                     const uint32_t flags)
+{
+   const uint32_t cpp = vk_format_get_blocksize(src_format);
+   const uint64_t size =
+      (uint64_t)region->imageExtent.width * region->imageExtent.height * cpp;
+
+   if (flags || src_format != dst_format)
+      return false;
+
+   if (image->vk.image_type != VK_IMAGE_TYPE_2D || image->vk.samples != 1)
+      return false;
+
+   if (image->memlayout != PVR_MEMLAYOUT_LINEAR &&
+       image->memlayout != PVR_MEMLAYOUT_TWIDDLED) {
+      return false;
+   }
+
+   if (vk_format_is_compressed(image->vk.format) ||
+       vk_format_get_blocksize(image->vk.format) != cpp) {
+      return false;
+   }
+
+   return size <= debug_get_option_cpu_transfer_max_size();
+}
+
 VkResult
 pvr_copy_buffer_to_image_region_format(struct pvr_cmd_buffer *const cmd_buffer,
                                        const pvr_dev_addr_t buffer_dev_addr,
@@ -763,9 +807,11 @@ pvr_copy_buffer_to_image_region_format(struct pvr_cmd_buffer *const cmd_buffer,
                                        const VkBufferImageCopy2 *const region,
                                        const VkFormat src_format,
                                        const VkFormat dst_format,
-                                       const uint32_t flags)
+                                       const uint32_t flags,
+                                       const struct pvr_buffer *const buffer)
 {
    enum pipe_format pformat = vk_format_to_pipe_format(dst_format);
+   struct pvr_transfer_cmd_cpu cpu = { 0 };
    uint32_t row_length_in_texels;
    uint32_t buffer_slice_size;
    uint32_t buffer_layer_size;
@@ -797,6 +843,37 @@ pvr_copy_buffer_to_image_region_format(struct pvr_cmd_buffer *const cmd_buffer,
    buffer_slice_size = height_in_blks * row_length;
    buffer_layer_size = buffer_slice_size * region->imageExtent.depth;
 
+   if (buffer && pvr_copy_buffer_to_image_can_use_cpu(image,
+                                                      region,
+                                                      src_format,
+                                                      dst_format,
+                                                      flags)) {
+      const struct pvr_mip_level *mip_level =
+         &image->mip_levels[region->imageSubresource.mipLevel];
+
+      cpu = (struct pvr_transfer_cmd_cpu){
+         .enabled = true,
+         .src_buffer = buffer,
+         .dst_image = image,
+         .region = {
+            .cpp = vk_format_get_blocksize(src_format),
+            .x = region->imageOffset.x,
+            .y = region->imageOffset.y,
+            .width = region->imageExtent.width,
+            .height = region->imageExtent.height,
+            .depth = 1,
+            .row_pitch = row_length,
+         },
+         .dst_twiddled = image->memlayout == PVR_MEMLAYOUT_TWIDDLED,
+         .dst_height = mip_level->height_pitch,
+         .dst_row_pitch = mip_level->pitch,
+      };
+
+      cpu.dst_width = mip_level->pitch / cpu.region.cpp;
+      cpu.size = (VkDeviceSize)cpu.region.width * cpu.region.height *
+                 cpu.region.cpp;
+   }
+
    for (uint32_t i = 0; i < region->imageExtent.depth; i++) {
       const uint32_t depth = i + (uint32_t)region->imageOffset.z;
 
@@ -842,6 +919,20 @@ pvr_copy_buffer_to_image_region_format(struct pvr_cmd_buffer *const cmd_buffer,
          transfer_cmd->sources[0].mappings[0].dst_rect = transfer_cmd->scissor;
          transfer_cmd->sources[0].mapping_count++;
 
+         if (cpu.enabled) {
+            const VkImageSubresource subresource = {
+               .mipLevel = region->imageSubresource.mipLevel,
+               .arrayLayer = region->imageSubresource.baseArrayLayer + j,
+            };
+            VkSubresourceLayout layout;
+
+            pvr_get_image_subresource_layout(image, &subresource, &layout);
+
+            transfer_cmd->cpu = cpu;
+            transfer_cmd->cpu.src_offset = buffer_offset;
+            transfer_cmd->cpu.dst_offset = layout.offset;
+         }
+
          result = pvr_cmd_buffer_add_transfer_cmd(cmd_buffer, transfer_cmd);
          if (result != VK_SUCCESS) {
             vk_free(&cmd_buffer->vk.pool->alloc, transfer_cmd);
@@ -857,7 +948,8 @@ VkResult
 pvr_copy_buffer_to_image_region(struct pvr_cmd_buffer *const cmd_buffer,
                                 const pvr_dev_addr_t buffer_dev_addr,
                                 const struct pvr_image *const image,
-                                const VkBufferImageCopy2 *const region)
+                                const VkBufferImageCopy2 *const region,
+                                const struct pvr_buffer *const buffer)
 {
    const VkImageAspectFlags aspect_mask = region->imageSubresource.aspectMask;
    VkFormat src_format;
@@ -887,7 +979,8 @@ pvr_copy_buffer_to_image_region(struct pvr_cmd_buffer *const cmd_buffer,
                                                  region,
                                                  src_format,
                                                  dst_format,
-                                                 flags);
+                                                 flags,
+                                                 buffer);
 }
 
 void pvr_CmdCopyBufferToImage2(
@@ -905,7 +998,8 @@ void pvr_CmdCopyBufferToImage2(
          pvr_copy_buffer_to_image_region(cmd_buffer,
                                          src->dev_addr,
                                          dst,
-                                         &pCopyBufferToImageInfo->pRegions[i]);
+                                         &pCopyBufferToImageInfo->pRegions[i],
+                                         src);
       if (result != VK_SUCCESS)
          return;
    }
@@ -1232,17 +1326,25 @@ void pvr_CmdClearDepthStencilImage(VkCommandBuffer commandBuffer,
    }
 }
 
-static VkResult pvr_cmd_copy_buffer_region(struct pvr_cmd_buffer *cmd_buffer,
-                                           pvr_dev_addr_t src_addr,
-                                           VkDeviceSize src_offset,
-                                           pvr_dev_addr_t dst_addr,
-                                           VkDeviceSize dst_offset,
-                                           VkDeviceSize size,
-                                           uint32_t fill_data,
-                                           bool is_fill)
+/* If cpu isn't NULL it describes the same operation as the other arguments for
+ * the CPU path, with src_offset and dst_offset relative to its buffers.
+ */
+static VkResult
+pvr_cmd_copy_buffer_region(struct pvr_cmd_buffer *cmd_buffer,
+                           pvr_dev_addr_t src_addr,
+                           VkDeviceSize src_offset,
+                           pvr_dev_addr_t dst_addr,
+                           VkDeviceSize dst_offset,
+                           VkDeviceSize size,
+                           uint32_t fill_data,
+                           bool is_fill,
+                           const struct pvr_transfer_cmd_cpu *cpu)
 {
    VkDeviceSize offset = 0;
 
+   if (size > debug_get_option_cpu_transfer_max_size())
+      cpu = NULL;
+
    while (offset < size) {
       const VkDeviceSize remaining_size = size - offset;
       struct pvr_transfer_cmd *transfer_cmd;
@@ -1324,6 +1426,18 @@ static VkResult pvr_cmd_copy_buffer_region(struct pvr_cmd_buffer *cmd_buffer,
          transfer_cmd->sources[0].mapping_count++;
       }
 
+      if (cpu) {
+         transfer_cmd->cpu = *cpu;
+         transfer_cmd->cpu.enabled = true;
+         transfer_cmd->cpu.size = width * height * texel_width;
+         transfer_cmd->cpu.dst_offset += offset;
+
+         if (transfer_cmd->cpu.src_map)
+            transfer_cmd->cpu.src_map = (uint8_t *)cpu->src_map + offset;
+         else
+            transfer_cmd->cpu.src_offset += offset;
+      }
+
       result = pvr_cmd_buffer_add_transfer_cmd(cmd_buffer, transfer_cmd);
       if (result != VK_SUCCESS) {
          vk_free(&cmd_buffer->vk.pool->alloc, transfer_cmd);
@@ -1344,6 +1458,7 @@ void pvr_CmdUpdateBuffer(VkCommandBuffer commandBuffer,
 {
    PVR_FROM_HANDLE(pvr_cmd_buffer, cmd_buffer, commandBuffer);
    PVR_FROM_HANDLE(pvr_buffer, dst, dstBuffer);
+   struct pvr_transfer_cmd_cpu cpu;
    struct pvr_suballoc_bo *pvr_bo;
    VkResult result;
 
@@ -1353,6 +1468,12 @@ void pvr_CmdUpdateBuffer(VkCommandBuffer commandBuffer,
    if (result != VK_SUCCESS)
       return;
 
+   cpu = (struct pvr_transfer_cmd_cpu){
+      .src_map = pvr_bo_suballoc_get_map_addr(pvr_bo),
+      .dst_buffer = dst,
+      .dst_offset = dstOffset,
+   };
+
    pvr_cmd_copy_buffer_region(cmd_buffer,
                               pvr_bo->dev_addr,
                               0,
@@ -1360,7 +1481,8 @@ void pvr_CmdUpdateBuffer(VkCommandBuffer commandBuffer,
                               dstOffset,
                               dataSize,
                               0U,
-                              false);
+                              false,
+                              &cpu);
 }
 
 void pvr_CmdCopyBuffer2(VkCommandBuffer commandBuffer,
@@ -1373,15 +1495,22 @@ void pvr_CmdCopyBuffer2(VkCommandBuffer commandBuffer,
    PVR_CHECK_COMMAND_BUFFER_BUILDING_STATE(cmd_buffer);
 
    for (uint32_t i = 0; i < pCopyBufferInfo->regionCount; i++) {
-      const VkResult result =
-         pvr_cmd_copy_buffer_region(cmd_buffer,
-                                    src->dev_addr,
-                                    pCopyBufferInfo->pRegions[i].srcOffset,
-                                    dst->dev_addr,
-                                    pCopyBufferInfo->pRegions[i].dstOffset,
-                                    pCopyBufferInfo->pRegions[i].size,
-                                    0U,
-                                    false);
+      const VkBufferCopy2 *region = &pCopyBufferInfo->pRegions[i];
+      const struct pvr_transfer_cmd_cpu cpu = {
+         .src_buffer = src,
+         .src_offset = region->srcOffset,
+         .dst_buffer = dst,
+         .dst_offset = region->dstOffset,
+      };
+      const VkResult result = pvr_cmd_copy_buffer_region(cmd_buffer,
+                                                         src->dev_addr,
+                                                         region->srcOffset,
+                                                         dst->dev_addr,
+                                                         region->dstOffset,
+                                                         region->size,
+                                                         0U,
+                                                         false,
+                                                         &cpu);
       if (result != VK_SUCCESS)
          return;
    }
@@ -1395,6 +1524,12 @@ void pvr_CmdFillBuffer(VkCommandBuffer commandBuffer,
 {
    PVR_FROM_HANDLE(pvr_cmd_buffer, cmd_buffer, commandBuffer);
    PVR_FROM_HANDLE(pvr_buffer, dst, dstBuffer);
+   const struct pvr_transfer_cmd_cpu cpu = {
+      .is_fill = true,
+      .fill_data = data,
+      .dst_buffer = dst,
+      .dst_offset = dstOffset,
+   };
 
    PVR_CHECK_COMMAND_BUFFER_BUILDING_STATE(cmd_buffer);
 
@@ -1417,7 +1552,8 @@ void pvr_CmdFillBuffer(VkCommandBuffer commandBuffer,
                               dstOffset,
                               fillSize,
                               data,
-                              true);
+                              true,
+                              &cpu);
 }
 
 /**
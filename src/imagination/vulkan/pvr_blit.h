@@ -29,6 +29,7 @@
 
 #include "pvr_types.h"
 
+struct pvr_buffer;
 struct pvr_cmd_buffer;
 struct pvr_device;
 struct pvr_image;
@@ -46,7 +47,8 @@ pvr_copy_or_resolve_color_image_region(struct pvr_cmd_buffer *cmd_buffer,
 VkResult pvr_copy_buffer_to_image_region(struct pvr_cmd_buffer *cmd_buffer,
                                          pvr_dev_addr_t buffer_dev_addr,
                                          const struct pvr_image *image,
-                                         const VkBufferImageCopy2 *region);
+                                         const VkBufferImageCopy2 *region,
+                                         const struct pvr_buffer *buffer);
 
 VkResult
 pvr_copy_buffer_to_image_region_format(struct pvr_cmd_buffer *cmd_buffer,
@@ -55,7 +57,8 @@ pvr_copy_buffer_to_image_region_format(struct pvr_cmd_buffer *cmd_buffer,
                                        const VkBufferImageCopy2 *region,
                                        VkFormat src_format,
                                        VkFormat dst_format,
-                                       uint32_t flags);
+                                       uint32_t flags,
+                                       const struct pvr_buffer *buffer);
 
 VkResult pvr_copy_image_to_buffer_region(struct pvr_cmd_buffer *cmd_buffer,
                                          const struct pvr_image *image,
@@ -47,16 +47,30 @@
 #include "util/macros.h"
 #include "util/rb_tree.h"
 #include "util/simple_mtx.h"
+#include "util/u_atomic.h"
 #include "util/u_debug.h"
 #include "vk_alloc.h"
 #include "vk_log.h"
 
-struct pvr_bo_store {
+/* The store is split into one shard per device heap. Heaps cover disjoint
+ * address ranges, so a lookup only ever has to search, and lock, the shard of
+ * the heap the address falls in.
+ */
+#define PVR_BO_STORE_MAX_SHARDS 6U
+
+struct pvr_bo_store_shard {
+   const struct pvr_winsys_heap *heap;
+
    struct rb_tree tree;
    simple_mtx_t mutex;
    uint32_t size;
 };
 
+struct pvr_bo_store {
+   struct pvr_bo_store_shard shards[PVR_BO_STORE_MAX_SHARDS];
+   uint32_t shard_count;
+};
+
 struct pvr_bo_store_entry {
    struct rb_node node;
    struct pvr_bo bo;
@@ -104,10 +118,48 @@ static inline int pvr_bo_store_entry_cmp(const struct rb_node *const a,
                            entry_from_node(b)->bo.vma->dev_addr);
 }
 
+static inline bool
+pvr_bo_store_shard_overlaps(const struct pvr_bo_store_shard *const shard,
+                            const uint64_t start,
+                            const uint64_t end)
+{
+   const uint64_t heap_start = shard->heap->base_addr.addr;
+   const uint64_t heap_end = heap_start + shard->heap->size;
+
+   return start < heap_end && end > heap_start;
+}
+
+static struct pvr_bo_store_shard *
+pvr_bo_store_get_shard(struct pvr_bo_store *const store,
+                       const pvr_dev_addr_t addr)
+{
+   for (uint32_t i = 0; i < store->shard_count; i++) {
+      struct pvr_bo_store_shard *const shard = &store->shards[i];
+
+      if (pvr_bo_store_shard_overlaps(shard, addr.addr, addr.addr + 1))
+         return shard;
+   }
+
+   return NULL;
+}
+
 VkResult pvr_bo_store_create(struct pvr_device *device)
 {
+   const struct pvr_winsys_heap *const heaps[] = {
+      device->heaps.general_heap,
+      device->heaps.pds_heap,
+      device->heaps.rgn_hdr_heap,
+      device->heaps.transfer_frag_heap,
+      device->heaps.usc_heap,
+      device->heaps.vis_test_heap,
+   };
    struct pvr_bo_store *store;
 
+   STATIC_ASSERT(ARRAY_SIZE(heaps) == PVR_BO_STORE_MAX_SHARDS);
+
+   /* Heap usage is tracked even when the store itself is disabled. */
+   device->bo_heap_usage = (struct pvr_bo_heap_usage){ 0 };
+
    if (!PVR_IS_DEBUG_SET(TRACK_BOS)) {
       device->bo_store = NULL;
       return VK_SUCCESS;
@@ -120,9 +172,21 @@ VkResult pvr_bo_store_create(struct pvr_device *device)
    if (!store)
       return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
 
-   rb_tree_init(&store->tree);
-   store->size = 0;
-   simple_mtx_init(&store->mutex, mtx_plain);
+   store->shard_count = 0;
+
+   for (uint32_t i = 0; i < ARRAY_SIZE(heaps); i++) {
+      struct pvr_bo_store_shard *shard;
+
+      /* Not all heaps are present on all devices. */
+      if (!heaps[i])
+         continue;
+
+      shard = &store->shards[store->shard_count++];
+      shard->heap = heaps[i];
+      rb_tree_init(&shard->tree);
+      shard->size = 0;
+      simple_mtx_init(&shard->mutex, mtx_plain);
+   }
 
    device->bo_store = store;
 
@@ -132,16 +196,21 @@ VkResult pvr_bo_store_create(struct pvr_device *device)
 void pvr_bo_store_destroy(struct pvr_device *device)
 {
    struct pvr_bo_store *store = device->bo_store;
+   bool empty = true;
 
    if (likely(!store))
       return;
 
-   if (unlikely(!rb_tree_is_empty(&store->tree))) {
+   for (uint32_t i = 0; i < store->shard_count; i++)
+      empty &= rb_tree_is_empty(&store->shards[i].tree);
+
+   if (unlikely(!empty)) {
       debug_warning("Non-empty BO store destroyed; dump follows");
-      pvr_bo_store_dump(device);
+      pvr_bo_store_dump(device, stderr);
    }
 
-   simple_mtx_destroy(&store->mutex);
+   for (uint32_t i = 0; i < store->shard_count; i++)
+      simple_mtx_destroy(&store->shards[i].mutex);
 
    vk_free(&device->vk.alloc, store);
 
@@ -151,46 +220,165 @@ void pvr_bo_store_destroy(struct pvr_device *device)
 static void pvr_bo_store_insert(struct pvr_bo_store *const store,
                                 struct pvr_bo *const bo)
 {
+   struct pvr_bo_store_shard *shard;
+
    if (likely(!store))
       return;
 
-   simple_mtx_lock(&store->mutex);
-   rb_tree_insert(&store->tree,
+   shard = pvr_bo_store_get_shard(store, bo->vma->dev_addr);
+   assert(shard);
+
+   simple_mtx_lock(&shard->mutex);
+   rb_tree_insert(&shard->tree,
                   &entry_from_bo(bo)->node,
                   pvr_bo_store_entry_cmp);
-   store->size++;
-   simple_mtx_unlock(&store->mutex);
+   shard->size++;
+   simple_mtx_unlock(&shard->mutex);
 }
 
 static void pvr_bo_store_remove(struct pvr_bo_store *const store,
                                 struct pvr_bo *const bo)
 {
+   struct pvr_bo_store_shard *shard;
+
    if (likely(!store))
       return;
 
-   simple_mtx_lock(&store->mutex);
-   rb_tree_remove(&store->tree, &entry_from_bo(bo)->node);
-   store->size--;
-   simple_mtx_unlock(&store->mutex);
+   shard = pvr_bo_store_get_shard(store, bo->vma->dev_addr);
+   assert(shard);
+
+   simple_mtx_lock(&shard->mutex);
+   rb_tree_remove(&shard->tree, &entry_from_bo(bo)->node);
+   shard->size--;
+   simple_mtx_unlock(&shard->mutex);
 }
 
-struct pvr_bo *pvr_bo_store_lookup(struct pvr_device *const device,
-                                   const pvr_dev_addr_t addr)
+/**
+ * \brief Looks up all buffer objects overlapping a range of device addresses.
+ *
+ * Only available with PVR_DEBUG=track_bos.
+ *
+ * \param[in]  device  Logical device pointer.
+ * \param[in]  addr    Start of the range.
+ * \param[in]  size    Size of the range in bytes.
+ * \param[out] bos_out Array to store the overlapping buffer objects in,
+ *                     ordered by address. May be NULL if max_bos is 0.
+ * \param[in]  max_bos Size of bos_out.
+ * \return The number of overlapping buffer objects, which may be greater
+ *         than max_bos.
+ */
+uint32_t pvr_bo_store_lookup_range(struct pvr_device *const device,
+                                   const pvr_dev_addr_t addr,
+                                   const uint64_t size,
+                                   struct pvr_bo **const bos_out,
+                                   const uint32_t max_bos)
 {
    struct pvr_bo_store *const store = device->bo_store;
-   struct rb_node *node;
+   const uint64_t end = addr.addr + size;
+   uint32_t count = 0;
 
    if (unlikely(!store))
-      return NULL;
+      return 0;
+
+   /* Shards are in heap order, not address order. Look at them in address
+    * order so that the result is sorted.
+    */
+   for (uint64_t cursor = addr.addr; cursor < end;) {
+      const pvr_dev_addr_t cursor_addr = PVR_DEV_ADDR(cursor);
+      struct pvr_bo_store_shard *shard = NULL;
+      struct rb_node *node;
 
-   simple_mtx_lock(&store->mutex);
-   node = rb_tree_search(&store->tree, &addr, pvr_bo_store_entry_cmp_key);
-   simple_mtx_unlock(&store->mutex);
+      for (uint32_t i = 0; i < store->shard_count; i++) {
+         struct pvr_bo_store_shard *const candidate = &store->shards[i];
 
-   if (!node)
+         if (!pvr_bo_store_shard_overlaps(candidate, cursor, end))
+            continue;
+
+         if (!shard ||
+             candidate->heap->base_addr.addr < shard->heap->base_addr.addr) {
+            shard = candidate;
+         }
+      }
+
+      if (!shard)
+         break;
+
+      simple_mtx_lock(&shard->mutex);
+
+      /* This gives either the entry containing the cursor, or one of its
+       * neighbours.
+       */
+      node = rb_tree_search_sloppy(&shard->tree,
+                                   &cursor_addr,
+                                   pvr_bo_store_entry_cmp_key);
+      if (node) {
+         const struct pvr_winsys_vma *const vma =
+            entry_from_node(node)->bo.vma;
+
+         if (vma->dev_addr.addr + vma->size <= cursor)
+            node = rb_node_next(node);
+      }
+
+      for (; node; node = rb_node_next(node)) {
+         struct pvr_bo *const bo = &entry_from_node(node)->bo;
+
+         if (bo->vma->dev_addr.addr >= end)
+            break;
+
+         if (count < max_bos)
+            bos_out[count] = bo;
+
+         count++;
+      }
+
+      simple_mtx_unlock(&shard->mutex);
+
+      cursor = shard->heap->base_addr.addr + shard->heap->size;
+   }
+
+   return count;
+}
+
+struct pvr_bo *pvr_bo_store_lookup(struct pvr_device *const device,
+                                   const pvr_dev_addr_t addr)
+{
+   struct pvr_bo *bo;
+
+   if (!pvr_bo_store_lookup_range(device, addr, 1, &bo, 1))
       return NULL;
 
-   return &entry_from_node(node)->bo;
+   return bo;
+}
+
+static uint64_t *
+pvr_bo_heap_usage_get_counter(struct pvr_device *const device,
+                              const struct pvr_winsys_heap *const heap)
+{
+   struct pvr_bo_heap_usage *const usage = &device->bo_heap_usage;
+
+   if (heap == device->heaps.general_heap)
+      return &usage->general;
+   else if (heap == device->heaps.pds_heap)
+      return &usage->pds;
+   else if (heap == device->heaps.rgn_hdr_heap)
+      return &usage->rgn_hdr;
+   else if (heap == device->heaps.transfer_frag_heap)
+      return &usage->transfer_frag;
+   else if (heap == device->heaps.usc_heap)
+      return &usage->usc;
+   else if (heap == device->heaps.vis_test_heap)
+      return &usage->vis_test;
+
+   unreachable("Unknown heap type");
+}
+
+/* Internal allocations also count towards the memory budget's heap usage. */
+static void pvr_bo_heap_usage_update(struct pvr_device *const device,
+                                     const struct pvr_winsys_heap *const heap,
+                                     const int64_t size)
+{
+   p_atomic_add(pvr_bo_heap_usage_get_counter(device, heap), size);
+   p_atomic_add(&device->pdevice->heap_used, size);
 }
 
 static void pvr_bo_dump_line(struct pvr_dump_ctx *const ctx,
@@ -229,29 +417,73 @@ static void pvr_bo_dump_line(struct pvr_dump_ctx *const ctx,
                     size);
 }
 
-bool pvr_bo_store_dump(struct pvr_device *const device)
+static void pvr_bo_heap_usage_dump(struct pvr_dump_ctx *const ctx,
+                                   const struct pvr_bo_heap_usage *const usage)
+{
+   const struct {
+      const char *name;
+      const uint64_t *bytes;
+   } heaps[] = {
+      { "general", &usage->general },
+      { "pds", &usage->pds },
+      { "rgn_hdr", &usage->rgn_hdr },
+      { "transfer_frag", &usage->transfer_frag },
+      { "usc", &usage->usc },
+      { "vis_test", &usage->vis_test },
+   };
+
+   pvr_dump_println(ctx, "Heap usage:");
+
+   pvr_dump_indent(ctx);
+   for (uint32_t i = 0; i < ARRAY_SIZE(heaps); i++) {
+      pvr_dump_println(ctx,
+                       "%-13s: 0x%" PRIx64 " bytes",
+                       heaps[i].name,
+                       p_atomic_read(heaps[i].bytes));
+   }
+   pvr_dump_dedent(ctx);
+}
+
+bool pvr_bo_store_dump(struct pvr_device *const device, FILE *const file)
 {
    struct pvr_bo_store *const store = device->bo_store;
-   const uint32_t nr_bos = store->size;
-   const uint32_t nr_bos_log10 = u32_dec_digits(nr_bos);
+   uint32_t nr_bos_log10;
    struct pvr_dump_ctx ctx;
    uint32_t bo_idx = 0;
+   uint32_t nr_bos = 0;
 
    if (unlikely(!store)) {
       debug_warning("Requested BO store dump, but no BO store is present.");
       return false;
    }
 
-   pvr_dump_begin(&ctx, stderr, "BO STORE", 1);
+   for (uint32_t i = 0; i < store->shard_count; i++) {
+      simple_mtx_lock(&store->shards[i].mutex);
+      nr_bos += store->shards[i].size;
+   }
+
+   nr_bos_log10 = u32_dec_digits(nr_bos);
+
+   pvr_dump_begin(&ctx, file, "BO STORE", 1);
 
    pvr_dump_println(&ctx, "Dumping %" PRIu32 " BO store entries...", nr_bos);
 
    pvr_dump_indent(&ctx);
-   rb_tree_foreach_safe (struct pvr_bo_store_entry, entry, &store->tree, node) {
-      pvr_bo_dump_line(&ctx, &entry->bo, bo_idx++, nr_bos_log10);
+   for (uint32_t i = 0; i < store->shard_count; i++) {
+      rb_tree_foreach_safe (struct pvr_bo_store_entry,
+                            entry,
+                            &store->shards[i].tree,
+                            node) {
+         pvr_bo_dump_line(&ctx, &entry->bo, bo_idx++, nr_bos_log10);
+      }
    }
    pvr_dump_dedent(&ctx);
 
+   for (uint32_t i = 0; i < store->shard_count; i++)
+      simple_mtx_unlock(&store->shards[i].mutex);
+
+   pvr_bo_heap_usage_dump(&ctx, &device->bo_heap_usage);
+
    return pvr_dump_end(&ctx);
 }
 
@@ -379,6 +611,7 @@ VkResult pvr_bo_alloc(struct pvr_device *device,
    if (result != VK_SUCCESS)
       goto err_heap_free;
 
+   pvr_bo_heap_usage_update(device, heap, pvr_bo->bo->size);
    pvr_bo_store_insert(device->bo_store, pvr_bo);
    *pvr_bo_out = pvr_bo;
 
@@ -478,6 +711,9 @@ void pvr_bo_free(struct pvr_device *device, struct pvr_bo *pvr_bo)
 #endif /* defined(HAVE_VALGRIND) */
 
    pvr_bo_store_remove(device->bo_store, pvr_bo);
+   pvr_bo_heap_usage_update(device,
+                            pvr_bo->vma->heap,
+                            -(int64_t)pvr_bo->bo->size);
 
    device->ws->ops->vma_unmap(pvr_bo->vma);
    device->ws->ops->heap_free(pvr_bo->vma);
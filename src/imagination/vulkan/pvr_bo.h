@@ -31,6 +31,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <vulkan/vulkan.h>
 
 #include "pvr_types.h"
@@ -151,13 +152,34 @@ pvr_bo_cpu_map_unchanged(struct pvr_device *device, struct pvr_bo *pvr_bo)
 }
 #endif /* defined(HAVE_VALGRIND) */
 
+/**
+ * \brief Bytes of buffer objects allocated with #pvr_bo_alloc() in each device
+ * heap.
+ *
+ * This is always tracked, whether or not the BO store is enabled, and is
+ * updated atomically. #pvr_bo_store_dump() reports it.
+ */
+struct pvr_bo_heap_usage {
+   uint64_t general;
+   uint64_t pds;
+   uint64_t rgn_hdr;
+   uint64_t transfer_frag;
+   uint64_t usc;
+   uint64_t vis_test;
+};
+
 struct pvr_bo_store;
 
 VkResult pvr_bo_store_create(struct pvr_device *device);
 void pvr_bo_store_destroy(struct pvr_device *device);
 struct pvr_bo *pvr_bo_store_lookup(struct pvr_device *device,
                                    pvr_dev_addr_t addr);
-bool pvr_bo_store_dump(struct pvr_device *device);
+uint32_t pvr_bo_store_lookup_range(struct pvr_device *device,
+                                   pvr_dev_addr_t addr,
+                                   uint64_t size,
+                                   struct pvr_bo **bos_out,
+                                   uint32_t max_bos);
+bool pvr_bo_store_dump(struct pvr_device *device, FILE *file);
 
 void pvr_bo_list_dump(struct pvr_dump_ctx *ctx,
                       const struct list_head *bo_list,
@@ -36,8 +36,12 @@
 #include "util/bitset.h"
 #include "util/format/u_format.h"
 #include "util/format/u_formats.h"
+#include "util/hash_table.h"
 #include "util/log.h"
 #include "util/macros.h"
+#include "util/simple_mtx.h"
+#include "util/u_atomic.h"
+#include "vk_alloc.h"
 #include "vk_format.h"
 #include "vk_log.h"
 #include "vk_sampler.h"
@@ -53,6 +57,29 @@ struct pvr_border_color_table_entry {
    struct pvr_border_color_table_value values[PVR_TEX_FORMAT_COUNT * 2];
 } PACKED;
 
+/* Value slot index meaning that the entry has been packed for every format. */
+#define PVR_BORDER_COLOR_TABLE_ALL_SLOTS (PVR_TEX_FORMAT_COUNT * 2)
+
+struct pvr_border_color_custom_entry {
+   /* Only changed while ref_count is 0 with custom_mutex held. */
+   VkClearColorValue value;
+   bool is_int;
+   uint32_t hash;
+
+   /* Number of samplers using the entry. Lookups only take a reference while
+    * it's non-zero, an entry at zero is either unused or being freed.
+    */
+   uint32_t ref_count;
+
+   /* Next entry in the hash chain, as custom entry index + 1. */
+   uint32_t next;
+
+   /* Value slots that have been packed so far, including
+    * PVR_BORDER_COLOR_TABLE_ALL_SLOTS. Only set with custom_mutex held.
+    */
+   BITSET_DECLARE(packed, PVR_BORDER_COLOR_TABLE_ALL_SLOTS + 1);
+};
+
 static inline void pvr_border_color_table_pack_single(
    struct pvr_border_color_table_value *const dst,
    const union pipe_color_union *const color,
@@ -128,39 +155,54 @@ pvr_border_color_table_free_entry(struct pvr_border_color_table *const table,
 }
 
 static void
-pvr_border_color_table_fill_entry(struct pvr_border_color_table *const table,
-                                  const uint32_t index,
-                                  const union pipe_color_union *const color,
-                                  const bool is_int,
-                                  const struct pvr_device_info *const dev_info)
+pvr_border_color_table_pack_slot(struct pvr_border_color_table *const table,
+                                 const uint32_t index,
+                                 const uint32_t slot,
+                                 const union pipe_color_union *const color,
+                                 const bool is_int,
+                                 const struct pvr_device_info *const dev_info)
 {
    struct pvr_border_color_table_entry *const entries = table->table->bo->map;
-   struct pvr_border_color_table_entry *const entry = &entries[index];
-   uint32_t tex_format = 0;
+   struct pvr_border_color_table_value *const value =
+      &entries[index].values[slot];
 
-   for (; tex_format < PVR_TEX_FORMAT_COUNT; tex_format++) {
-      if (!pvr_tex_format_is_supported(tex_format))
-         continue;
+   if (slot < PVR_TEX_FORMAT_COUNT) {
+      if (!pvr_tex_format_is_supported(slot))
+         return;
 
-      pvr_border_color_table_pack_single(
-         &entry->values[tex_format],
-         color,
-         pvr_get_tex_format_description(tex_format),
-         is_int);
-   }
-
-   for (; tex_format < PVR_TEX_FORMAT_COUNT * 2; tex_format++) {
-      if (!pvr_tex_format_compressed_is_supported(tex_format))
-         continue;
+      pvr_border_color_table_pack_single(value,
+                                         color,
+                                         pvr_get_tex_format_description(slot),
+                                         is_int);
+   } else {
+      if (!pvr_tex_format_compressed_is_supported(slot))
+         return;
 
       pvr_border_color_table_pack_single_compressed(
-         &entry->values[tex_format],
+         value,
          color,
-         pvr_get_tex_format_compressed_description(tex_format),
+         pvr_get_tex_format_compressed_description(slot),
          dev_info);
    }
 }
 
+static void
+pvr_border_color_table_fill_entry(struct pvr_border_color_table *const table,
+                                  const uint32_t index,
+                                  const union pipe_color_union *const color,
+                                  const bool is_int,
+                                  const struct pvr_device_info *const dev_info)
+{
+   for (uint32_t slot = 0; slot < PVR_TEX_FORMAT_COUNT * 2; slot++) {
+      pvr_border_color_table_pack_slot(table,
+                                       index,
+                                       slot,
+                                       color,
+                                       is_int,
+                                       dev_info);
+   }
+}
+
 VkResult pvr_border_color_table_init(struct pvr_border_color_table *const table,
                                      struct pvr_device *const device)
 {
@@ -174,6 +216,20 @@ VkResult pvr_border_color_table_init(struct pvr_border_color_table *const table,
    /* Initialize to ones so ffs can be used to find unused entries. */
    BITSET_ONES(table->unused_entries);
 
+   table->custom_entries =
+      vk_zalloc(&device->vk.alloc,
+                sizeof(*table->custom_entries) *
+                   PVR_BORDER_COLOR_TABLE_NR_CUSTOM_ENTRIES,
+                8,
+                VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+   if (!table->custom_entries) {
+      result = vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+      goto err_out;
+   }
+
+   memset(table->custom_buckets, 0, sizeof(table->custom_buckets));
+   simple_mtx_init(&table->custom_mutex, mtx_plain);
+
    result = pvr_bo_alloc(device,
                          device->heaps.general_heap,
                          table_size,
@@ -181,7 +237,7 @@ VkResult pvr_border_color_table_init(struct pvr_border_color_table *const table,
                          PVR_BO_ALLOC_FLAG_CPU_MAPPED,
                          &table->table);
    if (result != VK_SUCCESS)
-      goto err_out;
+      goto err_free_custom_entries;
 
    BITSET_CLEAR_RANGE_INSIDE_WORD(table->unused_entries,
                                   0,
@@ -199,10 +255,12 @@ VkResult pvr_border_color_table_init(struct pvr_border_color_table *const table,
                                         dev_info);
    }
 
-   pvr_bo_cpu_unmap(device, table->table);
-
    return VK_SUCCESS;
 
+err_free_custom_entries:
+   simple_mtx_destroy(&table->custom_mutex);
+   vk_free(&device->vk.alloc, table->custom_entries);
+
 err_out:
    return result;
 }
@@ -219,20 +277,286 @@ void pvr_border_color_table_finish(struct pvr_border_color_table *const table,
 #endif
 
    pvr_bo_free(device, table->table);
+
+   simple_mtx_destroy(&table->custom_mutex);
+   vk_free(&device->vk.alloc, table->custom_entries);
+}
+
+/* Returns the table value slot sampling an image view of the given format
+ * reads, or PVR_BORDER_COLOR_TABLE_ALL_SLOTS if it isn't known.
+ */
+static uint32_t pvr_border_color_table_get_slot(const VkFormat format)
+{
+   uint32_t tex_format;
+
+   /* Depth/stencil views can use several tex formats depending on the aspect
+    * being sampled.
+    */
+   if (format == VK_FORMAT_UNDEFINED || vk_format_is_depth_or_stencil(format))
+      return PVR_BORDER_COLOR_TABLE_ALL_SLOTS;
+
+   tex_format = pvr_get_tex_format(format);
+   if (tex_format == ROGUE_TEXSTATE_FORMAT_INVALID)
+      return PVR_BORDER_COLOR_TABLE_ALL_SLOTS;
+
+   if (vk_format_is_compressed(format))
+      return PVR_TEX_FORMAT_COUNT + tex_format;
+
+   return tex_format;
+}
+
+static inline bool pvr_border_color_custom_entry_is_slot_packed(
+   const struct pvr_border_color_custom_entry *const entry,
+   const uint32_t slot)
+{
+   return p_atomic_read(&entry->packed[BITSET_BITWORD(slot)]) &
+          BITSET_BIT(slot);
+}
+
+/* An entry packed for every format doesn't need any single slot packing. */
+static inline bool pvr_border_color_custom_entry_is_packed(
+   const struct pvr_border_color_custom_entry *const entry,
+   const uint32_t slot)
+{
+   return pvr_border_color_custom_entry_is_slot_packed(entry, slot) ||
+          pvr_border_color_custom_entry_is_slot_packed(
+             entry,
+             PVR_BORDER_COLOR_TABLE_ALL_SLOTS);
+}
+
+/* Takes a reference on an entry unless it's unused or being freed. */
+static bool
+pvr_border_color_custom_entry_ref(struct pvr_border_color_custom_entry *entry)
+{
+   uint32_t ref_count = p_atomic_read(&entry->ref_count);
+
+   while (ref_count) {
+      const uint32_t old =
+         p_atomic_cmpxchg(&entry->ref_count, ref_count, ref_count + 1);
+      if (old == ref_count)
+         return true;
+
+      ref_count = old;
+   }
+
+   return false;
+}
+
+static void pvr_border_color_table_free_custom_entry_locked(
+   struct pvr_border_color_table *const table,
+   struct pvr_border_color_custom_entry *const entry)
+{
+   const uint32_t custom_index = entry - table->custom_entries;
+   uint32_t *link = &table->custom_buckets[entry->hash %
+                                           ARRAY_SIZE(table->custom_buckets)];
+
+   simple_mtx_assert_locked(&table->custom_mutex);
+   assert(!p_atomic_read(&entry->ref_count));
+
+   /* Lock-free lookups may still be walking through the entry, so its own
+    * link is left alone until it's reused.
+    */
+   while (*link != custom_index + 1)
+      link = &table->custom_entries[*link - 1].next;
+
+   p_atomic_set(link, entry->next);
+
+   pvr_border_color_table_free_entry(
+      table,
+      PVR_BORDER_COLOR_TABLE_NR_BUILTIN_ENTRIES + custom_index);
+}
+
+static void pvr_border_color_custom_entry_unref(
+   struct pvr_border_color_table *const table,
+   struct pvr_border_color_custom_entry *const entry,
+   const bool locked)
+{
+   if (!p_atomic_dec_zero(&entry->ref_count))
+      return;
+
+   /* Lookups never take a reference on an entry at zero so it can't come
+    * back to life while waiting for the lock.
+    */
+   if (!locked)
+      simple_mtx_lock(&table->custom_mutex);
+
+   pvr_border_color_table_free_custom_entry_locked(table, entry);
+
+   if (!locked)
+      simple_mtx_unlock(&table->custom_mutex);
+}
+
+/* Returns a referenced entry for the color, or NULL if there's none. This is
+ * safe to call without holding custom_mutex.
+ */
+static struct pvr_border_color_custom_entry *
+pvr_border_color_table_find_custom_entry(
+   struct pvr_border_color_table *const table,
+   const VkClearColorValue *const value,
+   const bool is_int,
+   const uint32_t hash,
+   const bool locked)
+{
+   uint32_t next =
+      p_atomic_read(&table->custom_buckets[hash % ARRAY_SIZE(
+                                              table->custom_buckets)]);
+
+   /* Entries can be freed and reused for another color while the chain is
+    * being walked without the lock, which can lead the walk astray. Bound it
+    * so it always terminates, callers retry a miss with the lock held.
+    */
+   for (uint32_t i = 0; next && i < PVR_BORDER_COLOR_TABLE_NR_CUSTOM_ENTRIES;
+        i++) {
+      struct pvr_border_color_custom_entry *const entry =
+         &table->custom_entries[next - 1];
+
+      if (p_atomic_read(&entry->hash) == hash &&
+          pvr_border_color_custom_entry_ref(entry)) {
+         /* The key can't change while we hold a reference. */
+         if (entry->is_int == is_int &&
+             !memcmp(&entry->value, value, sizeof(*value))) {
+            return entry;
+         }
+
+         pvr_border_color_custom_entry_unref(table, entry, locked);
+      }
+
+      next = p_atomic_read(&entry->next);
+   }
+
+   return NULL;
+}
+
+static VkResult pvr_border_color_table_get_or_create_custom_entry(
+   struct pvr_border_color_table *const table,
+   struct pvr_device *const device,
+   const struct pvr_sampler *const sampler,
+   uint32_t *const index_out)
+{
+   const VkClearColorValue *const value = &sampler->vk.border_color_value;
+   const bool is_int = vk_border_color_is_int(sampler->vk.border_color);
+   const union pipe_color_union *const color =
+      (const union pipe_color_union *)value;
+   const uint32_t hash =
+      _mesa_hash_data_with_seed(value, sizeof(*value), is_int);
+   const uint32_t slot = pvr_border_color_table_get_slot(sampler->vk.format);
+   struct pvr_border_color_custom_entry *entry;
+   uint32_t custom_index;
+
+   /* Fast path, the color is already in the table with the format packed. */
+   entry = pvr_border_color_table_find_custom_entry(table,
+                                                    value,
+                                                    is_int,
+                                                    hash,
+                                                    false);
+   if (entry && pvr_border_color_custom_entry_is_packed(entry, slot)) {
+      custom_index = entry - table->custom_entries;
+      *index_out = PVR_BORDER_COLOR_TABLE_NR_BUILTIN_ENTRIES + custom_index;
+      return VK_SUCCESS;
+   }
+
+   simple_mtx_lock(&table->custom_mutex);
+
+   if (!entry) {
+      entry = pvr_border_color_table_find_custom_entry(table,
+                                                       value,
+                                                       is_int,
+                                                       hash,
+                                                       true);
+   }
+
+   if (!entry) {
+      const int32_t index = pvr_border_color_table_alloc_entry(table);
+      uint32_t *bucket;
+
+      if (index < 0) {
+         simple_mtx_unlock(&table->custom_mutex);
+         return vk_error(sampler, VK_ERROR_OUT_OF_DEVICE_MEMORY);
+      }
+
+      custom_index = index - PVR_BORDER_COLOR_TABLE_NR_BUILTIN_ENTRIES;
+      bucket = &table->custom_buckets[hash % ARRAY_SIZE(table->custom_buckets)];
+
+      entry = &table->custom_entries[custom_index];
+      entry->value = *value;
+      entry->is_int = is_int;
+      p_atomic_set(&entry->hash, hash);
+      BITSET_ZERO(entry->packed);
+      entry->next = *bucket;
+
+      /* Publish the key before lookups can take a reference. */
+      p_atomic_set(&entry->ref_count, 1);
+      p_atomic_set(bucket, custom_index + 1);
+   }
+
+   custom_index = entry - table->custom_entries;
+
+   if (!pvr_border_color_custom_entry_is_packed(entry, slot)) {
+      const struct pvr_device_info *const dev_info =
+         &device->pdevice->dev_info;
+      const uint32_t index =
+         PVR_BORDER_COLOR_TABLE_NR_BUILTIN_ENTRIES + custom_index;
+      const uint32_t word = BITSET_BITWORD(slot);
+
+      if (slot == PVR_BORDER_COLOR_TABLE_ALL_SLOTS) {
+         pvr_border_color_table_fill_entry(table,
+                                           index,
+                                           color,
+                                           is_int,
+                                           dev_info);
+      } else {
+         pvr_border_color_table_pack_slot(table,
+                                          index,
+                                          slot,
+                                          color,
+                                          is_int,
+                                          dev_info);
+      }
+
+      /* Only set once the value is in the table so lock-free lookups that
+       * see it can use the entry right away.
+       */
+      p_atomic_set(&entry->packed[word],
+                   entry->packed[word] | BITSET_BIT(slot));
+   }
+
+   simple_mtx_unlock(&table->custom_mutex);
+
+   *index_out = PVR_BORDER_COLOR_TABLE_NR_BUILTIN_ENTRIES + custom_index;
+
+   return VK_SUCCESS;
 }
 
 VkResult pvr_border_color_table_get_or_create_entry(
-   UNUSED struct pvr_border_color_table *const table,
+   struct pvr_border_color_table *const table,
+   struct pvr_device *const device,
    const struct pvr_sampler *const sampler,
    uint32_t *const index_out)
 {
    const VkBorderColor vk_type = sampler->vk.border_color;
 
-   if (vk_type <= PVR_BORDER_COLOR_TABLE_NR_BUILTIN_ENTRIES) {
+   if (vk_type < PVR_BORDER_COLOR_TABLE_NR_BUILTIN_ENTRIES) {
       *index_out = vk_type;
       return VK_SUCCESS;
    }
 
-   pvr_finishme("VK_EXT_custom_border_color is currently unsupported.");
-   return vk_error(sampler, VK_ERROR_EXTENSION_NOT_PRESENT);
+   assert(vk_border_color_is_custom(vk_type));
+
+   return pvr_border_color_table_get_or_create_custom_entry(table,
+                                                            device,
+                                                            sampler,
+                                                            index_out);
+}
+
+void pvr_border_color_table_release_entry(
+   struct pvr_border_color_table *const table,
+   const uint32_t index)
+{
+   if (index < PVR_BORDER_COLOR_TABLE_NR_BUILTIN_ENTRIES)
+      return;
+
+   pvr_border_color_custom_entry_unref(
+      table,
+      &table->custom_entries[index - PVR_BORDER_COLOR_TABLE_NR_BUILTIN_ENTRIES],
+      false);
 }
@@ -30,6 +30,7 @@
 
 #include "pvr_csb.h"
 #include "util/bitset.h"
+#include "util/simple_mtx.h"
 
 #define PVR_BORDER_COLOR_TABLE_NR_ENTRIES \
    (ROGUE_TEXSTATE_SAMPLER_BORDERCOLOR_INDEX_MAX_SIZE + 1)
@@ -41,6 +42,8 @@
    (PVR_BORDER_COLOR_TABLE_NR_ENTRIES -          \
     PVR_BORDER_COLOR_TABLE_NR_BUILTIN_ENTRIES)
 
+#define PVR_BORDER_COLOR_TABLE_NR_CUSTOM_BUCKETS 16U
+
 /* Forward declaration from "pvr_common.h" */
 struct pvr_sampler;
 
@@ -50,13 +53,34 @@ struct pvr_bo;
 /* Forward declaration from "pvr_private.h" */
 struct pvr_device;
 
+/* Defined in "pvr_border.c" */
+struct pvr_border_color_custom_entry;
+
 struct pvr_border_color_table {
    BITSET_DECLARE(unused_entries, PVR_BORDER_COLOR_TABLE_NR_ENTRIES);
 
    /* Contains an array of:
     * PVR_BORDER_COLOR_TABLE_NR_ENTRIES x struct pvr_border_color_table_entry
+    *
+    * Kept mapped so custom entries can be packed when they're first used.
     */
    struct pvr_bo *table;
+
+   /* Protects allocating, packing and freeing custom entries, as well as
+    * unused_entries. Finding an existing entry with all the needed formats
+    * already packed doesn't take it.
+    */
+   simple_mtx_t custom_mutex;
+
+   /* Custom entries are deduplicated by color. These are the heads of the
+    * hash chains, stored as custom entry index + 1 so 0 means empty.
+    */
+   uint32_t custom_buckets[PVR_BORDER_COLOR_TABLE_NR_CUSTOM_BUCKETS];
+
+   /* PVR_BORDER_COLOR_TABLE_NR_CUSTOM_ENTRIES custom entries, the first one
+    * being at index PVR_BORDER_COLOR_TABLE_NR_BUILTIN_ENTRIES in the table.
+    */
+   struct pvr_border_color_custom_entry *custom_entries;
 };
 
 VkResult pvr_border_color_table_init(struct pvr_border_color_table *table,
@@ -66,8 +90,11 @@ void pvr_border_color_table_finish(struct pvr_border_color_table *table,
 
 VkResult
 pvr_border_color_table_get_or_create_entry(struct pvr_border_color_table *table,
+                                           struct pvr_device *device,
                                            const struct pvr_sampler *sampler,
                                            uint32_t *index_out);
+void pvr_border_color_table_release_entry(struct pvr_border_color_table *table,
+                                          uint32_t index);
 
 static inline bool pvr_border_color_table_is_index_valid(
    const struct pvr_border_color_table *const table,
@@ -43,6 +43,7 @@
 #include "pvr_hw_pass.h"
 #include "pvr_job_common.h"
 #include "pvr_job_render.h"
+#include "pvr_job_transfer.h"
 #include "pvr_limits.h"
 #include "pvr_pds.h"
 #include "pvr_private.h"
@@ -55,6 +56,7 @@
 #include "util/compiler.h"
 #include "util/list.h"
 #include "util/macros.h"
+#include "util/u_debug.h"
 #include "util/u_dynarray.h"
 #include "util/u_math.h"
 #include "util/u_pack_color.h"
@@ -97,7 +99,9 @@ static void pvr_cmd_buffer_free_sub_cmd(struct pvr_cmd_buffer *cmd_buffer,
       case PVR_SUB_CMD_TYPE_GRAPHICS:
          util_dynarray_fini(&sub_cmd->gfx.sec_query_indices);
          pvr_csb_finish(&sub_cmd->gfx.control_stream);
-         pvr_bo_free(cmd_buffer->device, sub_cmd->gfx.terminate_ctrl_stream);
+         pvr_csb_bo_pool_release(cmd_buffer->device,
+                                 pvr_cmd_buffer_get_csb_bo_pool(cmd_buffer),
+                                 sub_cmd->gfx.terminate_ctrl_stream);
          pvr_bo_suballoc_free(sub_cmd->gfx.depth_bias_bo);
          pvr_bo_suballoc_free(sub_cmd->gfx.scissor_bo);
          break;
@@ -238,6 +242,75 @@ static VkResult pvr_cmd_buffer_create(struct pvr_device *device,
    return VK_SUCCESS;
 }
 
+/* Maximum number of idle control stream buffer objects kept per command pool.
+ * Can be overridden with the PVR_CSB_POOL_MAX_BOS environment variable.
+ */
+DEBUG_GET_ONCE_NUM_OPTION(csb_pool_max_bos,
+                          "PVR_CSB_POOL_MAX_BOS",
+                          PVR_CSB_BO_POOL_DEFAULT_MAX_FREE)
+
+VkResult pvr_CreateCommandPool(VkDevice _device,
+                               const VkCommandPoolCreateInfo *pCreateInfo,
+                               const VkAllocationCallbacks *pAllocator,
+                               VkCommandPool *pCommandPool)
+{
+   PVR_FROM_HANDLE(pvr_device, device, _device);
+   struct pvr_cmd_pool *pool;
+   VkResult result;
+
+   pool = vk_alloc2(&device->vk.alloc,
+                    pAllocator,
+                    sizeof(*pool),
+                    8,
+                    VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   if (!pool)
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+
+   result =
+      vk_command_pool_init(&device->vk, &pool->vk, pCreateInfo, pAllocator);
+   if (result != VK_SUCCESS) {
+      vk_free2(&device->vk.alloc, pAllocator, pool);
+      return result;
+   }
+
+   pvr_csb_bo_pool_init(&pool->csb_bo_pool,
+                        (uint32_t)debug_get_option_csb_pool_max_bos());
+
+   *pCommandPool = pvr_cmd_pool_to_handle(pool);
+
+   return VK_SUCCESS;
+}
+
+void pvr_DestroyCommandPool(VkDevice _device,
+                            VkCommandPool commandPool,
+                            const VkAllocationCallbacks *pAllocator)
+{
+   PVR_FROM_HANDLE(pvr_device, device, _device);
+   PVR_FROM_HANDLE(pvr_cmd_pool, pool, commandPool);
+
+   if (!pool)
+      return;
+
+   /* Destroying the command buffers releases their control stream buffer
+    * objects back to the pool, so this must come first.
+    */
+   vk_command_pool_finish(&pool->vk);
+   pvr_csb_bo_pool_finish(device, &pool->csb_bo_pool);
+
+   vk_free2(&device->vk.alloc, pAllocator, pool);
+}
+
+void pvr_TrimCommandPool(VkDevice _device,
+                         VkCommandPool commandPool,
+                         VkCommandPoolTrimFlags flags)
+{
+   PVR_FROM_HANDLE(pvr_device, device, _device);
+   PVR_FROM_HANDLE(pvr_cmd_pool, pool, commandPool);
+
+   vk_command_pool_trim(&pool->vk, flags);
+   pvr_csb_bo_pool_trim(device, &pool->csb_bo_pool);
+}
+
 VkResult
 pvr_AllocateCommandBuffers(VkDevice _device,
                            const VkCommandBufferAllocateInfo *pAllocateInfo,
@@ -581,7 +654,10 @@ static VkResult pvr_sub_cmd_gfx_build_terminate_ctrl_stream(
    struct pvr_csb csb;
    VkResult result;
 
-   pvr_csb_init(device, PVR_CMD_STREAM_TYPE_GRAPHICS, &csb);
+   pvr_csb_init(device,
+                pvr_cmd_buffer_get_csb_bo_pool(cmd_buffer),
+                PVR_CMD_STREAM_TYPE_GRAPHICS,
+                &csb);
 
    result = pvr_cmd_buffer_emit_ppp_state(cmd_buffer, &csb);
    if (result != VK_SUCCESS)
@@ -610,34 +686,18 @@ err_csb_finish:
    return result;
 }
 
-static VkResult pvr_setup_texture_state_words(
-   struct pvr_device *device,
+static void pvr_setup_texture_state_words(
    struct pvr_combined_image_sampler_descriptor *descriptor,
    const struct pvr_image_view *image_view)
 {
-   const struct pvr_image *image = vk_to_pvr_image(image_view->vk.image);
-   struct pvr_texture_state_info info = {
-      .format = image_view->vk.format,
-      .mem_layout = image->memlayout,
-      .type = image_view->vk.view_type,
-      .is_cube = image_view->vk.view_type == VK_IMAGE_VIEW_TYPE_CUBE ||
-                 image_view->vk.view_type == VK_IMAGE_VIEW_TYPE_CUBE_ARRAY,
-      .tex_state_type = PVR_TEXTURE_STATE_SAMPLE,
-      .extent = image_view->vk.extent,
-      .mip_levels = 1,
-      .sample_count = image_view->vk.image->samples,
-      .stride = image->physical_extent.width,
-      .addr = image->dev_addr,
-   };
-   const uint8_t *const swizzle = pvr_get_format_swizzle(info.format);
-   VkResult result;
-
-   memcpy(&info.swizzle, swizzle, sizeof(info.swizzle));
+   assert(image_view->vk.image->usage &
+          (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+           VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT));
 
-   /* TODO: Can we use image_view->texture_state instead of generating here? */
-   result = pvr_pack_tex_state(device, &info, descriptor->image);
-   if (result != VK_SUCCESS)
-      return result;
+   /* Packed at image view creation. */
+   memcpy(descriptor->image,
+          image_view->load_op_texture_state,
+          sizeof(descriptor->image));
 
    descriptor->sampler = (union pvr_sampler_descriptor){ 0 };
 
@@ -651,8 +711,6 @@ static VkResult pvr_setup_texture_state_words(
       sampler.magfilter = ROGUE_TEXSTATE_FILTER_POINT;
       sampler.dadjust = ROGUE_TEXSTATE_DADJUST_ZERO_UINT;
    }
-
-   return VK_SUCCESS;
 }
 
 static VkResult
@@ -706,11 +764,8 @@ pvr_load_op_constants_create_and_upload(struct pvr_cmd_buffer *cmd_buffer,
       assert((load_op->clears_loads_state.rt_load_mask &
               load_op->clears_loads_state.rt_clear_mask) == 0);
       if (load_op->clears_loads_state.rt_load_mask & BITFIELD_BIT(i)) {
-         result = pvr_setup_texture_state_words(cmd_buffer->device,
-                                                &texture_states[texture_count],
-                                                image_view);
-         if (result != VK_SUCCESS)
-            return result;
+         pvr_setup_texture_state_words(&texture_states[texture_count],
+                                       image_view);
 
          texture_count++;
       } else if (load_op->clears_loads_state.rt_clear_mask & BITFIELD_BIT(i)) {
@@ -757,11 +812,8 @@ pvr_load_op_constants_create_and_upload(struct pvr_cmd_buffer *cmd_buffer,
 
       image_view = render_pass_info->attachments[attachment->index];
 
-      result = pvr_setup_texture_state_words(cmd_buffer->device,
-                                             &texture_states[texture_count],
-                                             image_view);
-      if (result != VK_SUCCESS)
-         return result;
+      pvr_setup_texture_state_words(&texture_states[texture_count],
+                                    image_view);
 
       texture_count++;
    } else if (has_depth_clear) {
@@ -1274,7 +1326,8 @@ pvr_sub_cmd_gfx_align_ds_subtiles(struct pvr_cmd_buffer *const cmd_buffer,
                                                       &region,
                                                       copy_format,
                                                       copy_format,
-                                                      0);
+                                                      0,
+                                                      NULL);
       if (result != VK_SUCCESS)
          return result;
 
@@ -2059,6 +2112,47 @@ pvr_cmd_buffer_process_deferred_clears(struct pvr_cmd_buffer *cmd_buffer)
    return VK_SUCCESS;
 }
 
+/* Deferred control streams are recorded in host memory since they might need
+ * to be patched with the state of the primary they're executed in. If nothing
+ * needs patching, the stream is the same for every execution so upload it once
+ * here and have primaries link to it rather than copying it.
+ */
+static VkResult
+pvr_sub_cmd_gfx_bake_deferred_ctrl_stream(struct pvr_cmd_buffer *cmd_buffer,
+                                          struct pvr_sub_cmd_gfx *gfx_sub_cmd)
+{
+   const struct pvr_csb *csb = &gfx_sub_cmd->control_stream;
+   const size_t size = util_dynarray_num_elements(&csb->deferred_cs_mem, char);
+   struct pvr_suballoc_bo *suballoc_bo;
+   VkResult result;
+
+   assert(csb->stream_type == PVR_CMD_STREAM_TYPE_GRAPHICS_DEFERRED);
+
+   /* See pvr_execute_deferred_cmd_buffer(). */
+   if (util_dynarray_num_elements(&cmd_buffer->deferred_csb_commands,
+                                  struct pvr_deferred_cs_command) > 0) {
+      return VK_SUCCESS;
+   }
+
+   /* Leave room for the guard as the VDM might read past the end of the
+    * stream.
+    */
+   result = pvr_cmd_buffer_alloc_mem(cmd_buffer,
+                                     cmd_buffer->device->heaps.general_heap,
+                                     size + ROGUE_VDMCTRL_GUARD_SIZE_DEFAULT,
+                                     &suballoc_bo);
+   if (result != VK_SUCCESS)
+      return result;
+
+   memcpy(pvr_bo_suballoc_get_map_addr(suballoc_bo),
+          util_dynarray_begin(&csb->deferred_cs_mem),
+          size);
+
+   gfx_sub_cmd->deferred_ctrl_stream = suballoc_bo;
+
+   return VK_SUCCESS;
+}
+
 VkResult pvr_cmd_buffer_end_sub_cmd(struct pvr_cmd_buffer *cmd_buffer)
 {
    struct pvr_cmd_buffer_state *state = &cmd_buffer->state;
@@ -2122,6 +2216,14 @@ VkResult pvr_cmd_buffer_end_sub_cmd(struct pvr_cmd_buffer *cmd_buffer)
          if (result != VK_SUCCESS)
             return pvr_cmd_buffer_set_error_unwarned(cmd_buffer, result);
 
+         if (gfx_sub_cmd->control_stream.stream_type ==
+             PVR_CMD_STREAM_TYPE_GRAPHICS_DEFERRED) {
+            result = pvr_sub_cmd_gfx_bake_deferred_ctrl_stream(cmd_buffer,
+                                                               gfx_sub_cmd);
+            if (result != VK_SUCCESS)
+               return result;
+         }
+
          break;
       }
 
@@ -2307,6 +2409,8 @@ void pvr_reset_graphics_dirty_state(struct pvr_cmd_buffer *const cmd_buffer,
    cmd_buffer->state.dirty.vertex_bindings = true;
    cmd_buffer->state.dirty.gfx_pipeline_binding = true;
 
+   cmd_buffer->state.vdm_state.valid = false;
+
    BITSET_SET(dynamic_state->dirty, MESA_VK_DYNAMIC_VP_VIEWPORTS);
    BITSET_SET(dynamic_state->dirty, MESA_VK_DYNAMIC_VP_VIEWPORT_COUNT);
 }
@@ -2335,6 +2439,11 @@ VkResult pvr_cmd_buffer_start_sub_cmd(struct pvr_cmd_buffer *cmd_buffer,
    if (vk_command_buffer_has_error(&cmd_buffer->vk))
       return vk_command_buffer_get_record_result(&cmd_buffer->vk);
 
+   /* Any held back query program must go before the work about to be added. */
+   result = pvr_cmd_buffer_flush_pending_query(cmd_buffer);
+   if (result != VK_SUCCESS)
+      return result;
+
    pvr_cmd_buffer_update_barriers(cmd_buffer, type);
 
    /* TODO: Add proper support for joining consecutive event sub_cmd? */
@@ -2383,10 +2492,12 @@ VkResult pvr_cmd_buffer_start_sub_cmd(struct pvr_cmd_buffer *cmd_buffer,
 
       if (pvr_cmd_uses_deferred_cs_cmds(cmd_buffer)) {
          pvr_csb_init(device,
+                      NULL,
                       PVR_CMD_STREAM_TYPE_GRAPHICS_DEFERRED,
                       &sub_cmd->gfx.control_stream);
       } else {
          pvr_csb_init(device,
+                      pvr_cmd_buffer_get_csb_bo_pool(cmd_buffer),
                       PVR_CMD_STREAM_TYPE_GRAPHICS,
                       &sub_cmd->gfx.control_stream);
       }
@@ -2397,6 +2508,7 @@ VkResult pvr_cmd_buffer_start_sub_cmd(struct pvr_cmd_buffer *cmd_buffer,
    case PVR_SUB_CMD_TYPE_OCCLUSION_QUERY:
    case PVR_SUB_CMD_TYPE_COMPUTE:
       pvr_csb_init(device,
+                   pvr_cmd_buffer_get_csb_bo_pool(cmd_buffer),
                    PVR_CMD_STREAM_TYPE_COMPUTE,
                    &sub_cmd->compute.control_stream);
       break;
@@ -2671,6 +2783,7 @@ void pvr_CmdBindVertexBuffers(VkCommandBuffer commandBuffer,
 {
    PVR_FROM_HANDLE(pvr_cmd_buffer, cmd_buffer, commandBuffer);
    struct pvr_vertex_binding *const vb = cmd_buffer->state.vertex_bindings;
+   bool changed = false;
 
    /* We have to defer setting up vertex buffer since we need the buffer
     * stride from the pipeline.
@@ -2682,11 +2795,23 @@ void pvr_CmdBindVertexBuffers(VkCommandBuffer commandBuffer,
    PVR_CHECK_COMMAND_BUFFER_BUILDING_STATE(cmd_buffer);
 
    for (uint32_t i = 0; i < bindingCount; i++) {
-      vb[firstBinding + i].buffer = pvr_buffer_from_handle(pBuffers[i]);
+      struct pvr_buffer *const buffer = pvr_buffer_from_handle(pBuffers[i]);
+
+      if (vb[firstBinding + i].buffer == buffer &&
+          vb[firstBinding + i].offset == pOffsets[i]) {
+         continue;
+      }
+
+      vb[firstBinding + i].buffer = buffer;
       vb[firstBinding + i].offset = pOffsets[i];
+      changed = true;
    }
 
-   cmd_buffer->state.dirty.vertex_bindings = true;
+   /* Rebinding the same buffers doesn't need a new PDS data section. */
+   if (changed) {
+      cmd_buffer->state.vertex_bindings_generation++;
+      cmd_buffer->state.dirty.vertex_bindings = true;
+   }
 }
 
 void pvr_CmdBindIndexBuffer(VkCommandBuffer commandBuffer,
@@ -2784,12 +2909,12 @@ static VkResult pvr_init_render_targets(struct pvr_device *device,
             &pass->hw_setup->renders[i];
          VkResult result;
 
-         result = pvr_render_target_dataset_create(device,
-                                                   framebuffer->width,
-                                                   framebuffer->height,
-                                                   hw_render->sample_count,
-                                                   framebuffer->layers,
-                                                   &render_target->rt_dataset);
+         result = pvr_render_target_dataset_acquire(device,
+                                                    framebuffer->width,
+                                                    framebuffer->height,
+                                                    hw_render->sample_count,
+                                                    framebuffer->layers,
+                                                    &render_target->rt_dataset);
          if (result != VK_SUCCESS) {
             pthread_mutex_unlock(&render_target->mutex);
             return result;
@@ -3301,6 +3426,166 @@ VkResult pvr_BeginCommandBuffer(VkCommandBuffer commandBuffer,
    return VK_SUCCESS;
 }
 
+/* Returns true and sets rect_out to the union of a and b if the two rects are
+ * adjacent and their union is itself a rectangle.
+ */
+static bool pvr_transfer_rect_union(const VkRect2D *const a,
+                                    const VkRect2D *const b,
+                                    VkRect2D *const rect_out)
+{
+   if (a->offset.y == b->offset.y && a->extent.height == b->extent.height) {
+      if (a->offset.x + (int32_t)a->extent.width == b->offset.x) {
+         *rect_out = *a;
+         rect_out->extent.width += b->extent.width;
+         return true;
+      }
+
+      if (b->offset.x + (int32_t)b->extent.width == a->offset.x) {
+         *rect_out = *b;
+         rect_out->extent.width += a->extent.width;
+         return true;
+      }
+   }
+
+   if (a->offset.x == b->offset.x && a->extent.width == b->extent.width) {
+      if (a->offset.y + (int32_t)a->extent.height == b->offset.y) {
+         *rect_out = *a;
+         rect_out->extent.height += b->extent.height;
+         return true;
+      }
+
+      if (b->offset.y + (int32_t)b->extent.height == a->offset.y) {
+         *rect_out = *b;
+         rect_out->extent.height += a->extent.height;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+static inline bool pvr_transfer_rect_equal(const VkRect2D *const a,
+                                           const VkRect2D *const b)
+{
+   return a->offset.x == b->offset.x && a->offset.y == b->offset.y &&
+          a->extent.width == b->extent.width &&
+          a->extent.height == b->extent.height;
+}
+
+static inline bool
+pvr_transfer_surface_equal(const struct pvr_transfer_cmd_surface *const a,
+                           const struct pvr_transfer_cmd_surface *const b)
+{
+   return a->dev_addr.addr == b->dev_addr.addr &&
+          a->uv_address[0].addr == b->uv_address[0].addr &&
+          a->uv_address[1].addr == b->uv_address[1].addr &&
+          a->width == b->width && a->height == b->height &&
+          a->depth == b->depth && a->z_position == b->z_position &&
+          a->stride == b->stride && a->vk_format == b->vk_format &&
+          a->mem_layout == b->mem_layout &&
+          a->sample_count == b->sample_count;
+}
+
+/* Try to fold transfer_cmd into prev_cmd, the last command queued on the
+ * current transfer sub command. This is only done when both commands access
+ * the same surfaces in the same way and the destination rects form a single
+ * larger rectangle, so the merged command is exactly equivalent to running
+ * both. Copying many adjacent regions (e.g. a texture uploaded in tiles) then
+ * results in a single transfer job rather than one job per region.
+ */
+static bool pvr_transfer_cmd_merge(struct pvr_transfer_cmd *const prev_cmd,
+                                   const struct pvr_transfer_cmd *const cmd)
+{
+   const struct pvr_rect_mapping *prev_mapping;
+   const struct pvr_rect_mapping *mapping;
+   VkRect2D src_rect;
+   VkRect2D dst_rect;
+
+   if (prev_cmd->is_deferred_clear || cmd->is_deferred_clear)
+      return false;
+
+   if (prev_cmd->flags != cmd->flags ||
+       prev_cmd->source_count != cmd->source_count ||
+       prev_cmd->source_count > 1U) {
+      return false;
+   }
+
+   if (!pvr_transfer_surface_equal(&prev_cmd->dst, &cmd->dst))
+      return false;
+
+   if (cmd->source_count == 0U) {
+      if (!(cmd->flags & PVR_TRANSFER_CMD_FLAGS_FILL) ||
+          memcmp(prev_cmd->clear_color,
+                 cmd->clear_color,
+                 sizeof(cmd->clear_color)) != 0) {
+         return false;
+      }
+
+      if (!pvr_transfer_rect_union(&prev_cmd->scissor,
+                                   &cmd->scissor,
+                                   &dst_rect)) {
+         return false;
+      }
+
+      prev_cmd->scissor = dst_rect;
+
+      return true;
+   }
+
+   if (prev_cmd->sources[0].mapping_count != 1U ||
+       cmd->sources[0].mapping_count != 1U ||
+       prev_cmd->sources[0].addr_mode != cmd->sources[0].addr_mode ||
+       prev_cmd->sources[0].filter != cmd->sources[0].filter ||
+       prev_cmd->sources[0].resolve_op != cmd->sources[0].resolve_op ||
+       !pvr_transfer_surface_equal(&prev_cmd->sources[0].surface,
+                                   &cmd->sources[0].surface)) {
+      return false;
+   }
+
+   prev_mapping = &prev_cmd->sources[0].mappings[0];
+   mapping = &cmd->sources[0].mappings[0];
+
+   /* Only unscaled, unflipped copies which cover their whole scissor. */
+   if (prev_mapping->flip_x || prev_mapping->flip_y || mapping->flip_x ||
+       mapping->flip_y ||
+       !pvr_transfer_rect_equal(&prev_mapping->dst_rect, &prev_cmd->scissor) ||
+       !pvr_transfer_rect_equal(&mapping->dst_rect, &cmd->scissor) ||
+       prev_mapping->src_rect.extent.width !=
+          prev_mapping->dst_rect.extent.width ||
+       prev_mapping->src_rect.extent.height !=
+          prev_mapping->dst_rect.extent.height ||
+       mapping->src_rect.extent.width != mapping->dst_rect.extent.width ||
+       mapping->src_rect.extent.height != mapping->dst_rect.extent.height) {
+      return false;
+   }
+
+   /* Both regions must be offset from their source by the same amount. */
+   if (prev_mapping->dst_rect.offset.x - prev_mapping->src_rect.offset.x !=
+          mapping->dst_rect.offset.x - mapping->src_rect.offset.x ||
+       prev_mapping->dst_rect.offset.y - prev_mapping->src_rect.offset.y !=
+          mapping->dst_rect.offset.y - mapping->src_rect.offset.y) {
+      return false;
+   }
+
+   if (!pvr_transfer_rect_union(&prev_mapping->src_rect,
+                                &mapping->src_rect,
+                                &src_rect) ||
+       !pvr_transfer_rect_union(&prev_mapping->dst_rect,
+                                &mapping->dst_rect,
+                                &dst_rect)) {
+      return false;
+   }
+
+   prev_cmd->sources[0].mappings[0].src_rect = src_rect;
+   prev_cmd->sources[0].mappings[0].dst_rect = dst_rect;
+   prev_cmd->scissor = dst_rect;
+
+   return true;
+}
+
+/* On success ownership of transfer_cmd is passed to the command buffer, which
+ * may free it immediately if it could be merged into a previous command.
+ */
 VkResult pvr_cmd_buffer_add_transfer_cmd(struct pvr_cmd_buffer *cmd_buffer,
                                          struct pvr_transfer_cmd *transfer_cmd)
 {
@@ -3313,6 +3598,21 @@ VkResult pvr_cmd_buffer_add_transfer_cmd(struct pvr_cmd_buffer *cmd_buffer,
 
    sub_cmd = &cmd_buffer->state.current_sub_cmd->transfer;
 
+   if (!list_is_empty(sub_cmd->transfer_cmds)) {
+      struct pvr_transfer_cmd *const prev_cmd =
+         list_last_entry(sub_cmd->transfer_cmds, struct pvr_transfer_cmd, link);
+
+      if (pvr_transfer_cmd_merge(prev_cmd, transfer_cmd)) {
+         /* The CPU description only covers the region of prev_cmd, so the
+          * merged command has to take the GPU path.
+          */
+         prev_cmd->cpu.enabled = false;
+
+         vk_free(&cmd_buffer->vk.pool->alloc, transfer_cmd);
+         return VK_SUCCESS;
+      }
+   }
+
    list_addtail(&transfer_cmd->link, sub_cmd->transfer_cmds);
 
    return VK_SUCCESS;
@@ -3326,12 +3626,37 @@ pvr_setup_vertex_buffers(struct pvr_cmd_buffer *cmd_buffer,
       &gfx_pipeline->shader_state.vertex;
    struct pvr_cmd_buffer_state *const state = &cmd_buffer->state;
    const struct pvr_pds_info *const pds_info = state->pds_shader.info;
+   const struct pvr_pds_vertex_attrib_data_key key = {
+      .info = pds_info,
+      .vertex_bindings_generation = state->vertex_bindings_generation,
+      .base_instance = state->draw_state.base_instance,
+      .base_vertex = state->draw_state.base_vertex,
+   };
    struct pvr_suballoc_bo *pvr_bo;
    const uint8_t *entries;
    uint32_t *dword_buffer;
    uint64_t *qword_buffer;
+   uint32_t cache_slot;
    VkResult result;
 
+   /* Draws often switch back and forth between a few pipelines and vertex
+    * buffers, so reuse a data section uploaded for the same inputs.
+    */
+   for (uint32_t i = 0; i < PVR_PDS_VERTEX_ATTRIB_DATA_CACHE_SIZE; i++) {
+      const struct pvr_pds_vertex_attrib_data_key *const cached_key =
+         &state->pds_vertex_attrib_data_cache.keys[i];
+
+      if (cached_key->info == key.info &&
+          cached_key->vertex_bindings_generation ==
+             key.vertex_bindings_generation &&
+          cached_key->base_instance == key.base_instance &&
+          cached_key->base_vertex == key.base_vertex) {
+         state->pds_vertex_attrib_offset =
+            state->pds_vertex_attrib_data_cache.offsets[i];
+         return VK_SUCCESS;
+      }
+   }
+
    result =
       pvr_cmd_buffer_alloc_mem(cmd_buffer,
                                cmd_buffer->device->heaps.pds_heap,
@@ -3523,6 +3848,13 @@ pvr_setup_vertex_buffers(struct pvr_cmd_buffer *cmd_buffer,
       pvr_bo->dev_addr.addr -
       cmd_buffer->device->heaps.pds_heap->base_addr.addr;
 
+   cache_slot = state->pds_vertex_attrib_data_cache.next;
+   state->pds_vertex_attrib_data_cache.keys[cache_slot] = key;
+   state->pds_vertex_attrib_data_cache.offsets[cache_slot] =
+      state->pds_vertex_attrib_offset;
+   state->pds_vertex_attrib_data_cache.next =
+      (cache_slot + 1) % PVR_PDS_VERTEX_ATTRIB_DATA_CACHE_SIZE;
+
    return VK_SUCCESS;
 }
 
@@ -3920,13 +4252,17 @@ static VkResult pvr_cmd_buffer_upload_patched_desc_set(
               desc_idx < binding->descriptor_count;
               desc_idx++) {
             /* clang-format on */
+            const uint32_t dynamic_offset =
+               dynamic_offsets[desc_idx + desc_idx_offset];
             const pvr_dev_addr_t addr =
                PVR_DEV_ADDR_OFFSET(descriptors[desc_idx].buffer_dev_addr,
-                                   dynamic_offsets[desc_idx + desc_idx_offset]);
-            const VkDeviceSize range =
+                                   dynamic_offset);
+            /* The range written to the secondary must not reach past the end
+             * of the buffer once the dynamic offset has been applied.
+             */
+            const uint32_t range =
                MIN2(descriptors[desc_idx].buffer_desc_range,
-                    descriptors[desc_idx].buffer_whole_range -
-                       dynamic_offsets[desc_idx]);
+                    descriptors[desc_idx].buffer_whole_range - dynamic_offset);
 
 #if MESA_DEBUG
             uint32_t desc_primary_offset;
@@ -5385,25 +5721,17 @@ pvr_setup_triangle_merging_flag(struct pvr_cmd_buffer *const cmd_buffer,
 {
    struct ROGUE_TA_STATE_HEADER *const header = &cmd_buffer->state.emit_header;
    struct pvr_ppp_state *const ppp_state = &cmd_buffer->state.ppp_state;
-   uint32_t merge_word;
-   uint32_t mask;
+   uint32_t merge_word = ppp_state->pds.size_info2;
 
-   pvr_csb_pack (&merge_word, TA_STATE_PDS_SIZEINFO2, size_info) {
-      /* Disable for lines or punch-through or for DWD and depth compare
-       * always.
-       */
-      if (ispa->objtype == ROGUE_TA_OBJTYPE_LINE ||
-          ispa->passtype == ROGUE_TA_PASSTYPE_PUNCH_THROUGH ||
-          (ispa->dwritedisable && ispa->dcmpmode == ROGUE_TA_CMPMODE_ALWAYS)) {
-         size_info.pds_tri_merge_disable = true;
-      }
-   }
-
-   pvr_csb_pack (&mask, TA_STATE_PDS_SIZEINFO2, size_info) {
-      size_info.pds_tri_merge_disable = true;
-   }
-
-   merge_word |= ppp_state->pds.size_info2 & ~mask;
+   /* Disable for lines or punch-through or for DWD and depth compare always.
+    */
+   pvr_csb_repack(&merge_word,
+                  TA_STATE_PDS_SIZEINFO2,
+                  pds_tri_merge_disable,
+                  ispa->objtype == ROGUE_TA_OBJTYPE_LINE ||
+                     ispa->passtype == ROGUE_TA_PASSTYPE_PUNCH_THROUGH ||
+                     (ispa->dwritedisable &&
+                      ispa->dcmpmode == ROGUE_TA_CMPMODE_ALWAYS));
 
    if (merge_word != ppp_state->pds.size_info2) {
       ppp_state->pds.size_info2 = merge_word;
@@ -5576,58 +5904,96 @@ static void pvr_setup_viewport(struct pvr_cmd_buffer *const cmd_buffer)
    }
 }
 
+static enum ROGUE_TA_CULLMODE
+pvr_ppp_control_cullmode(const struct vk_dynamic_graphics_state *dynamic_state)
+{
+   /* +--- FrontIsCCW?
+    * | +--- Cull Front?
+    * v v
+    * 0|0 CULLMODE_CULL_CCW,
+    * 0|1 CULLMODE_CULL_CW,
+    * 1|0 CULLMODE_CULL_CW,
+    * 1|1 CULLMODE_CULL_CCW,
+    */
+   switch (dynamic_state->rs.cull_mode) {
+   case VK_CULL_MODE_BACK_BIT:
+   case VK_CULL_MODE_FRONT_BIT:
+      if ((dynamic_state->rs.front_face == VK_FRONT_FACE_COUNTER_CLOCKWISE) ^
+          (dynamic_state->rs.cull_mode == VK_CULL_MODE_FRONT_BIT)) {
+         return ROGUE_TA_CULLMODE_CULL_CW;
+      }
+
+      return ROGUE_TA_CULLMODE_CULL_CCW;
+
+   case VK_CULL_MODE_FRONT_AND_BACK:
+   case VK_CULL_MODE_NONE:
+      return ROGUE_TA_CULLMODE_NO_CULLING;
+
+   default:
+      unreachable("Unsupported cull mode!");
+   }
+}
+
+void
+pvr_ppp_control_repack(uint32_t *const ppp_control,
+                       const struct vk_dynamic_graphics_state *dynamic_state,
+                       const BITSET_WORD *const states)
+{
+   if (BITSET_TEST(states, MESA_VK_DYNAMIC_IA_PRIMITIVE_TOPOLOGY)) {
+      const VkPrimitiveTopology topology = dynamic_state->ia.primitive_topology;
+
+      pvr_csb_repack(ppp_control,
+                     TA_STATE_PPP_CTRL,
+                     flatshade_vtx,
+                     topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN
+                        ? ROGUE_TA_FLATSHADE_VTX_VERTEX_1
+                        : ROGUE_TA_FLATSHADE_VTX_VERTEX_0);
+   }
+
+   if (BITSET_TEST(states, MESA_VK_DYNAMIC_RS_DEPTH_CLAMP_ENABLE)) {
+      pvr_csb_repack(ppp_control,
+                     TA_STATE_PPP_CTRL,
+                     clip_mode,
+                     dynamic_state->rs.depth_clamp_enable
+                        ? ROGUE_TA_CLIP_MODE_NO_FRONT_OR_REAR
+                        : ROGUE_TA_CLIP_MODE_FRONT_REAR);
+   }
+
+   if (BITSET_TEST(states, MESA_VK_DYNAMIC_RS_CULL_MODE) ||
+       BITSET_TEST(states, MESA_VK_DYNAMIC_RS_FRONT_FACE)) {
+      pvr_csb_repack(ppp_control,
+                     TA_STATE_PPP_CTRL,
+                     cullmode,
+                     pvr_ppp_control_cullmode(dynamic_state));
+   }
+}
+
 static void pvr_setup_ppp_control(struct pvr_cmd_buffer *const cmd_buffer)
 {
    struct vk_dynamic_graphics_state *const dynamic_state =
       &cmd_buffer->vk.dynamic_graphics_state;
-   const VkPrimitiveTopology topology = dynamic_state->ia.primitive_topology;
    struct pvr_cmd_buffer_state *const state = &cmd_buffer->state;
+   const struct pvr_graphics_pipeline *const gfx_pipeline = state->gfx_pipeline;
    struct ROGUE_TA_STATE_HEADER *const header = &state->emit_header;
    struct pvr_ppp_state *const ppp_state = &state->ppp_state;
    uint32_t ppp_control;
 
-   pvr_csb_pack (&ppp_control, TA_STATE_PPP_CTRL, control) {
-      control.drawclippededges = true;
-      control.wclampen = true;
-
-      if (topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN)
-         control.flatshade_vtx = ROGUE_TA_FLATSHADE_VTX_VERTEX_1;
-      else
-         control.flatshade_vtx = ROGUE_TA_FLATSHADE_VTX_VERTEX_0;
-
-      if (dynamic_state->rs.depth_clamp_enable)
-         control.clip_mode = ROGUE_TA_CLIP_MODE_NO_FRONT_OR_REAR;
-      else
-         control.clip_mode = ROGUE_TA_CLIP_MODE_FRONT_REAR;
-
-      /* +--- FrontIsCCW?
-       * | +--- Cull Front?
-       * v v
-       * 0|0 CULLMODE_CULL_CCW,
-       * 0|1 CULLMODE_CULL_CW,
-       * 1|0 CULLMODE_CULL_CW,
-       * 1|1 CULLMODE_CULL_CCW,
-       */
-      switch (dynamic_state->rs.cull_mode) {
-      case VK_CULL_MODE_BACK_BIT:
-      case VK_CULL_MODE_FRONT_BIT:
-         if ((dynamic_state->rs.front_face == VK_FRONT_FACE_COUNTER_CLOCKWISE) ^
-             (dynamic_state->rs.cull_mode == VK_CULL_MODE_FRONT_BIT)) {
-            control.cullmode = ROGUE_TA_CULLMODE_CULL_CW;
-         } else {
-            control.cullmode = ROGUE_TA_CULLMODE_CULL_CCW;
-         }
-
-         break;
+   /* The pipeline's control word already has the fields derived from its
+    * static state packed, so on a new binding (which includes every reset of
+    * the graphics state) only the fields derived from dynamic state are
+    * repacked. Otherwise only the fields whose state changed are.
+    */
+   if (state->dirty.gfx_pipeline_binding) {
+      BITSET_DECLARE(dynamic_states, MESA_VK_DYNAMIC_GRAPHICS_STATE_ENUM_MAX);
 
-      case VK_CULL_MODE_FRONT_AND_BACK:
-      case VK_CULL_MODE_NONE:
-         control.cullmode = ROGUE_TA_CULLMODE_NO_CULLING;
-         break;
+      BITSET_COPY(dynamic_states, gfx_pipeline->dynamic_state.set);
+      BITSET_NOT(dynamic_states);
 
-      default:
-         unreachable("Unsupported cull mode!");
-      }
+      ppp_control = gfx_pipeline->ppp_control;
+      pvr_ppp_control_repack(&ppp_control, dynamic_state, dynamic_states);
+   } else {
+      ppp_control = ppp_state->ppp_control;
+      pvr_ppp_control_repack(&ppp_control, dynamic_state, dynamic_state->dirty);
    }
 
    if (ppp_control != ppp_state->ppp_control) {
@@ -5976,7 +6342,11 @@ pvr_ppp_state_update_required(const struct pvr_cmd_buffer *cmd_buffer)
           BITSET_TEST(dynamic_dirty, MESA_VK_DYNAMIC_DS_STENCIL_COMPARE_MASK) ||
           BITSET_TEST(dynamic_dirty, MESA_VK_DYNAMIC_DS_STENCIL_WRITE_MASK) ||
           BITSET_TEST(dynamic_dirty, MESA_VK_DYNAMIC_DS_STENCIL_REFERENCE) ||
+          BITSET_TEST(dynamic_dirty, MESA_VK_DYNAMIC_IA_PRIMITIVE_TOPOLOGY) ||
+          BITSET_TEST(dynamic_dirty, MESA_VK_DYNAMIC_RS_CULL_MODE) ||
           BITSET_TEST(dynamic_dirty, MESA_VK_DYNAMIC_RS_DEPTH_BIAS_ENABLE) ||
+          BITSET_TEST(dynamic_dirty, MESA_VK_DYNAMIC_RS_DEPTH_CLAMP_ENABLE) ||
+          BITSET_TEST(dynamic_dirty, MESA_VK_DYNAMIC_RS_FRONT_FACE) ||
           BITSET_TEST(dynamic_dirty, MESA_VK_DYNAMIC_RS_DEPTH_BIAS_FACTORS) ||
           BITSET_TEST(dynamic_dirty, MESA_VK_DYNAMIC_RS_LINE_WIDTH) ||
           BITSET_TEST(dynamic_dirty, MESA_VK_DYNAMIC_VP_SCISSORS) ||
@@ -6132,20 +6502,23 @@ void pvr_calculate_vertex_cam_size(const struct pvr_device_info *dev_info,
 static void pvr_emit_dirty_vdm_state(struct pvr_cmd_buffer *const cmd_buffer,
                                      struct pvr_sub_cmd_gfx *const sub_cmd)
 {
-   /* FIXME: Assume all state is dirty for the moment. */
    struct pvr_device_info *const dev_info =
       &cmd_buffer->device->pdevice->dev_info;
    ASSERTED const uint32_t max_user_vertex_output_components =
       pvr_get_max_user_vertex_output_components(dev_info);
-   struct ROGUE_VDMCTRL_VDM_STATE0 header = { pvr_cmd_header(
-      VDMCTRL_VDM_STATE0) };
    struct vk_dynamic_graphics_state *const dynamic_state =
       &cmd_buffer->vk.dynamic_graphics_state;
-   const struct pvr_cmd_buffer_state *const state = &cmd_buffer->state;
+   struct pvr_cmd_buffer_state *const state = &cmd_buffer->state;
    const pco_data *const vs_data = &state->gfx_pipeline->vs_data;
    struct pvr_csb *const csb = &sub_cmd->control_stream;
+   const bool cut_index_enable = dynamic_state->ia.primitive_restart_enable;
+   bool vs_data_addr_present;
+   bool cut_index_present;
+   bool vs_other_present;
+   uint32_t cut_index = 0;
    uint32_t max_instances;
    uint32_t cam_size;
+   uint32_t state0_word;
 
    /* CAM Calculations and HW state take vertex size aligned to DWORDS. */
    assert(vs_data->vs.vtxouts <= max_user_vertex_output_components);
@@ -6156,15 +6529,9 @@ static void pvr_emit_dirty_vdm_state(struct pvr_cmd_buffer *const cmd_buffer,
                                  &cam_size,
                                  &max_instances);
 
-   pvr_csb_set_relocation_mark(csb);
-
-   pvr_csb_emit (csb, VDMCTRL_VDM_STATE0, state0) {
+   pvr_csb_pack (&state0_word, VDMCTRL_VDM_STATE0, state0) {
       state0.cam_size = cam_size;
-
-      if (dynamic_state->ia.primitive_restart_enable) {
-         state0.cut_index_enable = true;
-         state0.cut_index_present = true;
-      }
+      state0.cut_index_enable = cut_index_enable;
 
       switch (dynamic_state->ia.primitive_topology) {
       case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN:
@@ -6176,23 +6543,6 @@ static void pvr_emit_dirty_vdm_state(struct pvr_cmd_buffer *const cmd_buffer,
          break;
       }
 
-      /* If we've bound a different vertex buffer, or this draw-call requires
-       * a different PDS attrib data-section from the last draw call (changed
-       * base_instance) then we need to specify a new data section. This is
-       * also the case if we've switched pipeline or attrib program as the
-       * data-section layout will be different.
-       */
-      state0.vs_data_addr_present =
-         state->dirty.gfx_pipeline_binding || state->dirty.vertex_bindings ||
-         state->dirty.draw_base_instance || state->dirty.draw_variant;
-
-      /* Need to specify new PDS Attrib program if we've bound a different
-       * pipeline or we needed a different PDS Attrib variant for this
-       * draw-call.
-       */
-      state0.vs_other_present = state->dirty.gfx_pipeline_binding ||
-                                state->dirty.draw_variant;
-
       /* UVB_SCRATCH_SELECT_ONE with no rasterization is only valid when
        * stream output is enabled. We use UVB_SCRATCH_SELECT_FIVE because
        * Vulkan doesn't support stream output and the vertex position is
@@ -6200,25 +6550,81 @@ static void pvr_emit_dirty_vdm_state(struct pvr_cmd_buffer *const cmd_buffer,
        */
       state0.uvs_scratch_size_select =
          ROGUE_VDMCTRL_UVS_SCRATCH_SIZE_SELECT_FIVE;
-
-      header = state0;
    }
 
-   if (header.cut_index_present) {
+   if (cut_index_enable)
+      cut_index = vk_index_to_restart(state->index_buffer_binding.type);
+
+   /* VDM state persists across draws within a control stream, so only the
+    * words which differ from what was last emitted need sending.
+    */
+   if (state->vdm_state.valid) {
+      cut_index_present = cut_index_enable &&
+                          state->vdm_state.cut_index != cut_index;
+
+      /* A new PDS data section is needed if we've bound a different vertex
+       * buffer or pipeline, or this draw-call requires a different PDS attrib
+       * variant or base_instance, unless one with the same contents was
+       * already uploaded and is still in use.
+       */
+      vs_data_addr_present = state->vdm_state.vs_pds_data_offset !=
+                             state->pds_vertex_attrib_offset;
+
+      /* A new PDS Attrib program is needed if we've bound a different pipeline
+       * or we needed a different PDS Attrib variant for this draw-call.
+       */
+      vs_other_present =
+         state->vdm_state.vs_pds_info != state->pds_shader.info ||
+         state->vdm_state.vs_pds_code_offset != state->pds_shader.code_offset;
+
+      if (state->vdm_state.state0 == state0_word && !cut_index_present &&
+          !vs_data_addr_present && !vs_other_present) {
+         return;
+      }
+   } else {
+      cut_index_present = cut_index_enable;
+      vs_data_addr_present = true;
+      vs_other_present = true;
+   }
+
+   state->vdm_state.valid = true;
+   state->vdm_state.state0 = state0_word;
+
+   pvr_csb_repack(&state0_word,
+                  VDMCTRL_VDM_STATE0,
+                  cut_index_present,
+                  cut_index_present);
+   pvr_csb_repack(&state0_word,
+                  VDMCTRL_VDM_STATE0,
+                  vs_data_addr_present,
+                  vs_data_addr_present);
+   pvr_csb_repack(&state0_word,
+                  VDMCTRL_VDM_STATE0,
+                  vs_other_present,
+                  vs_other_present);
+
+   pvr_csb_set_relocation_mark(csb);
+
+   pvr_csb_emit_dword(csb, state0_word);
+
+   if (cut_index_present) {
       pvr_csb_emit (csb, VDMCTRL_VDM_STATE1, state1) {
-         state1.cut_index =
-            vk_index_to_restart(state->index_buffer_binding.type);
+         state1.cut_index = cut_index;
       }
+
+      state->vdm_state.cut_index = cut_index;
    }
 
-   if (header.vs_data_addr_present) {
+   if (vs_data_addr_present) {
       pvr_csb_emit (csb, VDMCTRL_VDM_STATE2, state2) {
          state2.vs_pds_data_base_addr =
             PVR_DEV_ADDR(state->pds_vertex_attrib_offset);
       }
+
+      state->vdm_state.vs_pds_data_offset = state->pds_vertex_attrib_offset;
    }
 
-   if (header.vs_other_present) {
+   if (vs_other_present) {
       const uint32_t usc_unified_store_size_in_bytes = vs_data->common.vtxins
                                                        << 2;
 
@@ -6244,6 +6650,9 @@ static void pvr_emit_dirty_vdm_state(struct pvr_cmd_buffer *const cmd_buffer,
             PVR_DW_TO_BYTES(state->pds_shader.info->data_size_in_dwords),
             ROGUE_VDMCTRL_VDM_STATE5_VS_PDS_DATA_SIZE_UNIT_SIZE);
       }
+
+      state->vdm_state.vs_pds_info = state->pds_shader.info;
+      state->vdm_state.vs_pds_code_offset = state->pds_shader.code_offset;
    }
 
    pvr_csb_clear_relocation_mark(csb);
@@ -6348,7 +6757,9 @@ static VkResult pvr_validate_draw_state(struct pvr_cmd_buffer *cmd_buffer)
       state->max_shared_regs =
          MAX2(state->max_shared_regs, pvr_calc_shared_regs_count(gfx_pipeline));
 
-      pvr_setup_vertex_buffers(cmd_buffer, gfx_pipeline);
+      result = pvr_setup_vertex_buffers(cmd_buffer, gfx_pipeline);
+      if (result != VK_SUCCESS)
+         return result;
    }
 
    if (state->push_constants.dirty_stages & VK_SHADER_STAGE_ALL_GRAPHICS) {
@@ -6717,6 +7128,9 @@ static void pvr_emit_vdm_index_list(struct pvr_cmd_buffer *cmd_buffer,
       return;
    }
 
+   sub_cmd->geometry_vertices +=
+      (uint64_t)index_count * MAX2(instance_count, 1U);
+
    pvr_csb_set_relocation_mark(csb);
 
    pvr_csb_emit (csb, VDMCTRL_INDEX_LIST0, list0) {
@@ -7215,6 +7629,9 @@ pvr_execute_graphics_cmd_buffer(struct pvr_cmd_buffer *cmd_buffer,
       if (!sec_sub_cmd->gfx.empty_cmd)
          primary_sub_cmd->gfx.empty_cmd = false;
 
+      primary_sub_cmd->gfx.geometry_vertices +=
+         sec_sub_cmd->gfx.geometry_vertices;
+
       if (sec_sub_cmd->gfx.query_pool) {
          primary_sub_cmd->gfx.query_pool = sec_sub_cmd->gfx.query_pool;
 
@@ -7222,26 +7639,30 @@ pvr_execute_graphics_cmd_buffer(struct pvr_cmd_buffer *cmd_buffer,
                                        &sec_sub_cmd->gfx.sec_query_indices);
       }
 
-      if (pvr_cmd_uses_deferred_cs_cmds(sec_cmd_buffer)) {
+      result = pvr_execute_deferred_cmd_buffer(cmd_buffer, sec_cmd_buffer);
+      if (result != VK_SUCCESS)
+         return result;
+
+      if (sec_sub_cmd->gfx.deferred_ctrl_stream) {
+         /* The stream needed no patching so it was uploaded when the
+          * secondary was recorded, see
+          * pvr_sub_cmd_gfx_bake_deferred_ctrl_stream().
+          */
+         pvr_csb_emit_link(&primary_sub_cmd->gfx.control_stream,
+                           sec_sub_cmd->gfx.deferred_ctrl_stream->dev_addr,
+                           true);
+      } else if (pvr_cmd_uses_deferred_cs_cmds(sec_cmd_buffer)) {
          /* TODO: In case if secondary buffer is created with
           * VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT, then we patch the
           * stream and copy it to primary stream using pvr_csb_copy below.
           * This will need locking if the same secondary command buffer is
           * executed in multiple primary buffers at the same time.
           */
-         result = pvr_execute_deferred_cmd_buffer(cmd_buffer, sec_cmd_buffer);
-         if (result != VK_SUCCESS)
-            return result;
-
          result = pvr_csb_copy(&primary_sub_cmd->gfx.control_stream,
                                &sec_sub_cmd->gfx.control_stream);
          if (result != VK_SUCCESS)
             return pvr_cmd_buffer_set_error_unwarned(cmd_buffer, result);
       } else {
-         result = pvr_execute_deferred_cmd_buffer(cmd_buffer, sec_cmd_buffer);
-         if (result != VK_SUCCESS)
-            return result;
-
          pvr_csb_emit_link(
             &primary_sub_cmd->gfx.control_stream,
             pvr_csb_get_start_address(&sec_sub_cmd->gfx.control_stream),
@@ -7328,6 +7749,10 @@ void pvr_CmdExecuteCommands(VkCommandBuffer commandBuffer,
 
    assert(cmd_buffer->vk.level == VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
+   result = pvr_cmd_buffer_flush_pending_query(cmd_buffer);
+   if (result != VK_SUCCESS)
+      return;
+
    /* Reset the CPU copy of the most recent PPP state of the primary command
     * buffer.
     *
@@ -7716,6 +8141,12 @@ void pvr_CmdPipelineBarrier2(VkCommandBuffer commandBuffer,
 
    PVR_CHECK_COMMAND_BUFFER_BUILDING_STATE(cmd_buffer);
 
+   /* The barrier needs to see the stages used by any held back query program.
+    */
+   result = pvr_cmd_buffer_flush_pending_query(cmd_buffer);
+   if (result != VK_SUCCESS)
+      return;
+
    for (uint32_t i = 0; i < pDependencyInfo->memoryBarrierCount; i++) {
       vk_src_stage_mask |= pDependencyInfo->pMemoryBarriers[i].srcStageMask;
       vk_dst_stage_mask |= pDependencyInfo->pMemoryBarriers[i].dstStageMask;
@@ -7978,6 +8409,10 @@ VkResult pvr_EndCommandBuffer(VkCommandBuffer commandBuffer)
     */
    util_dynarray_fini(&state->query_indices);
 
+   result = pvr_cmd_buffer_flush_pending_query(cmd_buffer);
+   if (result != VK_SUCCESS)
+      return vk_command_buffer_end(&cmd_buffer->vk);
+
    result = pvr_cmd_buffer_end_sub_cmd(cmd_buffer);
    if (result != VK_SUCCESS)
       pvr_cmd_buffer_set_error_unwarned(cmd_buffer, result);
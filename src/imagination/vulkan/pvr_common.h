@@ -242,6 +242,9 @@ struct pvr_sampler {
    struct vk_sampler vk;
 
    union pvr_sampler_descriptor descriptor;
+
+   /* Entry in the device's border color table, released on destruction. */
+   uint32_t border_color_table_index;
 };
 
 struct pvr_descriptor_size_info {
@@ -342,6 +345,24 @@ struct pvr_descriptor_pool {
    /* Derived and other state. */
    /* List of the descriptor sets created using this pool. */
    struct list_head descriptor_sets;
+
+   /* Pools created without VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+    * never free sets individually, so the set objects and their device memory
+    * are bump allocated from a single host arena and a single buffer object.
+    * Resetting the pool just rewinds the offsets. Sets which don't fit fall
+    * back to individual allocations.
+    */
+   struct {
+      bool enabled;
+
+      void *host_mem;
+      size_t host_size;
+      size_t host_offset;
+
+      struct pvr_bo *bo;
+      uint64_t bo_size;
+      uint64_t bo_offset;
+   } linear;
 };
 
 struct pvr_descriptor {
@@ -379,6 +400,58 @@ struct pvr_descriptor_set {
    struct pvr_descriptor descriptors[0];
 };
 
+/* How the data for a descriptor update template entry is written into the
+ * descriptor set. Resolved from the descriptor type at template creation.
+ */
+enum pvr_descriptor_template_op {
+   PVR_DESCRIPTOR_TEMPLATE_OP_SAMPLER,
+   PVR_DESCRIPTOR_TEMPLATE_OP_IMAGE_SAMPLER,
+   PVR_DESCRIPTOR_TEMPLATE_OP_IMAGE,
+   PVR_DESCRIPTOR_TEMPLATE_OP_BUFFER_VIEW,
+   PVR_DESCRIPTOR_TEMPLATE_OP_INPUT_ATTACHMENT,
+   PVR_DESCRIPTOR_TEMPLATE_OP_BUFFER,
+   PVR_DESCRIPTOR_TEMPLATE_OP_DYNAMIC_BUFFER,
+};
+
+/* A descriptor update template entry with all the descriptor set memory
+ * offsets precomputed from the set layout. Element `i` of the entry is read
+ * from `src_offset + i * src_stride` and written at
+ * `stage_offsets[s] + i * {primary,secondary}_size` for each stage.
+ */
+struct pvr_descriptor_template_entry {
+   enum pvr_descriptor_template_op op;
+   VkDescriptorType type;
+
+   /* Index into the flattened descriptor set of the first element. */
+   uint32_t desc_idx;
+   uint32_t count;
+
+   size_t src_offset;
+   size_t src_stride;
+
+   /* Sizes in dwords. */
+   uint32_t primary_size;
+   uint32_t secondary_size;
+
+   bool has_immutable_samplers;
+
+   /* Offsets in dwords of the first element, for each stage using the
+    * binding.
+    */
+   uint32_t stage_count;
+   struct {
+      uint16_t primary;
+      uint16_t secondary;
+   } stage_offsets[PVR_STAGE_ALLOCATION_COUNT];
+};
+
+struct pvr_descriptor_update_template {
+   struct vk_object_base base;
+
+   uint32_t entry_count;
+   struct pvr_descriptor_template_entry entries[0];
+};
+
 struct pvr_event {
    struct vk_object_base base;
 
@@ -430,6 +503,16 @@ struct pvr_sh_reg_layout {
       bool present;
       uint32_t offset;
    } blend_consts;
+
+   /* If this is present, the shader has a preamble which runs once per draw
+    * as the PDS descriptor program's secondary USC task and writes `count` sh
+    * regs starting at `offset` with values hoisted out of the main program.
+    */
+   struct {
+      bool present;
+      uint32_t offset;
+      uint32_t count;
+   } preamble;
 };
 
 struct pvr_pipeline_layout {
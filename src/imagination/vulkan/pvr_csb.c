@@ -28,6 +28,7 @@
  */
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
@@ -41,6 +42,7 @@
 #include "pvr_private.h"
 #include "pvr_types.h"
 #include "util/list.h"
+#include "util/log.h"
 #include "util/u_dynarray.h"
 #include "vk_log.h"
 
@@ -64,14 +66,145 @@
  */
 
 /**
- * \brief Initializes the csb object.
+ * \brief Initializes a csb buffer object pool.
+ *
+ * \param[in] pool     Pool to initialize.
+ * \param[in] max_free Maximum number of idle buffer objects to keep.
+ *
+ * \sa #pvr_csb_bo_pool_finish()
+ */
+void pvr_csb_bo_pool_init(struct pvr_csb_bo_pool *pool, uint32_t max_free)
+{
+   list_inithead(&pool->free_list);
+   pool->free_count = 0;
+   pool->max_free = max_free;
+   pool->hits = 0;
+   pool->misses = 0;
+}
+
+/**
+ * \brief Frees all idle buffer objects held by a csb buffer object pool.
+ *
+ * \param[in] device Logical device pointer.
+ * \param[in] pool   Pool to trim.
+ */
+void pvr_csb_bo_pool_trim(struct pvr_device *device,
+                          struct pvr_csb_bo_pool *pool)
+{
+   list_for_each_entry_safe (struct pvr_bo, pvr_bo, &pool->free_list, link) {
+      list_del(&pvr_bo->link);
+      pvr_bo_free(device, pvr_bo);
+   }
+
+   pool->free_count = 0;
+}
+
+/**
+ * \brief Frees the resources associated with a csb buffer object pool.
+ *
+ * All buffer objects taken from the pool must have been released back to it
+ * or freed.
  *
  * \param[in] device Logical device pointer.
- * \param[in] csb    Control Stream Builder object to initialize.
+ * \param[in] pool   Pool to free.
+ *
+ * \sa #pvr_csb_bo_pool_init()
+ */
+void pvr_csb_bo_pool_finish(struct pvr_device *device,
+                            struct pvr_csb_bo_pool *pool)
+{
+   if (PVR_IS_DEBUG_SET(INFO) && (pool->hits || pool->misses)) {
+      mesa_logi("csb bo pool: %" PRIu64 " hits, %" PRIu64
+                " allocations, %u idle (max %u)",
+                pool->hits,
+                pool->misses,
+                pool->free_count,
+                pool->max_free);
+   }
+
+   pvr_csb_bo_pool_trim(device, pool);
+}
+
+/**
+ * \brief Takes a csb buffer object from the pool, allocating a new one if the
+ * pool is empty.
+ *
+ * \param[in]  device     Logical device pointer.
+ * \param[in]  pool       Pool to take from, or NULL to always allocate.
+ * \param[out] pvr_bo_out Mapped buffer object of
+ *                        #PVR_CMD_BUFFER_CSB_BO_SIZE bytes.
+ * \return VK_SUCCESS on success, or error code otherwise.
+ */
+static VkResult pvr_csb_bo_pool_acquire(struct pvr_device *device,
+                                        struct pvr_csb_bo_pool *pool,
+                                        struct pvr_bo **const pvr_bo_out)
+{
+   const uint32_t cache_line_size =
+      rogue_get_slc_cache_line_size(&device->pdevice->dev_info);
+
+   if (pool && !list_is_empty(&pool->free_list)) {
+      struct pvr_bo *pvr_bo =
+         list_first_entry(&pool->free_list, struct pvr_bo, link);
+
+      list_del(&pvr_bo->link);
+      pool->free_count--;
+      pool->hits++;
+
+      *pvr_bo_out = pvr_bo;
+
+      return VK_SUCCESS;
+   }
+
+   if (pool)
+      pool->misses++;
+
+   return pvr_bo_alloc(device,
+                       device->heaps.general_heap,
+                       PVR_CMD_BUFFER_CSB_BO_SIZE,
+                       cache_line_size,
+                       PVR_BO_ALLOC_FLAG_CPU_MAPPED,
+                       pvr_bo_out);
+}
+
+/**
+ * \brief Returns a csb buffer object to the pool, or frees it if the pool is
+ * full.
+ *
+ * The buffer object must not be in use by the GPU anymore.
+ *
+ * \param[in] device Logical device pointer.
+ * \param[in] pool   Pool to return the buffer object to, or NULL.
+ * \param[in] pvr_bo Buffer object taken from the pool, or allocated by a csb.
+ */
+void pvr_csb_bo_pool_release(struct pvr_device *device,
+                             struct pvr_csb_bo_pool *pool,
+                             struct pvr_bo *pvr_bo)
+{
+   if (!pvr_bo)
+      return;
+
+   if (!pool || pool->free_count >= pool->max_free) {
+      pvr_bo_free(device, pvr_bo);
+      return;
+   }
+
+   /* Most recently released first, it's the most likely to still be cached. */
+   list_add(&pvr_bo->link, &pool->free_list);
+   pool->free_count++;
+}
+
+/**
+ * \brief Initializes the csb object.
+ *
+ * \param[in] device      Logical device pointer.
+ * \param[in] bo_pool     Pool to take buffer objects from, or NULL.
+ * \param[in] stream_type Type of control stream.
+ * \param[in] csb         Control Stream Builder object to initialize.
  *
  * \sa #pvr_csb_finish()
  */
 void pvr_csb_init(struct pvr_device *device,
+                  struct pvr_csb_bo_pool *bo_pool,
                   enum pvr_cmd_stream_type stream_type,
                   struct pvr_csb *csb)
 {
@@ -86,6 +219,7 @@ void pvr_csb_init(struct pvr_device *device,
 #endif
 
    csb->device = device;
+   csb->bo_pool = bo_pool;
    csb->stream_type = stream_type;
    csb->status = VK_SUCCESS;
 
@@ -115,12 +249,12 @@ void pvr_csb_finish(struct pvr_csb *csb)
    } else {
       list_for_each_entry_safe (struct pvr_bo, pvr_bo, &csb->pvr_bo_list, link) {
          list_del(&pvr_bo->link);
-         pvr_bo_free(csb->device, pvr_bo);
+         pvr_csb_bo_pool_release(csb->device, csb->bo_pool, pvr_bo);
       }
    }
 
    /* Leave the csb in a reset state to catch use after destroy instances */
-   pvr_csb_init(NULL, PVR_CMD_STREAM_TYPE_INVALID, csb);
+   pvr_csb_init(NULL, NULL, PVR_CMD_STREAM_TYPE_INVALID, csb);
 }
 
 /**
@@ -138,7 +272,7 @@ void pvr_csb_finish(struct pvr_csb *csb)
  * The state of \c csb after calling this function (iff it returns
  * \c VK_SUCCESS) is identical to that after calling #pvr_csb_finish().
  * Unlike #pvr_csb_finish(), however, the caller must free every entry in
- * \c bo_list_out itself.
+ * \c bo_list_out itself, or release it with #pvr_csb_bo_pool_release().
  */
 VkResult pvr_csb_bake(struct pvr_csb *const csb,
                       struct list_head *const bo_list_out)
@@ -151,7 +285,7 @@ VkResult pvr_csb_bake(struct pvr_csb *const csb,
    list_replace(&csb->pvr_bo_list, bo_list_out);
 
    /* Same as pvr_csb_finish(). */
-   pvr_csb_init(NULL, PVR_CMD_STREAM_TYPE_INVALID, csb);
+   pvr_csb_init(NULL, NULL, PVR_CMD_STREAM_TYPE_INVALID, csb);
 
    return VK_SUCCESS;
 }
@@ -230,8 +364,6 @@ static bool pvr_csb_buffer_extend(struct pvr_csb *csb)
                       pvr_cmd_length(VDMCTRL_STREAM_LINK1));
    const uint8_t stream_reserved_space =
       stream_link_space + ROGUE_VDMCTRL_GUARD_SIZE_DEFAULT;
-   const uint32_t cache_line_size =
-      rogue_get_slc_cache_line_size(&csb->device->pdevice->dev_info);
    size_t current_state_update_size = 0;
    struct pvr_bo *pvr_bo;
    VkResult result;
@@ -247,12 +379,7 @@ static bool pvr_csb_buffer_extend(struct pvr_csb *csb)
    STATIC_ASSERT(ROGUE_VDMCTRL_GUARD_SIZE_DEFAULT ==
                  ROGUE_CDMCTRL_GUARD_SIZE_DEFAULT);
 
-   result = pvr_bo_alloc(csb->device,
-                         csb->device->heaps.general_heap,
-                         PVR_CMD_BUFFER_CSB_BO_SIZE,
-                         cache_line_size,
-                         PVR_BO_ALLOC_FLAG_CPU_MAPPED,
-                         &pvr_bo);
+   result = pvr_csb_bo_pool_acquire(csb->device, csb->bo_pool, &pvr_bo);
    if (result != VK_SUCCESS) {
       vk_error(csb->device, result);
       csb->status = result;
@@ -55,8 +55,38 @@
  */
 #define PVR_CMD_BUFFER_CSB_BO_SIZE 4096
 
+/**
+ * \brief Default maximum number of idle buffer objects kept by a
+ * #pvr_csb_bo_pool.
+ */
+#define PVR_CSB_BO_POOL_DEFAULT_MAX_FREE 256U
+
 struct pvr_device;
 
+/**
+ * \brief Pool of control stream buffer objects.
+ *
+ * Buffer objects released by a csb are kept mapped and handed back out to
+ * later csbs instead of being freed, so that re-recording command buffers
+ * doesn't allocate device memory in the steady state. The pool isn't thread
+ * safe; it's owned by a command pool, which is externally synchronized.
+ */
+struct pvr_csb_bo_pool {
+   /* List of idle csb buffer objects. */
+   struct list_head free_list;
+   uint32_t free_count;
+
+   /* High-water mark. Buffer objects released while free_count is at this
+    * limit are freed instead.
+    */
+   uint32_t max_free;
+
+   /* Number of buffer objects handed out from free_list. */
+   uint64_t hits;
+   /* Number of buffer objects that had to be freshly allocated. */
+   uint64_t misses;
+};
+
 enum pvr_cmd_stream_type {
    PVR_CMD_STREAM_TYPE_INVALID = 0, /* explicitly treat 0 as invalid */
    PVR_CMD_STREAM_TYPE_GRAPHICS,
@@ -67,6 +97,9 @@ enum pvr_cmd_stream_type {
 struct pvr_csb {
    struct pvr_device *device;
 
+   /* Pool to take buffer objects from and release them to, or NULL. */
+   struct pvr_csb_bo_pool *bo_pool;
+
    /* Pointer to current csb buffer object */
    struct pvr_bo *pvr_bo;
 
@@ -232,7 +265,17 @@ static inline void pvr_csb_clear_relocation_mark(UNUSED struct pvr_csb *csb)
 /** @} */
 /* End of \defgroup CSB relocation marking. */
 
+void pvr_csb_bo_pool_init(struct pvr_csb_bo_pool *pool, uint32_t max_free);
+void pvr_csb_bo_pool_trim(struct pvr_device *device,
+                          struct pvr_csb_bo_pool *pool);
+void pvr_csb_bo_pool_finish(struct pvr_device *device,
+                            struct pvr_csb_bo_pool *pool);
+void pvr_csb_bo_pool_release(struct pvr_device *device,
+                             struct pvr_csb_bo_pool *pool,
+                             struct pvr_bo *pvr_bo);
+
 void pvr_csb_init(struct pvr_device *device,
+                  struct pvr_csb_bo_pool *bo_pool,
                   enum pvr_cmd_stream_type stream_type,
                   struct pvr_csb *csb);
 void pvr_csb_finish(struct pvr_csb *csb);
@@ -251,6 +294,7 @@ void pvr_csb_dump(const struct pvr_csb *csb,
 #define pvr_cmd_header(x) ROGUE_##x##_header
 #define pvr_cmd_pack(x) ROGUE_##x##_pack
 #define pvr_cmd_unpack(x) ROGUE_##x##_unpack
+#define pvr_cmd_repack(x, field) ROGUE_##x##_##field##_repack
 #define pvr_cmd_enum_to_str(x) ROGUE_##x##_to_str
 
 /**
@@ -358,6 +402,24 @@ void pvr_csb_dump(const struct pvr_csb *csb,
       _name;                                                                  \
    })
 
+/**
+ * \brief Updates a single field of an already packed command/state.
+ *
+ * The other fields are left untouched, so state that rarely changes can be
+ * packed once, e.g. at pipeline creation, and only the fields that changed
+ * are repacked before the words are emitted.
+ *
+ * \param[in,out] _dst  Pointer to the packed command/state.
+ * \param[in]     cmd   Command/state type.
+ * \param[in]     field Name of the field to update.
+ * \param[in]     value New value of the field.
+ */
+#define pvr_csb_repack(_dst, cmd, field, value)                               \
+   do {                                                                       \
+      STATIC_ASSERT(sizeof(*(_dst)) == PVR_DW_TO_BYTES(pvr_cmd_length(cmd))); \
+      pvr_cmd_repack(cmd, field)((_dst), (value));                            \
+   } while (0)
+
 /**
  * \brief Writes a command/state word value into a raw buffer and advance.
  *
@@ -160,6 +160,10 @@ void pvr_descriptor_size_info_init(
          PVR_DESC_IMAGE_SECONDARY_TOTAL_SIZE(&device->pdevice->dev_info);
       break;
 
+   /* The buffer range is stored in the secondary. Uniform buffers only need
+    * it for robust buffer access; storage buffers always have it (see the
+    * template) since runtime sized arrays need the range.
+    */
    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
       size_info_out->secondary =
@@ -1017,6 +1021,79 @@ void pvr_DestroyPipelineLayout(VkDevice _device,
    vk_object_free(&device->vk, pAllocator, layout);
 }
 
+static VkResult
+pvr_descriptor_pool_linear_init(struct pvr_device *device,
+                                struct pvr_descriptor_pool *pool,
+                                const VkDescriptorPoolCreateInfo *pCreateInfo)
+{
+   const uint32_t cache_line_size =
+      rogue_get_slc_cache_line_size(&device->pdevice->dev_info);
+   uint64_t descriptor_count = 0;
+   VkResult result;
+
+   for (uint32_t i = 0; i < pCreateInfo->poolSizeCount; i++)
+      descriptor_count += pCreateInfo->pPoolSizes[i].descriptorCount;
+
+   /* Each set takes its object, its descriptors and a sub-allocation
+    * describing its range of the pool's buffer object.
+    */
+   pool->linear.host_size =
+      pool->max_sets * (sizeof(struct pvr_descriptor_set) +
+                        sizeof(struct pvr_suballoc_bo)) +
+      descriptor_count * sizeof(struct pvr_descriptor);
+   pool->linear.host_offset = 0;
+
+   pool->linear.host_mem = vk_alloc(&pool->alloc,
+                                    pool->linear.host_size,
+                                    8,
+                                    VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   if (!pool->linear.host_mem)
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+
+   /* Every set's memory is cache line aligned. */
+   pool->linear.bo_size = PVR_DW_TO_BYTES(pool->total_size_in_dwords) +
+                          (uint64_t)pool->max_sets * cache_line_size;
+   pool->linear.bo_offset = 0;
+   pool->linear.bo = NULL;
+
+   if (pool->total_size_in_dwords > 0) {
+      result = pvr_bo_alloc(device,
+                            device->heaps.general_heap,
+                            pool->linear.bo_size,
+                            cache_line_size,
+                            PVR_BO_ALLOC_FLAG_CPU_MAPPED,
+                            &pool->linear.bo);
+      if (result != VK_SUCCESS) {
+         vk_free(&pool->alloc, pool->linear.host_mem);
+         return result;
+      }
+   }
+
+   pool->linear.enabled = true;
+
+   return VK_SUCCESS;
+}
+
+static void pvr_descriptor_pool_linear_finish(struct pvr_device *device,
+                                              struct pvr_descriptor_pool *pool)
+{
+   if (!pool->linear.enabled)
+      return;
+
+   pvr_bo_free(device, pool->linear.bo);
+   vk_free(&pool->alloc, pool->linear.host_mem);
+}
+
+static inline bool
+pvr_descriptor_pool_linear_owns(const struct pvr_descriptor_pool *pool,
+                                const struct pvr_descriptor_set *set)
+{
+   const uint8_t *const host_mem = pool->linear.host_mem;
+
+   return pool->linear.enabled && (const uint8_t *)set >= host_mem &&
+          (const uint8_t *)set < host_mem + pool->linear.host_size;
+}
+
 VkResult pvr_CreateDescriptorPool(VkDevice _device,
                                   const VkDescriptorPoolCreateInfo *pCreateInfo,
                                   const VkAllocationCallbacks *pAllocator,
@@ -1024,6 +1101,7 @@ VkResult pvr_CreateDescriptorPool(VkDevice _device,
 {
    PVR_FROM_HANDLE(pvr_device, device, _device);
    struct pvr_descriptor_pool *pool;
+   VkResult result;
 
    assert(pCreateInfo->sType == VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO);
 
@@ -1060,7 +1138,15 @@ VkResult pvr_CreateDescriptorPool(VkDevice _device,
    pool->total_size_in_dwords *= PVR_STAGE_ALLOCATION_COUNT;
    pool->current_size_in_dwords = 0;
 
-   pvr_finishme("Entry tracker for allocations?");
+   pool->linear.enabled = false;
+   if (!(pCreateInfo->flags &
+         VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)) {
+      result = pvr_descriptor_pool_linear_init(device, pool, pCreateInfo);
+      if (result != VK_SUCCESS) {
+         vk_object_free(&device->vk, pAllocator, pool);
+         return result;
+      }
+   }
 
    *pDescriptorPool = pvr_descriptor_pool_to_handle(pool);
 
@@ -1072,6 +1158,13 @@ static void pvr_free_descriptor_set(struct pvr_device *device,
                                     struct pvr_descriptor_set *set)
 {
    list_del(&set->link);
+
+   /* Linearly allocated sets are only released when the pool is reset. */
+   if (pvr_descriptor_pool_linear_owns(pool, set)) {
+      vk_object_base_finish(&set->base);
+      return;
+   }
+
    pvr_bo_suballoc_free(set->pvr_bo);
    vk_object_free(&device->vk, &pool->alloc, set);
 }
@@ -1093,6 +1186,8 @@ void pvr_DestroyDescriptorPool(VkDevice _device,
       pvr_free_descriptor_set(device, pool, set);
    }
 
+   pvr_descriptor_pool_linear_finish(device, pool);
+
    vk_object_free(&device->vk, pAllocator, pool);
 }
 
@@ -1112,6 +1207,9 @@ VkResult pvr_ResetDescriptorPool(VkDevice _device,
 
    pool->current_size_in_dwords = 0;
 
+   pool->linear.host_offset = 0;
+   pool->linear.bo_offset = 0;
+
    return VK_SUCCESS;
 }
 
@@ -1167,11 +1265,73 @@ static uint16_t pvr_get_descriptor_secondary_offset(
 
 #define PVR_MAX_DESCRIPTOR_MEM_SIZE_IN_DWORDS (4 * 1024)
 
+/* Bump allocates a set from the pool's linear arena. Returns NULL if the set
+ * doesn't fit, in which case it's allocated individually instead.
+ */
+static struct pvr_descriptor_set *
+pvr_descriptor_pool_linear_alloc(struct pvr_device *device,
+                                 struct pvr_descriptor_pool *pool,
+                                 const struct pvr_descriptor_set_layout *layout)
+{
+   const uint32_t cache_line_size =
+      rogue_get_slc_cache_line_size(&device->pdevice->dev_info);
+   const size_t set_size = sizeof(struct pvr_descriptor_set) +
+                           sizeof(struct pvr_descriptor) *
+                              layout->descriptor_count;
+   const size_t host_size =
+      ALIGN_POT(set_size, 8) + sizeof(struct pvr_suballoc_bo);
+   const size_t host_offset = ALIGN_POT(pool->linear.host_offset, 8);
+   struct pvr_descriptor_set *set;
+   uint64_t bo_offset = 0;
+   uint64_t bo_size = 0;
+
+   if (host_offset + host_size > pool->linear.host_size)
+      return NULL;
+
+   if (layout->binding_count > 0) {
+      if (!pool->linear.bo)
+         return NULL;
+
+      bo_offset = ALIGN_POT(pool->linear.bo_offset, cache_line_size);
+      bo_size = MAX2(PVR_DW_TO_BYTES(layout->total_size_in_dwords),
+                     sizeof(uint32_t));
+
+      if (bo_offset + bo_size > pool->linear.bo_size)
+         return NULL;
+   }
+
+   set = (struct pvr_descriptor_set *)((uint8_t *)pool->linear.host_mem +
+                                       host_offset);
+   memset(set, 0, set_size);
+   vk_object_base_init(&device->vk, &set->base, VK_OBJECT_TYPE_DESCRIPTOR_SET);
+
+   if (layout->binding_count > 0) {
+      struct pvr_suballoc_bo *const suballoc_bo =
+         (struct pvr_suballoc_bo *)((uint8_t *)set + ALIGN_POT(set_size, 8));
+
+      *suballoc_bo = (struct pvr_suballoc_bo){
+         .bo = pool->linear.bo,
+         .dev_addr =
+            PVR_DEV_ADDR_OFFSET(pool->linear.bo->vma->dev_addr, bo_offset),
+         .offset = bo_offset,
+         .size = bo_size,
+      };
+      list_inithead(&suballoc_bo->link);
+
+      set->pvr_bo = suballoc_bo;
+      pool->linear.bo_offset = bo_offset + bo_size;
+   }
+
+   pool->linear.host_offset = host_offset + host_size;
+
+   return set;
+}
+
 static VkResult
-pvr_descriptor_set_create(struct pvr_device *device,
-                          struct pvr_descriptor_pool *pool,
-                          const struct pvr_descriptor_set_layout *layout,
-                          struct pvr_descriptor_set **const descriptor_set_out)
+pvr_descriptor_set_alloc(struct pvr_device *device,
+                         struct pvr_descriptor_pool *pool,
+                         const struct pvr_descriptor_set_layout *layout,
+                         struct pvr_descriptor_set **const descriptor_set_out)
 {
    struct pvr_descriptor_set *set;
    VkResult result;
@@ -1179,8 +1339,8 @@ pvr_descriptor_set_create(struct pvr_device *device,
 
    size = sizeof(*set) + sizeof(set->descriptors[0]) * layout->descriptor_count;
 
-   /* TODO: Add support to allocate descriptors from descriptor pool, also
-    * check the required descriptors must not exceed max allowed descriptors.
+   /* TODO: Check the required descriptors must not exceed max allowed
+    * descriptors.
     */
    set = vk_object_zalloc(&device->vk,
                           &pool->alloc,
@@ -1189,12 +1349,6 @@ pvr_descriptor_set_create(struct pvr_device *device,
    if (!set)
       return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
 
-   /* TODO: Add support to allocate device memory from a common pool. Look at
-    * something like anv. Also we can allocate a whole chunk of device memory
-    * for max descriptors supported by pool as done by v3dv. Also check the
-    * possibility if this can be removed from here and done on need basis.
-    */
-
    if (layout->binding_count > 0) {
       const uint32_t cache_line_size =
          rogue_get_slc_cache_line_size(&device->pdevice->dev_info);
@@ -1207,8 +1361,33 @@ pvr_descriptor_set_create(struct pvr_device *device,
                                cache_line_size,
                                false,
                                &set->pvr_bo);
+      if (result != VK_SUCCESS) {
+         vk_object_free(&device->vk, &pool->alloc, set);
+         return result;
+      }
+   }
+
+   *descriptor_set_out = set;
+
+   return VK_SUCCESS;
+}
+
+static VkResult
+pvr_descriptor_set_create(struct pvr_device *device,
+                          struct pvr_descriptor_pool *pool,
+                          const struct pvr_descriptor_set_layout *layout,
+                          struct pvr_descriptor_set **const descriptor_set_out)
+{
+   struct pvr_descriptor_set *set = NULL;
+   VkResult result;
+
+   if (pool->linear.enabled)
+      set = pvr_descriptor_pool_linear_alloc(device, pool, layout);
+
+   if (!set) {
+      result = pvr_descriptor_set_alloc(device, pool, layout, &set);
       if (result != VK_SUCCESS)
-         goto err_free_descriptor_set;
+         return result;
    }
 
    set->layout = layout;
@@ -1253,11 +1432,6 @@ pvr_descriptor_set_create(struct pvr_device *device,
    *descriptor_set_out = set;
 
    return VK_SUCCESS;
-
-err_free_descriptor_set:
-   vk_object_free(&device->vk, &pool->alloc, set);
-
-   return result;
 }
 
 VkResult
@@ -2022,3 +2196,329 @@ void pvr_UpdateDescriptorSets(VkDevice _device,
    for (uint32_t i = 0; i < descriptorCopyCount; i++)
       pvr_copy_descriptor_set(device, &pDescriptorCopies[i]);
 }
+
+static enum pvr_descriptor_template_op
+pvr_descriptor_template_op_from_type(VkDescriptorType type)
+{
+   switch (type) {
+   case VK_DESCRIPTOR_TYPE_SAMPLER:
+      return PVR_DESCRIPTOR_TEMPLATE_OP_SAMPLER;
+
+   case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      return PVR_DESCRIPTOR_TEMPLATE_OP_IMAGE_SAMPLER;
+
+   case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+   case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      return PVR_DESCRIPTOR_TEMPLATE_OP_IMAGE;
+
+   case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+   case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+      return PVR_DESCRIPTOR_TEMPLATE_OP_BUFFER_VIEW;
+
+   case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+      return PVR_DESCRIPTOR_TEMPLATE_OP_INPUT_ATTACHMENT;
+
+   case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+   case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      return PVR_DESCRIPTOR_TEMPLATE_OP_BUFFER;
+
+   case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+   case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+      return PVR_DESCRIPTOR_TEMPLATE_OP_DYNAMIC_BUFFER;
+
+   default:
+      unreachable("Unknown descriptor type");
+   }
+}
+
+static void pvr_descriptor_template_entry_init(
+   const struct pvr_device *device,
+   const struct pvr_descriptor_set_layout *layout,
+   const VkDescriptorUpdateTemplateEntry *vk_entry,
+   struct pvr_descriptor_template_entry *const entry)
+{
+   const struct pvr_descriptor_set_layout_binding *binding =
+      pvr_get_descriptor_binding(layout, vk_entry->dstBinding);
+   struct pvr_descriptor_size_info size_info;
+
+   assert(binding);
+   assert(binding->type == vk_entry->descriptorType);
+
+   pvr_descriptor_size_info_init(device, binding->type, &size_info);
+
+   *entry = (struct pvr_descriptor_template_entry){
+      .op = pvr_descriptor_template_op_from_type(binding->type),
+      .type = binding->type,
+      .desc_idx = binding->descriptor_index + vk_entry->dstArrayElement,
+      .count = vk_entry->descriptorCount,
+      .src_offset = vk_entry->offset,
+      .src_stride = vk_entry->stride,
+      .primary_size = size_info.primary,
+      .secondary_size = size_info.secondary,
+      .has_immutable_samplers = binding->has_immutable_samplers,
+   };
+
+   for (uint32_t stage = 0; stage < PVR_STAGE_ALLOCATION_COUNT; stage++) {
+      if (!(binding->shader_stage_mask & BITFIELD_BIT(stage)))
+         continue;
+
+      entry->stage_offsets[entry->stage_count].primary =
+         pvr_get_descriptor_primary_offset(device,
+                                           layout,
+                                           binding,
+                                           stage,
+                                           vk_entry->dstArrayElement);
+      entry->stage_offsets[entry->stage_count].secondary =
+         pvr_get_descriptor_secondary_offset(device,
+                                             layout,
+                                             binding,
+                                             stage,
+                                             vk_entry->dstArrayElement);
+      entry->stage_count++;
+   }
+}
+
+VkResult pvr_CreateDescriptorUpdateTemplate(
+   VkDevice _device,
+   const VkDescriptorUpdateTemplateCreateInfo *pCreateInfo,
+   const VkAllocationCallbacks *pAllocator,
+   VkDescriptorUpdateTemplate *pDescriptorUpdateTemplate)
+{
+   PVR_FROM_HANDLE(pvr_descriptor_set_layout,
+                   layout,
+                   pCreateInfo->descriptorSetLayout);
+   PVR_FROM_HANDLE(pvr_device, device, _device);
+   struct pvr_descriptor_update_template *template;
+   uint32_t entry_count = 0;
+   size_t size;
+
+   /* Push descriptors aren't supported. */
+   assert(pCreateInfo->templateType ==
+          VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET);
+
+   for (uint32_t i = 0; i < pCreateInfo->descriptorUpdateEntryCount; i++) {
+      if (pCreateInfo->pDescriptorUpdateEntries[i].descriptorCount > 0)
+         entry_count++;
+   }
+
+   size = sizeof(*template) + sizeof(template->entries[0]) * entry_count;
+
+   template = vk_object_alloc(&device->vk,
+                              pAllocator,
+                              size,
+                              VK_OBJECT_TYPE_DESCRIPTOR_UPDATE_TEMPLATE);
+   if (!template)
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+
+   template->entry_count = 0;
+
+   for (uint32_t i = 0; i < pCreateInfo->descriptorUpdateEntryCount; i++) {
+      const VkDescriptorUpdateTemplateEntry *vk_entry =
+         &pCreateInfo->pDescriptorUpdateEntries[i];
+
+      if (vk_entry->descriptorCount == 0)
+         continue;
+
+      pvr_descriptor_template_entry_init(
+         device,
+         layout,
+         vk_entry,
+         &template->entries[template->entry_count++]);
+   }
+
+   assert(template->entry_count == entry_count);
+
+   *pDescriptorUpdateTemplate =
+      pvr_descriptor_update_template_to_handle(template);
+
+   return VK_SUCCESS;
+}
+
+void pvr_DestroyDescriptorUpdateTemplate(
+   VkDevice _device,
+   VkDescriptorUpdateTemplate descriptorUpdateTemplate,
+   const VkAllocationCallbacks *pAllocator)
+{
+   PVR_FROM_HANDLE(pvr_descriptor_update_template,
+                   template,
+                   descriptorUpdateTemplate);
+   PVR_FROM_HANDLE(pvr_device, device, _device);
+
+   if (!template)
+      return;
+
+   vk_object_free(&device->vk, pAllocator, template);
+}
+
+static void
+pvr_descriptor_template_write(const struct pvr_device *device,
+                              const struct pvr_descriptor_template_entry *entry,
+                              struct pvr_descriptor_set *set,
+                              uint32_t *map,
+                              const void *pData)
+{
+   const struct pvr_device_info *dev_info = &device->pdevice->dev_info;
+
+   for (uint32_t i = 0; i < entry->count; i++) {
+      const void *src =
+         (const uint8_t *)pData + entry->src_offset + entry->src_stride * i;
+      struct pvr_descriptor *desc = &set->descriptors[entry->desc_idx + i];
+      const uint32_t primary_offset = i * entry->primary_size;
+      const uint32_t secondary_offset = i * entry->secondary_size;
+
+      desc->type = entry->type;
+
+      switch (entry->op) {
+      case PVR_DESCRIPTOR_TEMPLATE_OP_SAMPLER: {
+         const VkDescriptorImageInfo *info = src;
+         PVR_FROM_HANDLE(pvr_sampler, sampler, info->sampler);
+
+         desc->sampler = sampler;
+
+         for (uint32_t s = 0; s < entry->stage_count; s++) {
+            memcpy(map + entry->stage_offsets[s].primary + primary_offset,
+                   sampler->descriptor.words,
+                   sizeof(sampler->descriptor.words));
+         }
+
+         break;
+      }
+
+      case PVR_DESCRIPTOR_TEMPLATE_OP_IMAGE_SAMPLER:
+      case PVR_DESCRIPTOR_TEMPLATE_OP_IMAGE:
+      case PVR_DESCRIPTOR_TEMPLATE_OP_INPUT_ATTACHMENT: {
+         const VkDescriptorImageInfo *info = src;
+         PVR_FROM_HANDLE(pvr_image_view, iview, info->imageView);
+         const struct pvr_sampler *sampler = NULL;
+         bool write_secondaries = true;
+
+         desc->iview = iview;
+         desc->layout = info->imageLayout;
+
+         if (entry->op == PVR_DESCRIPTOR_TEMPLATE_OP_IMAGE_SAMPLER &&
+             !entry->has_immutable_samplers) {
+            sampler = pvr_sampler_from_handle(info->sampler);
+            desc->sampler = sampler;
+         }
+
+         if (entry->op == PVR_DESCRIPTOR_TEMPLATE_OP_INPUT_ATTACHMENT)
+            write_secondaries = !PVR_HAS_FEATURE(dev_info, tpu_array_textures);
+
+         for (uint32_t s = 0; s < entry->stage_count; s++) {
+            uint32_t *primary =
+               map + entry->stage_offsets[s].primary + primary_offset;
+
+            pvr_write_image_descriptor_primaries(dev_info,
+                                                 iview,
+                                                 entry->type,
+                                                 primary);
+
+            /* Sampler words are located at the end of the primary image
+             * words.
+             */
+            if (sampler) {
+               memcpy(primary + PVR_IMAGE_DESCRIPTOR_SIZE,
+                      sampler->descriptor.words,
+                      sizeof(sampler->descriptor.words));
+            } else if (entry->op ==
+                       PVR_DESCRIPTOR_TEMPLATE_OP_INPUT_ATTACHMENT) {
+               *(uint64_t *)(primary + PVR_IMAGE_DESCRIPTOR_SIZE) =
+                  device->input_attachment_sampler;
+            }
+
+            if (write_secondaries) {
+               pvr_write_image_descriptor_secondaries(
+                  dev_info,
+                  iview,
+                  entry->type,
+                  map + entry->stage_offsets[s].secondary + secondary_offset);
+            }
+         }
+
+         break;
+      }
+
+      case PVR_DESCRIPTOR_TEMPLATE_OP_BUFFER_VIEW: {
+         const VkBufferView *view = src;
+         PVR_FROM_HANDLE(pvr_buffer_view, bview, *view);
+
+         desc->bview = bview;
+
+         for (uint32_t s = 0; s < entry->stage_count; s++) {
+            pvr_write_buffer_descriptor(
+               dev_info,
+               bview,
+               entry->type,
+               map + entry->stage_offsets[s].primary + primary_offset,
+               entry->secondary_size ? map + entry->stage_offsets[s].secondary +
+                                          secondary_offset
+                                     : NULL);
+         }
+
+         break;
+      }
+
+      case PVR_DESCRIPTOR_TEMPLATE_OP_BUFFER:
+      case PVR_DESCRIPTOR_TEMPLATE_OP_DYNAMIC_BUFFER: {
+         const VkDescriptorBufferInfo *info = src;
+         PVR_FROM_HANDLE(pvr_buffer, buffer, info->buffer);
+         const pvr_dev_addr_t addr =
+            PVR_DEV_ADDR_OFFSET(buffer->dev_addr, info->offset);
+         const uint32_t whole_range = buffer->vk.size - info->offset;
+         const uint32_t range =
+            (info->range == VK_WHOLE_SIZE) ? whole_range : info->range;
+
+         desc->buffer_dev_addr = addr;
+         desc->buffer_whole_range = whole_range;
+         desc->buffer_desc_range = range;
+
+         /* Dynamic buffers are written into the descriptor memory at bind
+          * time, once the dynamic offsets are known.
+          */
+         if (entry->op == PVR_DESCRIPTOR_TEMPLATE_OP_DYNAMIC_BUFFER)
+            break;
+
+         for (uint32_t s = 0; s < entry->stage_count; s++) {
+            memcpy(map + entry->stage_offsets[s].primary + primary_offset,
+                   &addr,
+                   PVR_DW_TO_BYTES(entry->primary_size));
+            memcpy(map + entry->stage_offsets[s].secondary + secondary_offset,
+                   &range,
+                   PVR_DW_TO_BYTES(entry->secondary_size));
+         }
+
+         break;
+      }
+
+      default:
+         unreachable("Unknown descriptor template op");
+      }
+   }
+}
+
+void pvr_UpdateDescriptorSetWithTemplate(
+   VkDevice _device,
+   VkDescriptorSet descriptorSet,
+   VkDescriptorUpdateTemplate descriptorUpdateTemplate,
+   const void *pData)
+{
+   PVR_FROM_HANDLE(pvr_descriptor_update_template,
+                   template,
+                   descriptorUpdateTemplate);
+   PVR_FROM_HANDLE(pvr_descriptor_set, set, descriptorSet);
+   PVR_FROM_HANDLE(pvr_device, device, _device);
+   uint32_t *map;
+
+   if (!set->pvr_bo)
+      return;
+
+   map = pvr_bo_suballoc_get_map_addr(set->pvr_bo);
+
+   for (uint32_t i = 0; i < template->entry_count; i++) {
+      pvr_descriptor_template_write(device,
+                                    &template->entries[i],
+                                    set,
+                                    map,
+                                    pData);
+   }
+}
@@ -63,6 +63,9 @@
 #include "pvr_winsys.h"
 #include "rogue/rogue.h"
 #include "util/build_id.h"
+#include "util/disk_cache.h"
+#include "util/hash_table.h"
+#include "util/hex.h"
 #include "util/log.h"
 #include "util/macros.h"
 #include "util/mesa-sha1.h"
@@ -95,6 +98,20 @@
  */
 #define PVR_GLOBAL_FREE_LIST_GROW_THRESHOLD 13U
 
+/* Rough upper bound on the parameter buffer memory used per vertex (vertex
+ * data, primitive blocks and the share of the tile control streams), used to
+ * estimate how big the global free list needs to be.
+ */
+#define PVR_FREE_LIST_BYTES_PER_VERTEX_ESTIMATE 64U
+
+/* The free list grow size is scaled with the recorded demand so that heavy
+ * apps need fewer grow operations (each of which may stall the geometry
+ * phase) to reach their working set.
+ */
+#define PVR_GLOBAL_FREE_LIST_GROW_SIZE_DIVISOR 4U
+
+#define PVR_FREE_LIST_HISTORY_VERSION 1U
+
 #if defined(VK_USE_PLATFORM_DISPLAY_KHR)
 #   define PVR_USE_WSI_PLATFORM_DISPLAY true
 #else
@@ -165,11 +182,19 @@ static const struct vk_instance_extension_table pvr_instance_extensions = {
 };
 
 static void pvr_physical_device_get_supported_extensions(
+   const struct pvr_device_info *const dev_info,
    struct vk_device_extension_table *extensions)
 {
+   /* Cores without tpu_border_colour_enhanced need pre-compressed border
+    * color table entries for compressed formats, which aren't implemented yet.
+    */
+   const bool has_custom_border_color =
+      PVR_HAS_FEATURE(dev_info, tpu_border_colour_enhanced);
+
    *extensions = (struct vk_device_extension_table){
       .KHR_bind_memory2 = true,
       .KHR_copy_commands2 = true,
+      .KHR_descriptor_update_template = true,
       /* TODO: enable this extension when the conformance tests get
        * updated to version 1.3.6.0, the current version does not
        * include the imagination driver ID, which will make a dEQP
@@ -190,6 +215,7 @@ static void pvr_physical_device_get_supported_extensions(
       .KHR_swapchain = PVR_USE_WSI_PLATFORM,
       .KHR_timeline_semaphore = true,
       .KHR_uniform_buffer_standard_layout = true,
+      .EXT_custom_border_color = has_custom_border_color,
       .EXT_external_memory_dma_buf = true,
       .EXT_host_query_reset = true,
       .EXT_index_type_uint8 = true,
@@ -286,6 +312,12 @@ static void pvr_physical_device_get_supported_features(
 
       /* VK_KHR_shader_expect_assume */
       .shaderExpectAssume = true,
+
+      /* VK_EXT_custom_border_color */
+      .customBorderColors =
+         PVR_HAS_FEATURE(dev_info, tpu_border_colour_enhanced),
+      .customBorderColorWithoutFormat =
+         PVR_HAS_FEATURE(dev_info, tpu_border_colour_enhanced),
    };
 }
 
@@ -613,6 +645,12 @@ static bool pvr_physical_device_get_properties(
       .storageTexelBufferOffsetSingleTexelAlignment = true,
       .uniformTexelBufferOffsetAlignmentBytes = 16,
       .uniformTexelBufferOffsetSingleTexelAlignment = false,
+
+      /* VK_EXT_custom_border_color */
+      .maxCustomBorderColorSamplers =
+         PVR_HAS_FEATURE(dev_info, tpu_border_colour_enhanced)
+            ? PVR_BORDER_COLOR_TABLE_NR_CUSTOM_ENTRIES
+            : 0U,
    };
 
    snprintf(properties->deviceName,
@@ -649,6 +687,22 @@ pvr_EnumerateInstanceExtensionProperties(const char *pLayerName,
                                                      pProperties);
 }
 
+static void
+pvr_physical_device_init_disk_cache(struct pvr_physical_device *pdevice)
+{
+#ifdef ENABLE_SHADER_CACHE
+   char uuid[VK_UUID_SIZE * 2 + 1];
+
+   mesa_bytes_to_hex(uuid,
+                     pdevice->vk.properties.pipelineCacheUUID,
+                     VK_UUID_SIZE);
+
+   pdevice->vk.disk_cache = disk_cache_create("powervr", uuid, 0);
+#else
+   pdevice->vk.disk_cache = NULL;
+#endif
+}
+
 static void pvr_physical_device_destroy(struct vk_physical_device *vk_pdevice)
 {
    struct pvr_physical_device *pdevice =
@@ -666,6 +720,9 @@ static void pvr_physical_device_destroy(struct vk_physical_device *vk_pdevice)
    if (pdevice->compiler)
       ralloc_free(pdevice->compiler);
 
+   if (pdevice->vk.disk_cache)
+      disk_cache_destroy(pdevice->vk.disk_cache);
+
    pvr_wsi_finish(pdevice);
 
    if (pdevice->ws)
@@ -772,7 +829,8 @@ static VkResult pvr_physical_device_init(struct pvr_physical_device *pdevice,
    if (result != VK_SUCCESS)
       goto err_pvr_winsys_destroy;
 
-   pvr_physical_device_get_supported_extensions(&supported_extensions);
+   pvr_physical_device_get_supported_extensions(&pdevice->dev_info,
+                                                &supported_extensions);
    pvr_physical_device_get_supported_features(&pdevice->dev_info,
                                               &supported_features);
    if (!pvr_physical_device_get_properties(pdevice, &supported_properties)) {
@@ -838,6 +896,8 @@ static VkResult pvr_physical_device_init(struct pvr_physical_device *pdevice,
       goto err_wsi_finish;
    }
 
+   pvr_physical_device_init_disk_cache(pdevice);
+
    return VK_SUCCESS;
 
 err_wsi_finish:
@@ -1853,15 +1913,268 @@ static void pvr_device_init_default_sampler_state(struct pvr_device *device)
    }
 }
 
+/* Parameter buffer usage recorded for an application, persisted in the disk
+ * cache so that the global free list can be sized up front on the next run.
+ */
+struct pvr_free_list_history {
+   uint32_t version;
+   uint32_t peak_demand;
+};
+
+static bool pvr_free_list_history_key(const struct pvr_device *device,
+                                      cache_key key_out)
+{
+   const struct vk_app_info *app_info = &device->instance->vk.app_info;
+   struct disk_cache *cache = device->pdevice->vk.disk_cache;
+   struct mesa_sha1 sha1_ctx;
+   const char *const tag = "pvr_free_list_history";
+
+   if (!cache)
+      return false;
+
+   _mesa_sha1_init(&sha1_ctx);
+   _mesa_sha1_update(&sha1_ctx, tag, strlen(tag));
+
+   if (app_info->app_name) {
+      _mesa_sha1_update(&sha1_ctx,
+                        app_info->app_name,
+                        strlen(app_info->app_name));
+   }
+
+   _mesa_sha1_update(&sha1_ctx,
+                     &app_info->app_version,
+                     sizeof(app_info->app_version));
+
+   if (app_info->engine_name) {
+      _mesa_sha1_update(&sha1_ctx,
+                        app_info->engine_name,
+                        strlen(app_info->engine_name));
+   }
+
+   _mesa_sha1_final(&sha1_ctx, key_out);
+
+   return true;
+}
+
+static uint32_t pvr_free_list_history_load(const struct pvr_device *device)
+{
+   struct pvr_free_list_history history;
+   cache_key key;
+   size_t size;
+   void *data;
+
+   if (!pvr_free_list_history_key(device, key))
+      return 0;
+
+   data = disk_cache_get(device->pdevice->vk.disk_cache, key, &size);
+   if (!data)
+      return 0;
+
+   if (size != sizeof(history)) {
+      free(data);
+      return 0;
+   }
+
+   memcpy(&history, data, sizeof(history));
+   free(data);
+
+   if (history.version != PVR_FREE_LIST_HISTORY_VERSION)
+      return 0;
+
+   return history.peak_demand;
+}
+
+static void pvr_free_list_history_store(const struct pvr_device *device)
+{
+   const struct pvr_free_list_stats *stats = &device->free_list_stats;
+   const uint32_t prev_peak_demand = stats->recorded_peak_demand;
+   struct pvr_free_list_history history = {
+      .version = PVR_FREE_LIST_HISTORY_VERSION,
+   };
+   cache_key key;
+
+   /* Nothing was rendered, keep whatever was recorded previously. */
+   if (!stats->render_count)
+      return;
+
+   /* Let the recorded demand decay so that the free list of an app that has
+    * become lighter shrinks back down over a few runs.
+    */
+   history.peak_demand =
+      MAX2(MIN2(stats->peak_demand, stats->max_size),
+           prev_peak_demand - prev_peak_demand / 4U);
+
+   if (history.peak_demand == prev_peak_demand)
+      return;
+
+   if (!pvr_free_list_history_key(device, key))
+      return;
+
+   disk_cache_put(device->pdevice->vk.disk_cache,
+                  key,
+                  &history,
+                  sizeof(history),
+                  NULL);
+}
+
+static void pvr_device_init_free_list_stats(struct pvr_device *device,
+                                            bool secondary_device)
+{
+   struct pvr_free_list_stats *stats = &device->free_list_stats;
+   const uint32_t peak_demand = pvr_free_list_history_load(device);
+   const uint32_t max_size =
+      MIN2(PVR_GLOBAL_FREE_LIST_MAX_SIZE,
+           device->pdevice->dev_runtime_info.max_free_list_size);
+   uint32_t initial_size = secondary_device
+                              ? PVR_SECONDARY_DEVICE_FREE_LIST_INITAL_SIZE
+                              : PVR_GLOBAL_FREE_LIST_INITIAL_SIZE;
+   uint32_t grow_size = PVR_GLOBAL_FREE_LIST_GROW_SIZE;
+
+   /* Start at the recorded demand so that the first frames don't have to wait
+    * on grow operations or partial renders. Secondary devices keep their small
+    * initial size since they're expected to do little work each.
+    */
+   if (peak_demand && !secondary_device) {
+      initial_size = MAX2(initial_size, peak_demand);
+      grow_size = MAX2(grow_size,
+                       peak_demand / PVR_GLOBAL_FREE_LIST_GROW_SIZE_DIVISOR);
+   }
+
+   /* Stay within what the firmware supports, leaving room for at least one
+    * grow so that the free list can still adapt.
+    */
+   grow_size = MIN2(grow_size, max_size);
+   initial_size = MIN2(initial_size, max_size - grow_size);
+
+   *stats = (struct pvr_free_list_stats){
+      .initial_size = initial_size,
+      .grow_size = grow_size,
+      .max_size = max_size,
+      .estimated_size = initial_size,
+      .recorded_peak_demand = peak_demand,
+   };
+
+   simple_mtx_init(&stats->mutex, mtx_plain);
+}
+
+static void pvr_device_finish_free_list_stats(struct pvr_device *device)
+{
+   struct pvr_free_list_stats *stats = &device->free_list_stats;
+
+   if (PVR_IS_DEBUG_SET(INFO)) {
+      mesa_logi("Global free list: initial size %u KiB, grow size %u KiB, "
+                "estimated peak demand %" PRIu64 " KiB over %" PRIu64
+                " renders, %" PRIu64 " grow events, %" PRIu64
+                " partial renders",
+                stats->initial_size / 1024U,
+                stats->grow_size / 1024U,
+                stats->peak_demand / 1024U,
+                stats->render_count,
+                stats->grow_events,
+                stats->partial_renders);
+   }
+
+   pvr_free_list_history_store(device);
+
+   simple_mtx_destroy(&stats->mutex);
+}
+
+/**
+ * \brief Records the estimated parameter buffer usage of a render.
+ *
+ * The firmware grows the global free list on demand and falls back to a
+ * partial render once it can't grow any further, neither of which is
+ * reported back to us. Instead the demand is estimated from the geometry
+ * submitted, which gives us the grow and partial render counters and the
+ * per-app history used to size the free list on the next run.
+ */
+void pvr_device_free_list_note_render(struct pvr_device *device,
+                                      const struct pvr_sub_cmd_gfx *sub_cmd)
+{
+   struct pvr_free_list_stats *stats = &device->free_list_stats;
+   const uint64_t demand =
+      sub_cmd->geometry_vertices * PVR_FREE_LIST_BYTES_PER_VERTEX_ESTIMATE;
+
+   simple_mtx_lock(&stats->mutex);
+
+   stats->render_count++;
+   stats->peak_demand = MAX2(stats->peak_demand, demand);
+
+   if (demand > stats->max_size) {
+      stats->partial_renders++;
+      stats->estimated_size = stats->max_size;
+   } else if (demand > stats->estimated_size) {
+      stats->grow_events++;
+      stats->estimated_size =
+         MIN2(align64(demand, stats->grow_size), stats->max_size);
+   }
+
+   simple_mtx_unlock(&stats->mutex);
+}
+
+struct pvr_pds_upload_cache_entry {
+   unsigned char sha1[SHA1_DIGEST_LENGTH];
+   struct pvr_pds_upload upload;
+   uint32_t ref_count;
+};
+
+static uint32_t pvr_pds_upload_cache_hash(const void *key)
+{
+   return _mesa_hash_data(key, SHA1_DIGEST_LENGTH);
+}
+
+static bool pvr_pds_upload_cache_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, SHA1_DIGEST_LENGTH) == 0;
+}
+
+static VkResult pvr_pds_upload_cache_init(struct pvr_device *device)
+{
+   struct pvr_pds_upload_cache *const cache = &device->pds_upload_cache;
+
+   cache->entries = _mesa_hash_table_create(NULL,
+                                            pvr_pds_upload_cache_hash,
+                                            pvr_pds_upload_cache_equal);
+   if (!cache->entries)
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+
+   cache->bo_entries = _mesa_pointer_hash_table_create(NULL);
+   if (!cache->bo_entries) {
+      _mesa_hash_table_destroy(cache->entries, NULL);
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
+
+   simple_mtx_init(&cache->mutex, mtx_plain);
+
+   return VK_SUCCESS;
+}
+
+static void pvr_pds_upload_cache_finish(struct pvr_device *device)
+{
+   struct pvr_pds_upload_cache *const cache = &device->pds_upload_cache;
+
+   /* Anything still in the cache has been leaked by its owner. */
+   hash_table_foreach (cache->entries, hash_entry) {
+      struct pvr_pds_upload_cache_entry *const entry = hash_entry->data;
+
+      pvr_bo_suballoc_free(entry->upload.pvr_bo);
+      vk_free(&device->vk.alloc, entry);
+   }
+
+   _mesa_hash_table_destroy(cache->bo_entries, NULL);
+   _mesa_hash_table_destroy(cache->entries, NULL);
+   simple_mtx_destroy(&cache->mutex);
+}
+
 VkResult pvr_CreateDevice(VkPhysicalDevice physicalDevice,
                           const VkDeviceCreateInfo *pCreateInfo,
                           const VkAllocationCallbacks *pAllocator,
                           VkDevice *pDevice)
 {
    PVR_FROM_HANDLE(pvr_physical_device, pdevice, physicalDevice);
-   uint32_t initial_free_list_size = PVR_GLOBAL_FREE_LIST_INITIAL_SIZE;
    struct pvr_instance *instance = pdevice->instance;
    struct vk_device_dispatch_table dispatch_table;
+   bool secondary_device = false;
    struct pvr_device *device;
    struct pvr_winsys *ws;
    VkResult result;
@@ -1941,20 +2254,32 @@ VkResult pvr_CreateDevice(VkPhysicalDevice physicalDevice,
                             device,
                             PVR_SUBALLOCATOR_VIS_TEST_SIZE);
 
+   result = pvr_pds_upload_cache_init(device);
+   if (result != VK_SUCCESS)
+      goto err_pvr_bo_suballocators_fini;
+
+   result = pvr_renderpass_hwsetup_cache_init(device);
+   if (result != VK_SUCCESS)
+      goto err_pds_upload_cache_finish;
+
    if (p_atomic_inc_return(&instance->active_device_count) >
        PVR_SECONDARY_DEVICE_THRESHOLD) {
-      initial_free_list_size = PVR_SECONDARY_DEVICE_FREE_LIST_INITAL_SIZE;
+      secondary_device = true;
    }
 
+   pvr_device_init_free_list_stats(device, secondary_device);
+
    result = pvr_free_list_create(device,
-                                 initial_free_list_size,
-                                 PVR_GLOBAL_FREE_LIST_MAX_SIZE,
-                                 PVR_GLOBAL_FREE_LIST_GROW_SIZE,
+                                 device->free_list_stats.initial_size,
+                                 device->free_list_stats.max_size,
+                                 device->free_list_stats.grow_size,
                                  PVR_GLOBAL_FREE_LIST_GROW_THRESHOLD,
                                  NULL /* parent_free_list */,
                                  &device->global_free_list);
    if (result != VK_SUCCESS)
-      goto err_dec_device_count;
+      goto err_finish_free_list_stats;
+
+   pvr_rt_dataset_cache_init(device);
 
    result = pvr_device_init_nop_program(device);
    if (result != VK_SUCCESS)
@@ -1986,10 +2311,14 @@ VkResult pvr_CreateDevice(VkPhysicalDevice physicalDevice,
 
    pvr_device_init_tile_buffer_state(device);
 
-   result = pvr_queues_create(device, pCreateInfo);
+   result = pvr_transfer_frag_store_init(device, &device->transfer_frag_store);
    if (result != VK_SUCCESS)
       goto err_pvr_finish_tile_buffer_state;
 
+   result = pvr_queues_create(device, pCreateInfo);
+   if (result != VK_SUCCESS)
+      goto err_pvr_transfer_frag_store_fini;
+
    pvr_device_init_default_sampler_state(device);
 
    pvr_spm_init_scratch_buffer_store(device);
@@ -2025,6 +2354,9 @@ err_pvr_spm_finish_scratch_buffer_store:
 
    pvr_queues_destroy(device);
 
+err_pvr_transfer_frag_store_fini:
+   pvr_transfer_frag_store_fini(device, &device->transfer_frag_store);
+
 err_pvr_finish_tile_buffer_state:
    pvr_device_finish_tile_buffer_state(device);
    pvr_device_finish_spm_load_state(device);
@@ -2049,11 +2381,20 @@ err_pvr_free_nop_program:
    pvr_bo_suballoc_free(device->nop_program.usc);
 
 err_pvr_free_list_destroy:
+   pvr_rt_dataset_cache_finish(device);
    pvr_free_list_destroy(device->global_free_list);
 
-err_dec_device_count:
+err_finish_free_list_stats:
+   simple_mtx_destroy(&device->free_list_stats.mutex);
+
    p_atomic_dec(&device->instance->active_device_count);
 
+   pvr_renderpass_hwsetup_cache_finish(device);
+
+err_pds_upload_cache_finish:
+   pvr_pds_upload_cache_finish(device);
+
+err_pvr_bo_suballocators_fini:
    pvr_bo_suballocator_fini(&device->suballoc_vis_test);
    pvr_bo_suballocator_fini(&device->suballoc_usc);
    pvr_bo_suballocator_fini(&device->suballoc_transfer);
@@ -2087,6 +2428,7 @@ void pvr_DestroyDevice(VkDevice _device,
    pvr_robustness_buffer_finish(device);
    pvr_spm_finish_scratch_buffer_store(device);
    pvr_queues_destroy(device);
+   pvr_transfer_frag_store_fini(device, &device->transfer_frag_store);
    pvr_device_finish_tile_buffer_state(device);
    pvr_device_finish_spm_load_state(device);
    pvr_device_finish_graphics_static_clear_state(device);
@@ -2096,7 +2438,11 @@ void pvr_DestroyDevice(VkDevice _device,
    pvr_bo_suballoc_free(device->pds_compute_fence_program.pvr_bo);
    pvr_bo_suballoc_free(device->nop_program.pds.pvr_bo);
    pvr_bo_suballoc_free(device->nop_program.usc);
+   pvr_rt_dataset_cache_finish(device);
    pvr_free_list_destroy(device->global_free_list);
+   pvr_device_finish_free_list_stats(device);
+   pvr_renderpass_hwsetup_cache_finish(device);
+   pvr_pds_upload_cache_finish(device);
    pvr_bo_suballocator_fini(&device->suballoc_vis_test);
    pvr_bo_suballocator_fini(&device->suballoc_usc);
    pvr_bo_suballocator_fini(&device->suballoc_transfer);
@@ -2813,6 +3159,159 @@ VkResult pvr_gpu_upload_pds(struct pvr_device *device,
    return VK_SUCCESS;
 }
 
+/**
+ * \brief Upload a PDS program through the device-wide PDS upload cache.
+ *
+ * Behaves like pvr_gpu_upload_pds(), except that if an identical program
+ * (same segments, sizes and alignments) has already been uploaded on this
+ * device the existing upload is returned and its reference count incremented.
+ *
+ * Only programs whose contents don't depend on the object they're uploaded
+ * for may be cached, since the returned upload can be shared. Uploads
+ * returned by this function must be released with
+ * pvr_gpu_upload_pds_cached_release() and must not be written to.
+ *
+ * \sa pvr_gpu_upload_pds()
+ */
+VkResult pvr_gpu_upload_pds_cached(struct pvr_device *device,
+                                   const uint32_t *data,
+                                   uint32_t data_size_dwords,
+                                   uint32_t data_alignment,
+                                   const uint32_t *code,
+                                   uint32_t code_size_dwords,
+                                   uint32_t code_alignment,
+                                   uint64_t min_alignment,
+                                   struct pvr_pds_upload *const pds_upload_out)
+{
+   struct pvr_pds_upload_cache *const cache = &device->pds_upload_cache;
+   const uint64_t layout[] = {
+      data_size_dwords, data_alignment, code_size_dwords,
+      code_alignment,   min_alignment,
+   };
+   struct pvr_pds_upload_cache_entry *entry;
+   struct hash_entry *hash_entry;
+   unsigned char sha1[SHA1_DIGEST_LENGTH];
+   struct mesa_sha1 sha1_ctx;
+   VkResult result;
+
+   _mesa_sha1_init(&sha1_ctx);
+   _mesa_sha1_update(&sha1_ctx, layout, sizeof(layout));
+   if (data)
+      _mesa_sha1_update(&sha1_ctx, data, PVR_DW_TO_BYTES(data_size_dwords));
+   if (code)
+      _mesa_sha1_update(&sha1_ctx, code, PVR_DW_TO_BYTES(code_size_dwords));
+   _mesa_sha1_final(&sha1_ctx, sha1);
+
+   simple_mtx_lock(&cache->mutex);
+
+   hash_entry = _mesa_hash_table_search(cache->entries, sha1);
+   if (hash_entry) {
+      entry = hash_entry->data;
+      entry->ref_count++;
+
+      *pds_upload_out = entry->upload;
+
+      simple_mtx_unlock(&cache->mutex);
+
+      return VK_SUCCESS;
+   }
+
+   entry = vk_alloc(&device->vk.alloc,
+                    sizeof(*entry),
+                    8,
+                    VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+   if (!entry) {
+      result = vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+      goto err_unlock;
+   }
+
+   result = pvr_gpu_upload_pds(device,
+                               data,
+                               data_size_dwords,
+                               data_alignment,
+                               code,
+                               code_size_dwords,
+                               code_alignment,
+                               min_alignment,
+                               &entry->upload);
+   if (result != VK_SUCCESS)
+      goto err_free_entry;
+
+   memcpy(entry->sha1, sha1, sizeof(entry->sha1));
+   entry->ref_count = 1;
+
+   if (!_mesa_hash_table_insert(cache->entries, entry->sha1, entry)) {
+      result = vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+      goto err_free_upload;
+   }
+
+   if (!_mesa_hash_table_insert(cache->bo_entries,
+                                entry->upload.pvr_bo,
+                                entry)) {
+      _mesa_hash_table_remove_key(cache->entries, entry->sha1);
+      result = vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+      goto err_free_upload;
+   }
+
+   *pds_upload_out = entry->upload;
+
+   simple_mtx_unlock(&cache->mutex);
+
+   return VK_SUCCESS;
+
+err_free_upload:
+   pvr_bo_suballoc_free(entry->upload.pvr_bo);
+
+err_free_entry:
+   vk_free(&device->vk.alloc, entry);
+
+err_unlock:
+   simple_mtx_unlock(&cache->mutex);
+
+   return result;
+}
+
+/**
+ * \brief Release a reference to an upload from pvr_gpu_upload_pds_cached().
+ *
+ * The underlying suballocation is freed once the last reference is dropped.
+ * Passing an upload with a NULL pvr_bo is a no-op.
+ *
+ * \param[in] device      Logical device pointer.
+ * \param[in] pds_upload  Upload to release.
+ */
+void pvr_gpu_upload_pds_cached_release(
+   struct pvr_device *device,
+   const struct pvr_pds_upload *const pds_upload)
+{
+   struct pvr_pds_upload_cache *const cache = &device->pds_upload_cache;
+   struct pvr_pds_upload_cache_entry *entry;
+   struct hash_entry *hash_entry;
+
+   if (!pds_upload->pvr_bo)
+      return;
+
+   simple_mtx_lock(&cache->mutex);
+
+   hash_entry = _mesa_hash_table_search(cache->bo_entries, pds_upload->pvr_bo);
+   assert(hash_entry);
+   entry = hash_entry->data;
+
+   assert(entry->ref_count > 0);
+   if (--entry->ref_count > 0) {
+      simple_mtx_unlock(&cache->mutex);
+      return;
+   }
+
+   _mesa_hash_table_remove(cache->bo_entries, hash_entry);
+   _mesa_hash_table_remove_key(cache->entries, entry->sha1);
+
+   simple_mtx_unlock(&cache->mutex);
+
+   pvr_bo_suballoc_free(entry->upload.pvr_bo);
+   vk_free(&device->vk.alloc, entry);
+}
+
 static VkResult
 pvr_framebuffer_create_ppp_state(struct pvr_device *device,
                                  struct pvr_framebuffer *framebuffer)
@@ -2883,7 +3382,7 @@ static void pvr_render_targets_fini(struct pvr_render_target *render_targets,
 {
    for (uint32_t i = 0; i < render_targets_count; i++) {
       if (render_targets[i].valid) {
-         pvr_render_target_dataset_destroy(render_targets[i].rt_dataset);
+         pvr_render_target_dataset_release(render_targets[i].rt_dataset);
          render_targets[i].valid = false;
       }
 
@@ -3119,11 +3618,14 @@ VkResult pvr_CreateSampler(VkDevice _device,
 
    result =
       pvr_border_color_table_get_or_create_entry(&device->border_color_table,
+                                                 device,
                                                  sampler,
                                                  &border_color_table_index);
    if (result != VK_SUCCESS)
       goto err_free_sampler;
 
+   sampler->border_color_table_index = border_color_table_index;
+
    if (PVR_HAS_QUIRK(&device->pdevice->dev_info, 51025)) {
       /* The min/mag filters may need adjustment here, the GPU should decide
        * which of the two filters to use based on the clamped LOD value: LOD
@@ -3252,6 +3754,9 @@ void pvr_DestroySampler(VkDevice _device,
    if (!sampler)
       return;
 
+   pvr_border_color_table_release_entry(&device->border_color_table,
+                                        sampler->border_color_table_index);
+
    vk_sampler_destroy(&device->vk, pAllocator, &sampler->vk);
 }
 
@@ -22,9 +22,12 @@
  */
 
 #include <inttypes.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <vulkan/vulkan.h>
 
 #include "pvr_bo.h"
@@ -33,10 +36,16 @@
 #include "pvr_device_info.h"
 #include "pvr_dump.h"
 #include "pvr_dump_bo.h"
+#include "pvr_dump_csb.h"
 #include "pvr_private.h"
 #include "pvr_util.h"
+#include "util/hash_table.h"
 #include "util/list.h"
+#include "util/log.h"
 #include "util/macros.h"
+#include "util/memstream.h"
+#include "util/set.h"
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "vk_enum_to_str.h"
 
@@ -2371,23 +2380,631 @@ static bool dump_first_buffer(struct pvr_dump_buffer_ctx *const ctx,
    return pvr_dump_buffer_hex(ctx, 0);
 }
 
+/******************************************************************************
+   Capture walking
+ ******************************************************************************/
+
+/* Capturing only needs to know which BOs a control stream references, so
+ * rather than decoding it like the dump does, the stream is walked block by
+ * block, following its links, and only the words holding addresses are
+ * unpacked.
+ */
+struct pvr_csb_capture_walk {
+   const struct pvr_csb *csb;
+
+   /* BOs referenced by the stream. */
+   struct set *bos;
+
+   /* BOs the walk had to map, unmapped once it's done. */
+   struct set *mapped_bos;
+
+   /* Stream addresses already walked, so that looping links terminate and
+    * streams called more than once are only walked once.
+    */
+   struct hash_table_u64 *walked_addrs;
+};
+
+struct pvr_csb_capture_reader {
+   const uint32_t *words;
+   uint32_t nr_words;
+};
+
+static const uint32_t *
+pvr_csb_capture_reader_take(struct pvr_csb_capture_reader *const reader,
+                            const uint32_t nr_words)
+{
+   const uint32_t *const words = reader->words;
+
+   if (reader->nr_words < nr_words)
+      return NULL;
+
+   reader->words += nr_words;
+   reader->nr_words -= nr_words;
+
+   return words;
+}
+
+static struct pvr_bo *
+pvr_csb_capture_walk_find_bo(struct pvr_csb_capture_walk *const walk,
+                             const pvr_dev_addr_t addr)
+{
+   const struct list_head *const stream_bos = &walk->csb->pvr_bo_list;
+   struct pvr_bo *bo;
+
+   /* The stream's own BOs are found without PVR_DEBUG=track_bos. */
+   list_for_each_entry (struct pvr_bo, stream_bo, stream_bos, link) {
+      const uint64_t base = stream_bo->vma->dev_addr.addr;
+
+      if (addr.addr >= base && addr.addr - base < stream_bo->bo->size)
+         return stream_bo;
+   }
+
+   bo = pvr_bo_store_lookup(walk->csb->device, addr);
+   if (bo)
+      _mesa_set_add(walk->bos, bo);
+
+   return bo;
+}
+
+static void pvr_csb_capture_walk_record(struct pvr_csb_capture_walk *const walk,
+                                        const pvr_dev_addr_t addr)
+{
+   pvr_csb_capture_walk_find_bo(walk, addr);
+}
+
+static bool
+pvr_csb_capture_walk_read(struct pvr_csb_capture_walk *const walk,
+                          const pvr_dev_addr_t addr,
+                          struct pvr_csb_capture_reader *const reader)
+{
+   struct pvr_bo *const bo = pvr_csb_capture_walk_find_bo(walk, addr);
+   uint64_t offset;
+
+   if (!bo)
+      return false;
+
+   if (!bo->bo->map) {
+      if (pvr_bo_cpu_map_unchanged(walk->csb->device, bo) != VK_SUCCESS)
+         return false;
+
+      _mesa_set_add(walk->mapped_bos, bo);
+   }
+
+   offset = addr.addr - bo->vma->dev_addr.addr;
+
+   reader->words = (const uint32_t *)((const uint8_t *)bo->bo->map + offset);
+   reader->nr_words =
+      MIN2((bo->bo->size - offset) / PVR_DUMP_CSB_WORD_SIZE, UINT32_MAX);
+
+   return true;
+}
+
+/* Returns false if the stream at addr was already walked. */
+static bool
+pvr_csb_capture_walk_mark_walked(struct pvr_csb_capture_walk *const walk,
+                                 const pvr_dev_addr_t addr)
+{
+   if (_mesa_hash_table_u64_search(walk->walked_addrs, addr.addr))
+      return false;
+
+   _mesa_hash_table_u64_insert(walk->walked_addrs, addr.addr, walk);
+
+   return true;
+}
+
+static bool pvr_csb_capture_walk_ppp(struct pvr_csb_capture_walk *const walk,
+                                     const pvr_dev_addr_t addr,
+                                     const uint32_t word_count)
+{
+   const pvr_dev_addr_t pds_heap_base =
+      walk->csb->device->heaps.pds_heap->base_addr;
+   struct pvr_csb_capture_reader reader;
+   struct ROGUE_TA_STATE_HEADER header;
+   uint32_t skip_words = 0;
+   const uint32_t *words;
+
+   if (!pvr_csb_capture_walk_read(walk, addr, &reader))
+      return false;
+
+   reader.nr_words = MIN2(reader.nr_words, word_count);
+
+   words = pvr_csb_capture_reader_take(&reader, 1);
+   if (!words)
+      return false;
+
+   header = pvr_csb_unpack(words, TA_STATE_HEADER);
+
+   /* Only the stream out program references another buffer, and it comes
+    * after every other block.
+    */
+   if (!header.pres_stream_out_program)
+      return true;
+
+   skip_words += header.pres_ispctl + header.pres_ispctl_fa +
+                 header.pres_ispctl_fb + header.pres_ispctl_ba +
+                 header.pres_ispctl_bb + header.pres_ispctl_dbsc;
+   skip_words += header.pres_pds_state_ptr0 * 4U + header.pres_pds_state_ptr1 +
+                 header.pres_pds_state_ptr2 + header.pres_pds_state_ptr3;
+   skip_words += header.pres_region_clip * 2U;
+   skip_words +=
+      header.pres_viewport ? (header.view_port_count + 1U) * 6U : 0U;
+   skip_words += header.pres_wclamp + header.pres_outselects;
+   skip_words += header.pres_varying_word0 + header.pres_varying_word1 +
+                 header.pres_varying_word2;
+   skip_words += header.pres_ppp_ctrl + header.pres_stream_out_size;
+
+   if (!pvr_csb_capture_reader_take(&reader, skip_words))
+      return false;
+
+   words = pvr_csb_capture_reader_take(&reader, 2);
+   if (!words)
+      return false;
+
+   pvr_csb_capture_walk_record(
+      walk,
+      PVR_DEV_ADDR_OFFSET(
+         pds_heap_base,
+         pvr_csb_unpack(&words[1], TA_STATE_STREAM_OUT2).pds_data_addr.addr));
+
+   return true;
+}
+
+static bool
+pvr_csb_capture_walk_vdmctrl(struct pvr_csb_capture_walk *const walk,
+                             const pvr_dev_addr_t addr)
+{
+   const pvr_dev_addr_t pds_heap_base =
+      walk->csb->device->heaps.pds_heap->base_addr;
+   struct pvr_csb_capture_reader reader;
+
+   if (!pvr_csb_capture_walk_mark_walked(walk, addr))
+      return true;
+
+   if (!pvr_csb_capture_walk_read(walk, addr, &reader))
+      return false;
+
+   while (true) {
+      enum ROGUE_VDMCTRL_BLOCK_TYPE block_type;
+      const uint32_t *words;
+
+      if (!reader.nr_words)
+         return false;
+
+      block_type =
+         pvr_csb_unpack(reader.words, VDMCTRL_STREAM_RETURN).block_type;
+      switch (block_type) {
+      case ROGUE_VDMCTRL_BLOCK_TYPE_PPP_STATE_UPDATE: {
+         struct ROGUE_VDMCTRL_PPP_STATE0 state0;
+         struct ROGUE_VDMCTRL_PPP_STATE1 state1;
+
+         words = pvr_csb_capture_reader_take(&reader, 2);
+         if (!words)
+            return false;
+
+         state0 = pvr_csb_unpack(&words[0], VDMCTRL_PPP_STATE0);
+         state1 = pvr_csb_unpack(&words[1], VDMCTRL_PPP_STATE1);
+
+         /* Carry on walking the stream even if the PPP state can't be. */
+         pvr_csb_capture_walk_ppp(
+            walk,
+            PVR_DEV_ADDR(state0.addrmsb.addr | state1.addrlsb.addr),
+            state0.word_count ? state0.word_count : 256);
+         break;
+      }
+
+      case ROGUE_VDMCTRL_BLOCK_TYPE_PDS_STATE_UPDATE: {
+         struct ROGUE_VDMCTRL_PDS_STATE1 state1;
+         struct ROGUE_VDMCTRL_PDS_STATE2 state2;
+
+         words = pvr_csb_capture_reader_take(&reader, 3);
+         if (!words)
+            return false;
+
+         state1 = pvr_csb_unpack(&words[1], VDMCTRL_PDS_STATE1);
+         state2 = pvr_csb_unpack(&words[2], VDMCTRL_PDS_STATE2);
+
+         pvr_csb_capture_walk_record(
+            walk,
+            PVR_DEV_ADDR_OFFSET(pds_heap_base, state1.pds_data_addr.addr));
+         pvr_csb_capture_walk_record(
+            walk,
+            PVR_DEV_ADDR_OFFSET(pds_heap_base, state2.pds_code_addr.addr));
+         break;
+      }
+
+      case ROGUE_VDMCTRL_BLOCK_TYPE_VDM_STATE_UPDATE: {
+         struct ROGUE_VDMCTRL_VDM_STATE0 state0;
+
+         words = pvr_csb_capture_reader_take(&reader, 1);
+         if (!words)
+            return false;
+
+         state0 = pvr_csb_unpack(words, VDMCTRL_VDM_STATE0);
+
+         if (state0.cut_index_present &&
+             !pvr_csb_capture_reader_take(&reader, 1)) {
+            return false;
+         }
+
+         if (state0.vs_data_addr_present) {
+            struct ROGUE_VDMCTRL_VDM_STATE2 state2;
+
+            words = pvr_csb_capture_reader_take(&reader, 1);
+            if (!words)
+               return false;
+
+            state2 = pvr_csb_unpack(words, VDMCTRL_VDM_STATE2);
+            pvr_csb_capture_walk_record(
+               walk,
+               PVR_DEV_ADDR_OFFSET(pds_heap_base,
+                                   state2.vs_pds_data_base_addr.addr));
+         }
+
+         if (state0.vs_other_present) {
+            struct ROGUE_VDMCTRL_VDM_STATE3 state3;
+
+            words = pvr_csb_capture_reader_take(&reader, 3);
+            if (!words)
+               return false;
+
+            state3 = pvr_csb_unpack(&words[0], VDMCTRL_VDM_STATE3);
+            pvr_csb_capture_walk_record(
+               walk,
+               PVR_DEV_ADDR_OFFSET(pds_heap_base,
+                                   state3.vs_pds_code_base_addr.addr));
+         }
+         break;
+      }
+
+      case ROGUE_VDMCTRL_BLOCK_TYPE_INDEX_LIST: {
+         struct ROGUE_VDMCTRL_INDEX_LIST0 index_list0;
+         uint32_t skip_words;
+
+         words = pvr_csb_capture_reader_take(&reader, 1);
+         if (!words)
+            return false;
+
+         index_list0 = pvr_csb_unpack(words, VDMCTRL_INDEX_LIST0);
+
+         if (index_list0.index_addr_present) {
+            words = pvr_csb_capture_reader_take(&reader, 1);
+            if (!words)
+               return false;
+
+            pvr_csb_capture_walk_record(
+               walk,
+               PVR_DEV_ADDR(
+                  index_list0.index_base_addrmsb.addr |
+                  pvr_csb_unpack(words, VDMCTRL_INDEX_LIST1)
+                     .index_base_addrlsb.addr));
+         }
+
+         skip_words = index_list0.index_count_present +
+                      index_list0.index_instance_count_present +
+                      index_list0.index_offset_present +
+                      index_list0.start_present * 2U;
+         if (!pvr_csb_capture_reader_take(&reader, skip_words))
+            return false;
+
+         if (index_list0.indirect_addr_present) {
+            words = pvr_csb_capture_reader_take(&reader, 2);
+            if (!words)
+               return false;
+
+            pvr_csb_capture_walk_record(
+               walk,
+               PVR_DEV_ADDR(pvr_csb_unpack(&words[0], VDMCTRL_INDEX_LIST7)
+                               .indirect_base_addrmsb.addr |
+                            pvr_csb_unpack(&words[1], VDMCTRL_INDEX_LIST8)
+                               .indirect_base_addrlsb.addr));
+         }
+
+         if (index_list0.split_count_present &&
+             !pvr_csb_capture_reader_take(&reader, 1)) {
+            return false;
+         }
+         break;
+      }
+
+      case ROGUE_VDMCTRL_BLOCK_TYPE_STREAM_LINK: {
+         struct ROGUE_VDMCTRL_STREAM_LINK0 link0;
+         struct ROGUE_VDMCTRL_STREAM_LINK1 link1;
+         pvr_dev_addr_t link_addr;
+
+         words = pvr_csb_capture_reader_take(&reader, 2);
+         if (!words)
+            return false;
+
+         link0 = pvr_csb_unpack(&words[0], VDMCTRL_STREAM_LINK0);
+         link1 = pvr_csb_unpack(&words[1], VDMCTRL_STREAM_LINK1);
+         link_addr =
+            PVR_DEV_ADDR(link0.link_addrmsb.addr | link1.link_addrlsb.addr);
+
+         /* Calls are walked separately, with the walk resuming here once
+          * they return.
+          */
+         if (link0.with_return) {
+            pvr_csb_capture_walk_vdmctrl(walk, link_addr);
+            break;
+         }
+
+         if (!pvr_csb_capture_walk_mark_walked(walk, link_addr) ||
+             !pvr_csb_capture_walk_read(walk, link_addr, &reader)) {
+            return false;
+         }
+         break;
+      }
+
+      case ROGUE_VDMCTRL_BLOCK_TYPE_STREAM_RETURN:
+         /* A called stream returns to its caller's walk. */
+         return true;
+
+      case ROGUE_VDMCTRL_BLOCK_TYPE_STREAM_TERMINATE:
+         return true;
+
+      default:
+         return false;
+      }
+   }
+}
+
+static bool
+pvr_csb_capture_walk_cdmctrl(struct pvr_csb_capture_walk *const walk,
+                             const pvr_dev_addr_t addr)
+{
+   const pvr_dev_addr_t pds_heap_base =
+      walk->csb->device->heaps.pds_heap->base_addr;
+   struct pvr_csb_capture_reader reader;
+
+   if (!pvr_csb_capture_walk_mark_walked(walk, addr) ||
+       !pvr_csb_capture_walk_read(walk, addr, &reader)) {
+      return false;
+   }
+
+   while (true) {
+      enum ROGUE_CDMCTRL_BLOCK_TYPE block_type;
+      const uint32_t *words;
+
+      if (!reader.nr_words)
+         return false;
+
+      block_type =
+         pvr_csb_unpack(reader.words, CDMCTRL_STREAM_TERMINATE).block_type;
+      switch (block_type) {
+      case ROGUE_CDMCTRL_BLOCK_TYPE_COMPUTE_KERNEL: {
+         struct ROGUE_CDMCTRL_KERNEL0 kernel0;
+
+         words = pvr_csb_capture_reader_take(&reader, 3);
+         if (!words)
+            return false;
+
+         kernel0 = pvr_csb_unpack(&words[0], CDMCTRL_KERNEL0);
+         pvr_csb_capture_walk_record(
+            walk,
+            PVR_DEV_ADDR_OFFSET(
+               pds_heap_base,
+               pvr_csb_unpack(&words[1], CDMCTRL_KERNEL1).data_addr.addr));
+         pvr_csb_capture_walk_record(
+            walk,
+            PVR_DEV_ADDR_OFFSET(
+               pds_heap_base,
+               pvr_csb_unpack(&words[2], CDMCTRL_KERNEL2).code_addr.addr));
+
+         if (kernel0.indirect_present) {
+            words = pvr_csb_capture_reader_take(&reader, 2);
+            if (!words)
+               return false;
+
+            pvr_csb_capture_walk_record(
+               walk,
+               PVR_DEV_ADDR(pvr_csb_unpack(&words[0], CDMCTRL_KERNEL6)
+                               .indirect_addrmsb.addr |
+                            pvr_csb_unpack(&words[1], CDMCTRL_KERNEL7)
+                               .indirect_addrlsb.addr));
+         } else if (!pvr_csb_capture_reader_take(&reader, 3)) {
+            return false;
+         }
+
+         /* KERNEL8 to KERNEL11. */
+         if (!pvr_csb_capture_reader_take(&reader, 4))
+            return false;
+         break;
+      }
+
+      case ROGUE_CDMCTRL_BLOCK_TYPE_STREAM_LINK: {
+         struct ROGUE_CDMCTRL_STREAM_LINK0 link0;
+         struct ROGUE_CDMCTRL_STREAM_LINK1 link1;
+         pvr_dev_addr_t link_addr;
+
+         words = pvr_csb_capture_reader_take(&reader, 2);
+         if (!words)
+            return false;
+
+         link0 = pvr_csb_unpack(&words[0], CDMCTRL_STREAM_LINK0);
+         link1 = pvr_csb_unpack(&words[1], CDMCTRL_STREAM_LINK1);
+         link_addr =
+            PVR_DEV_ADDR(link0.link_addrmsb.addr | link1.link_addrlsb.addr);
+
+         if (!pvr_csb_capture_walk_mark_walked(walk, link_addr) ||
+             !pvr_csb_capture_walk_read(walk, link_addr, &reader)) {
+            return false;
+         }
+         break;
+      }
+
+      case ROGUE_CDMCTRL_BLOCK_TYPE_STREAM_TERMINATE:
+         return true;
+
+      default:
+         return false;
+      }
+   }
+}
+
+/* Adds the BOs referenced by the control stream, other than its own, to bos.
+ * BOs which aren't part of the stream are only found with
+ * PVR_DEBUG=track_bos.
+ */
+static void pvr_csb_capture_collect_bos(const struct pvr_csb *const csb,
+                                        struct set *const bos)
+{
+   struct pvr_device *const device = csb->device;
+   struct pvr_csb_capture_walk walk = {
+      .csb = csb,
+      .bos = bos,
+   };
+   pvr_dev_addr_t start_addr;
+   bool ret;
+
+   if (list_is_empty(&csb->pvr_bo_list))
+      return;
+
+   walk.mapped_bos = _mesa_pointer_set_create(NULL);
+   walk.walked_addrs = _mesa_hash_table_u64_create(NULL);
+   if (!walk.mapped_bos || !walk.walked_addrs)
+      goto end_destroy;
+
+   start_addr =
+      list_first_entry(&csb->pvr_bo_list, struct pvr_bo, link)->vma->dev_addr;
+
+   switch (csb->stream_type) {
+   case PVR_CMD_STREAM_TYPE_GRAPHICS:
+      ret = pvr_csb_capture_walk_vdmctrl(&walk, start_addr);
+      break;
+
+   case PVR_CMD_STREAM_TYPE_COMPUTE:
+      ret = pvr_csb_capture_walk_cdmctrl(&walk, start_addr);
+      break;
+
+   default:
+      unreachable("Unknown stream type");
+   }
+
+   /* Whatever was found is still captured; the decoder reports the rest. */
+   if (!ret)
+      mesa_logw("Control stream capture may be missing referenced BOs");
+
+   set_foreach (walk.mapped_bos, entry)
+      pvr_bo_cpu_unmap(device, (struct pvr_bo *)entry->key);
+
+end_destroy:
+   _mesa_hash_table_u64_destroy(walk.walked_addrs);
+   _mesa_set_destroy(walk.mapped_bos, NULL);
+}
+
 /******************************************************************************
    Public functions
  ******************************************************************************/
 
-void pvr_csb_dump(const struct pvr_csb *const csb,
-                  const uint32_t frame_num,
-                  const uint32_t job_num)
+DEBUG_GET_ONCE_OPTION(csb_capture_dir, "PVR_CSB_CAPTURE_DIR", NULL)
+
+static bool pvr_csb_capture_bo(FILE *const file,
+                               struct pvr_device *const device,
+                               struct pvr_bo *const bo)
+{
+   struct pvr_csb_capture_bo header;
+   bool did_map_bo = false;
+   bool ret;
+
+   memset(&header, 0, sizeof(header));
+   header.dev_addr = bo->vma->dev_addr.addr;
+   header.size = bo->bo->size;
+
+   if (!bo->bo->map) {
+      if (pvr_bo_cpu_map_unchanged(device, bo) != VK_SUCCESS)
+         return false;
+
+      did_map_bo = true;
+   }
+
+   ret = fwrite(&header, sizeof(header), 1, file) == 1 &&
+         fwrite(bo->bo->map, header.size, 1, file) == 1;
+
+   if (did_map_bo)
+      pvr_bo_cpu_unmap(device, bo);
+
+   return ret;
+}
+
+/* See pvr_dump_csb.h for the format. bos holds the BOs referenced by the
+ * control stream, excluding those in its BO list.
+ */
+static bool pvr_csb_capture(const struct pvr_csb *const csb,
+                            struct set *const bos,
+                            const char *const dir,
+                            const uint32_t frame_num,
+                            const uint32_t job_num)
+{
+   struct pvr_device *const device = csb->device;
+   const uint32_t nr_stream_bos = list_length(&csb->pvr_bo_list);
+   struct pvr_csb_capture_header header;
+   char path[PATH_MAX];
+   bool ret = true;
+   FILE *file;
+
+   /* The header is written out as is, so make sure any padding is zeroed. */
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, PVR_CSB_CAPTURE_MAGIC, sizeof(header.magic));
+   header.bvnc = pvr_get_packed_bvnc(&device->pdevice->dev_info);
+   header.pds_heap_base = device->heaps.pds_heap->base_addr.addr;
+   header.status = csb->status;
+   header.stream_type = csb->stream_type;
+   header.frame_num = frame_num;
+   header.job_num = job_num;
+   header.nr_bos = nr_stream_bos + bos->entries;
+   header.nr_stream_bos = nr_stream_bos;
+
+   snprintf(path,
+            sizeof(path),
+            "%s/csb_f%" PRIu32 "_j%" PRIu32 ".bin",
+            dir,
+            frame_num,
+            job_num);
+
+   file = fopen(path, "wb");
+   if (!file) {
+      mesa_logw("Failed to open control stream capture file %s", path);
+      return false;
+   }
+
+   if (fwrite(&header, sizeof(header), 1, file) != 1)
+      ret = false;
+
+   list_for_each_entry (struct pvr_bo, bo, &csb->pvr_bo_list, link) {
+      if (!ret)
+         break;
+
+      ret = pvr_csb_capture_bo(file, device, bo);
+   }
+
+   set_foreach (bos, entry) {
+      if (!ret)
+         break;
+
+      ret = pvr_csb_capture_bo(file, device, (struct pvr_bo *)entry->key);
+   }
+
+   if (fclose(file))
+      ret = false;
+
+   if (!ret)
+      mesa_logw("Failed to write control stream capture file %s", path);
+
+   return ret;
+}
+
+static void pvr_csb_dump_to_file(const struct pvr_csb *const csb,
+                                 FILE *const file,
+                                 const uint32_t frame_num,
+                                 const uint32_t job_num)
 {
    const uint32_t nr_bos = list_length(&csb->pvr_bo_list);
    struct pvr_device *const device = csb->device;
 
-   struct pvr_dump_bo_ctx first_bo_ctx;
    struct pvr_dump_ctx root_ctx;
+   struct pvr_dump_bo_ctx first_bo_ctx;
 
-   pvr_bo_store_dump(device);
-
-   pvr_dump_begin(&root_ctx, stderr, "CONTROL STREAM DUMP", 6);
+   pvr_dump_begin(&root_ctx, file, "CONTROL STREAM DUMP", 6);
 
    pvr_dump_field_u32(&root_ctx, "Frame num", frame_num);
    pvr_dump_field_u32(&root_ctx, "Job num", job_num);
@@ -2431,3 +3048,48 @@ void pvr_csb_dump(const struct pvr_csb *const csb,
 end_dump:
    pvr_dump_end(&root_ctx);
 }
+
+void pvr_csb_dump(const struct pvr_csb *const csb,
+                  const uint32_t frame_num,
+                  const uint32_t job_num)
+{
+   const char *const capture_dir = debug_get_option_csb_capture_dir();
+   struct pvr_device *const device = csb->device;
+   struct u_memstream mem;
+   size_t dump_size = 0;
+   char *dump = NULL;
+   FILE *file;
+
+   /* Fall back to dumping the stream if it can't be captured. */
+   if (capture_dir) {
+      struct set *const bos = _mesa_pointer_set_create(NULL);
+      bool captured = false;
+
+      if (bos) {
+         pvr_csb_capture_collect_bos(csb, bos);
+         captured = pvr_csb_capture(csb, bos, capture_dir, frame_num, job_num);
+      }
+
+      _mesa_set_destroy(bos, NULL);
+
+      if (captured)
+         return;
+   }
+
+   /* stderr is unbuffered, so build the whole dump in memory and write it out
+    * at once rather than making a syscall for every line.
+    */
+   if (u_memstream_open(&mem, &dump, &dump_size))
+      file = u_memstream_get(&mem);
+   else
+      file = stderr;
+
+   pvr_bo_store_dump(device, file);
+   pvr_csb_dump_to_file(csb, file, frame_num, job_num);
+
+   if (file != stderr) {
+      u_memstream_close(&mem);
+      fwrite(dump, 1, dump_size, stderr);
+      free(dump);
+   }
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2024 Imagination Technologies Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PVR_DUMP_CSB_H
+#define PVR_DUMP_CSB_H
+
+#include <stdint.h>
+
+/* Control streams are written to PVR_CSB_CAPTURE_DIR in binary form instead
+ * of being dumped when it's set. Each stream is written to
+ * "csb_f<frame num>_j<job num>.bin" which contains, in host byte order, a
+ * struct pvr_csb_capture_header followed by nr_bos times a
+ * struct pvr_csb_capture_bo and the BO's contents.
+ *
+ * The first nr_stream_bos BOs are the control stream's BO list, so the stream
+ * starts in the first one. They're followed by every other BO the stream
+ * references, directly or through stream links, e.g. PPP state, PDS programs
+ * and secondary command buffers, which are only found with
+ * PVR_DEBUG=track_bos. Padding in the structs is written as zeroes.
+ *
+ * pvr_csb_decode in tools/ decodes a capture offline.
+ */
+#define PVR_CSB_CAPTURE_MAGIC "PVRCSB01"
+
+struct pvr_csb_capture_header {
+   char magic[8];
+   uint64_t bvnc;
+   uint64_t pds_heap_base;
+   int32_t status;
+   uint32_t stream_type;
+   uint32_t frame_num;
+   uint32_t job_num;
+   uint32_t nr_bos;
+   uint32_t nr_stream_bos;
+};
+
+struct pvr_csb_capture_bo {
+   uint64_t dev_addr;
+   uint64_t size;
+};
+
+#endif /* PVR_DUMP_CSB_H */
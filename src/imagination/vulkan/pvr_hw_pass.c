@@ -31,11 +31,16 @@
 #include "hwdef/rogue_hw_defs.h"
 #include "hwdef/rogue_hw_utils.h"
 #include "pvr_hw_pass.h"
+#include "pvr_debug.h"
 #include "pvr_formats.h"
 #include "pvr_private.h"
 #include "util/bitset.h"
+#include "util/hash_table.h"
 #include "util/list.h"
+#include "util/log.h"
 #include "util/macros.h"
+#include "util/mesa-sha1.h"
+#include "util/simple_mtx.h"
 #include "util/u_math.h"
 #include "vk_alloc.h"
 #include "vk_format.h"
@@ -1865,7 +1870,8 @@ pvr_can_combine_with_render(const struct pvr_device_info *dev_info,
                             struct pvr_render_subpass_depth_params *sp_depth,
                             struct pvr_render_int_attachment *int_ds_attach,
                             struct pvr_renderpass_alloc *new_alloc,
-                            struct pvr_render_int_subpass_dsts *sp_dsts)
+                            struct pvr_render_int_subpass_dsts *sp_dsts,
+                            enum pvr_renderpass_split_reason *reason_out)
 {
    VkResult result;
    bool ret;
@@ -1880,18 +1886,21 @@ pvr_can_combine_with_render(const struct pvr_device_info *dev_info,
     */
    if (sp_depth->existing_ds_is_input &&
        ctx->int_ds_attach->attachment->aspects & VK_IMAGE_ASPECT_STENCIL_BIT) {
+      *reason_out = PVR_RENDERPASS_SPLIT_REASON_STENCIL_INPUT;
       return false;
    }
 
    if (sp_depth->incoming_ds_is_input && int_ds_attach &&
        int_ds_attach->attachment->aspects & VK_IMAGE_ASPECT_STENCIL_BIT &&
        ctx->hw_render) {
+      *reason_out = PVR_RENDERPASS_SPLIT_REASON_STENCIL_INPUT;
       return false;
    }
 
    /* Can't mix multiple sample counts into same render. */
    if (ctx->hw_render &&
        ctx->hw_render->sample_count != subpass->sample_count) {
+      *reason_out = PVR_RENDERPASS_SPLIT_REASON_SAMPLE_COUNT;
       return false;
    }
 
@@ -1902,8 +1911,10 @@ pvr_can_combine_with_render(const struct pvr_device_info *dev_info,
    ret = pvr_depth_zls_conflict(ctx,
                                 int_ds_attach,
                                 sp_depth->existing_ds_is_input);
-   if (ret)
+   if (ret) {
+      *reason_out = PVR_RENDERPASS_SPLIT_REASON_DEPTH_CONFLICT;
       return false;
+   }
 
    /* Check if any of the subpass's dependencies are marked that the two
     * subpasses can't be in the same render.
@@ -1912,6 +1923,7 @@ pvr_can_combine_with_render(const struct pvr_device_info *dev_info,
       const uint32_t dep = subpass->dep_list[i];
       if (subpass->flush_on_dep[i] && ctx->hw_setup->subpass_map[dep].render ==
                                          (ctx->hw_setup->render_count - 1U)) {
+         *reason_out = PVR_RENDERPASS_SPLIT_REASON_DEPENDENCY;
          return false;
       }
    }
@@ -1923,6 +1935,7 @@ pvr_can_combine_with_render(const struct pvr_device_info *dev_info,
       const uint32_t attach_idx = subpass->input_attachments[i];
       if (attach_idx != VK_ATTACHMENT_UNUSED &&
           pvr_is_pending_resolve_dest(ctx, attach_idx)) {
+         *reason_out = PVR_RENDERPASS_SPLIT_REASON_PENDING_RESOLVE;
          return false;
       }
    }
@@ -1931,12 +1944,14 @@ pvr_can_combine_with_render(const struct pvr_device_info *dev_info,
       if (subpass->color_attachments[i] != VK_ATTACHMENT_UNUSED &&
           (pvr_is_pending_resolve_dest(ctx, subpass->color_attachments[i]) ||
            pvr_is_pending_resolve_src(ctx, subpass->color_attachments[i]))) {
+         *reason_out = PVR_RENDERPASS_SPLIT_REASON_PENDING_RESOLVE;
          return false;
       }
 
       if (subpass->resolve_attachments &&
           subpass->resolve_attachments[i] != VK_ATTACHMENT_UNUSED &&
           pvr_is_pending_resolve_dest(ctx, subpass->resolve_attachments[i])) {
+         *reason_out = PVR_RENDERPASS_SPLIT_REASON_PENDING_RESOLVE;
          return false;
       }
    }
@@ -1944,8 +1959,10 @@ pvr_can_combine_with_render(const struct pvr_device_info *dev_info,
    /* No chance of exceeding PBE registers in a single subpass. */
    if (ctx->hw_render) {
       ret = pvr_exceeds_pbe_registers(ctx, subpass);
-      if (ret)
+      if (ret) {
+         *reason_out = PVR_RENDERPASS_SPLIT_REASON_PBE_REGISTERS;
          return false;
+      }
    }
 
    /* Check we can allocate storage for the new subpass's color attachments and
@@ -1957,8 +1974,10 @@ pvr_can_combine_with_render(const struct pvr_device_info *dev_info,
                                            sp_depth,
                                            new_alloc,
                                            sp_dsts);
-   if (result != VK_SUCCESS)
+   if (result != VK_SUCCESS) {
+      *reason_out = PVR_RENDERPASS_SPLIT_REASON_STORAGE;
       return false;
+   }
 
    return true;
 }
@@ -1977,6 +1996,7 @@ pvr_merge_subpass(const struct pvr_device *device,
    struct pvr_renderpass_subpass *new_subpasses;
    struct pvr_render_int_subpass_dsts sp_dsts;
    struct pvr_renderpass_subpass *subpass;
+   enum pvr_renderpass_split_reason split_reason;
    struct pvr_renderpass_alloc alloc;
    VkResult result;
    bool ret;
@@ -2013,7 +2033,8 @@ pvr_merge_subpass(const struct pvr_device *device,
                                      &sp_depth,
                                      int_ds_attach,
                                      &alloc,
-                                     &sp_dsts);
+                                     &sp_dsts,
+                                     &split_reason);
    if (!ret) {
       result = pvr_close_render(device, ctx);
       if (result != VK_SUCCESS)
@@ -2053,6 +2074,17 @@ pvr_merge_subpass(const struct pvr_device *device,
       ctx->hw_render = &hw_setup->renders[hw_setup->render_count];
       memset(ctx->hw_render, 0U, sizeof(*hw_render));
       ctx->hw_render->ds_attach_idx = VK_ATTACHMENT_UNUSED;
+
+      /* Record why the subpass didn't go into the previous render. If it could
+       * have, the previous render was closed because merging is disabled.
+       */
+      if (hw_setup->render_count == 0U)
+         ctx->hw_render->split_reason = PVR_RENDERPASS_SPLIT_REASON_NONE;
+      else if (!ret)
+         ctx->hw_render->split_reason = split_reason;
+      else
+         ctx->hw_render->split_reason = PVR_RENDERPASS_SPLIT_REASON_DISABLED;
+
       hw_setup->render_count++;
       ctx->hw_render->depth_init = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
       ctx->hw_render->stencil_init = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
@@ -2476,7 +2508,7 @@ void pvr_destroy_renderpass_hwsetup(const VkAllocationCallbacks *alloc,
    vk_free(alloc, hw_setup);
 }
 
-VkResult pvr_create_renderpass_hwsetup(
+static VkResult pvr_compute_renderpass_hwsetup(
    struct pvr_device *device,
    const VkAllocationCallbacks *alloc,
    struct pvr_render_pass *pass,
@@ -2714,3 +2746,546 @@ end_create_renderpass_hwsetup:
 
    return result;
 }
+
+/* Upper bound on the number of distinct setups kept around by the device. Once
+ * reached, setups for new render pass layouts are still computed but no longer
+ * cached.
+ */
+#define PVR_RENDERPASS_HWSETUP_CACHE_MAX_ENTRIES 256U
+
+struct pvr_renderpass_hwsetup_cache_entry {
+   unsigned char sha1[SHA1_DIGEST_LENGTH];
+
+   /* Pristine copy of the setup, allocated from the device allocator. The
+    * load ops are always NULL as they are owned by each render pass.
+    */
+   struct pvr_renderpass_hwsetup *hw_setup;
+};
+
+static uint32_t pvr_renderpass_hwsetup_cache_hash(const void *key)
+{
+   return _mesa_hash_data(key, SHA1_DIGEST_LENGTH);
+}
+
+static bool pvr_renderpass_hwsetup_cache_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, SHA1_DIGEST_LENGTH) == 0;
+}
+
+VkResult pvr_renderpass_hwsetup_cache_init(struct pvr_device *device)
+{
+   struct pvr_renderpass_hwsetup_cache *const cache = &device->hwsetup_cache;
+
+   cache->entries = _mesa_hash_table_create(NULL,
+                                            pvr_renderpass_hwsetup_cache_hash,
+                                            pvr_renderpass_hwsetup_cache_equal);
+   if (!cache->entries)
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+
+   simple_mtx_init(&cache->mutex, mtx_plain);
+
+   return VK_SUCCESS;
+}
+
+void pvr_renderpass_hwsetup_cache_finish(struct pvr_device *device)
+{
+   struct pvr_renderpass_hwsetup_cache *const cache = &device->hwsetup_cache;
+
+   hash_table_foreach (cache->entries, hash_entry) {
+      struct pvr_renderpass_hwsetup_cache_entry *const entry =
+         hash_entry->data;
+
+      pvr_destroy_renderpass_hwsetup(&device->vk.alloc, entry->hw_setup);
+      vk_free(&device->vk.alloc, entry);
+   }
+
+   _mesa_hash_table_destroy(cache->entries, NULL);
+   simple_mtx_destroy(&cache->mutex);
+}
+
+#define PVR_SHA1_UPDATE_VALUE(_ctx, _value) \
+   _mesa_sha1_update(_ctx, &(_value), sizeof(_value))
+
+static void pvr_sha1_update_u32_array(struct mesa_sha1 *ctx,
+                                      const uint32_t *array,
+                                      uint32_t count)
+{
+   const bool present = !!array;
+
+   PVR_SHA1_UPDATE_VALUE(ctx, present);
+   if (present)
+      _mesa_sha1_update(ctx, array, sizeof(array[0U]) * count);
+}
+
+/**
+ * \brief Computes the cache key of the hardware setup for a render pass.
+ *
+ * The key covers everything pvr_compute_renderpass_hwsetup() reads from the
+ * render pass: the attachment formats, sample counts and load/store ops, and
+ * the subpass attachment references and dependencies.
+ *
+ * \param[in]  pass          Render pass.
+ * \param[in]  disable_merge Whether subpass merging is disabled.
+ * \param[out] sha1_out      Computed key.
+ */
+static void
+pvr_renderpass_hwsetup_cache_key(const struct pvr_render_pass *pass,
+                                 bool disable_merge,
+                                 unsigned char sha1_out[SHA1_DIGEST_LENGTH])
+{
+   const char *const tag = "pvr_renderpass_hwsetup";
+   struct mesa_sha1 sha1_ctx;
+
+   _mesa_sha1_init(&sha1_ctx);
+   _mesa_sha1_update(&sha1_ctx, tag, strlen(tag));
+
+   PVR_SHA1_UPDATE_VALUE(&sha1_ctx, disable_merge);
+   PVR_SHA1_UPDATE_VALUE(&sha1_ctx, pass->max_tilebuffer_count);
+   PVR_SHA1_UPDATE_VALUE(&sha1_ctx, pass->attachment_count);
+   PVR_SHA1_UPDATE_VALUE(&sha1_ctx, pass->subpass_count);
+
+   for (uint32_t i = 0U; i < pass->attachment_count; i++) {
+      const struct pvr_render_pass_attachment *attachment =
+         &pass->attachments[i];
+
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, attachment->load_op);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, attachment->store_op);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, attachment->stencil_load_op);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, attachment->stencil_store_op);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, attachment->vk_format);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, attachment->sample_count);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, attachment->initial_layout);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, attachment->aspects);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, attachment->is_pbe_downscalable);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, attachment->index);
+   }
+
+   for (uint32_t i = 0U; i < pass->subpass_count; i++) {
+      const struct pvr_render_subpass *subpass = &pass->subpasses[i];
+
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, subpass->sample_count);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, subpass->color_count);
+      pvr_sha1_update_u32_array(&sha1_ctx,
+                                subpass->color_attachments,
+                                subpass->color_count);
+      pvr_sha1_update_u32_array(&sha1_ctx,
+                                subpass->resolve_attachments,
+                                subpass->color_count);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, subpass->input_count);
+      pvr_sha1_update_u32_array(&sha1_ctx,
+                                subpass->input_attachments,
+                                subpass->input_count);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, subpass->depth_stencil_attachment);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, subpass->dep_count);
+      pvr_sha1_update_u32_array(&sha1_ctx,
+                                subpass->dep_list,
+                                subpass->dep_count);
+      if (subpass->dep_count > 0U) {
+         _mesa_sha1_update(&sha1_ctx,
+                           subpass->flush_on_dep,
+                           sizeof(subpass->flush_on_dep[0U]) *
+                              subpass->dep_count);
+      }
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, subpass->index);
+      PVR_SHA1_UPDATE_VALUE(&sha1_ctx, subpass->pipeline_bind_point);
+   }
+
+   _mesa_sha1_final(&sha1_ctx, sha1_out);
+}
+
+#undef PVR_SHA1_UPDATE_VALUE
+
+static bool pvr_clone_array(const VkAllocationCallbacks *alloc,
+                            VkSystemAllocationScope scope,
+                            const void *src,
+                            size_t size,
+                            void **const dst_out)
+{
+   void *dst;
+
+   if (!src || !size) {
+      *dst_out = NULL;
+      return true;
+   }
+
+   dst = vk_alloc(alloc, size, 8U, scope);
+   if (!dst)
+      return false;
+
+   memcpy(dst, src, size);
+   *dst_out = dst;
+
+   return true;
+}
+
+static bool pvr_clone_mrt_setup(const VkAllocationCallbacks *alloc,
+                                VkSystemAllocationScope scope,
+                                const struct usc_mrt_setup *src,
+                                struct usc_mrt_setup *dst)
+{
+   return pvr_clone_array(alloc,
+                          scope,
+                          src->mrt_resources,
+                          sizeof(src->mrt_resources[0U]) *
+                             src->num_render_targets,
+                          (void **)&dst->mrt_resources);
+}
+
+/**
+ * \brief Deep copies a hardware setup.
+ *
+ * Load ops aren't copied, they are created for each render pass from the
+ * setup.
+ *
+ * \param[in]  device       Device.
+ * \param[in]  alloc        Allocator for the copy.
+ * \param[in]  scope        Allocation scope of the copy.
+ * \param[in]  pass         Render pass src was computed for, or one with the
+ *                          same cache key.
+ * \param[in]  src          Setup to copy.
+ * \param[out] hw_setup_out Copy of src.
+ * \return VK_SUCCESS or VK_ERROR_OUT_OF_HOST_MEMORY.
+ */
+static VkResult
+pvr_clone_renderpass_hwsetup(struct pvr_device *device,
+                             const VkAllocationCallbacks *alloc,
+                             VkSystemAllocationScope scope,
+                             const struct pvr_render_pass *pass,
+                             const struct pvr_renderpass_hwsetup *src,
+                             struct pvr_renderpass_hwsetup **const hw_setup_out)
+{
+   struct pvr_renderpass_hw_map *subpass_map;
+   struct pvr_renderpass_hwsetup *hw_setup;
+   bool *surface_allocate;
+
+   VK_MULTIALLOC(ma);
+   vk_multialloc_add(&ma, &hw_setup, __typeof__(*hw_setup), 1);
+   vk_multialloc_add(&ma,
+                     &surface_allocate,
+                     __typeof__(*surface_allocate),
+                     pass->attachment_count);
+   vk_multialloc_add(&ma,
+                     &subpass_map,
+                     __typeof__(*subpass_map),
+                     pass->subpass_count);
+
+   if (!vk_multialloc_zalloc(&ma, alloc, scope))
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+
+   memcpy(surface_allocate,
+          src->surface_allocate,
+          sizeof(surface_allocate[0U]) * pass->attachment_count);
+   memcpy(subpass_map,
+          src->subpass_map,
+          sizeof(subpass_map[0U]) * pass->subpass_count);
+
+   hw_setup->surface_allocate = surface_allocate;
+   hw_setup->subpass_map = subpass_map;
+
+   hw_setup->renders = vk_zalloc(alloc,
+                                 sizeof(hw_setup->renders[0U]) *
+                                    src->render_count,
+                                 8U,
+                                 scope);
+   if (!hw_setup->renders) {
+      vk_free(alloc, hw_setup);
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
+
+   /* From here on pvr_destroy_renderpass_hwsetup() can clean up a partial
+    * copy, since every pointer not yet copied is NULL.
+    */
+   hw_setup->render_count = src->render_count;
+
+   for (uint32_t i = 0U; i < src->render_count; i++) {
+      const struct pvr_renderpass_hwsetup_render *src_render =
+         &src->renders[i];
+      struct pvr_renderpass_hwsetup_render *hw_render = &hw_setup->renders[i];
+      bool ok;
+
+      *hw_render = *src_render;
+      hw_render->subpasses = NULL;
+      hw_render->subpass_count = 0U;
+      hw_render->color_init = NULL;
+      hw_render->init_setup.mrt_resources = NULL;
+      hw_render->eot_setup.mrt_resources = NULL;
+      hw_render->eot_surfaces = NULL;
+      hw_render->load_op = NULL;
+
+      ok = pvr_clone_mrt_setup(alloc,
+                               scope,
+                               &src_render->init_setup,
+                               &hw_render->init_setup);
+      ok = ok && pvr_clone_mrt_setup(alloc,
+                                     scope,
+                                     &src_render->eot_setup,
+                                     &hw_render->eot_setup);
+      ok = ok && pvr_clone_array(alloc,
+                                 scope,
+                                 src_render->color_init,
+                                 sizeof(src_render->color_init[0U]) *
+                                    src_render->color_init_count,
+                                 (void **)&hw_render->color_init);
+      ok = ok && pvr_clone_array(alloc,
+                                 scope,
+                                 src_render->eot_surfaces,
+                                 sizeof(src_render->eot_surfaces[0U]) *
+                                    src_render->eot_surface_count,
+                                 (void **)&hw_render->eot_surfaces);
+      if (!ok)
+         goto err_destroy_hw_setup;
+
+      hw_render->subpasses = vk_zalloc(alloc,
+                                       sizeof(hw_render->subpasses[0U]) *
+                                          src_render->subpass_count,
+                                       8U,
+                                       scope);
+      if (!hw_render->subpasses)
+         goto err_destroy_hw_setup;
+
+      hw_render->subpass_count = src_render->subpass_count;
+
+      for (uint32_t j = 0U; j < src_render->subpass_count; j++) {
+         const struct pvr_renderpass_hwsetup_subpass *src_subpass =
+            &src_render->subpasses[j];
+         struct pvr_renderpass_hwsetup_subpass *hw_subpass =
+            &hw_render->subpasses[j];
+         const struct pvr_render_subpass *input_subpass =
+            &pass->subpasses[src_subpass->index];
+
+         *hw_subpass = *src_subpass;
+         hw_subpass->setup.mrt_resources = NULL;
+         hw_subpass->color_initops = NULL;
+         hw_subpass->input_access = NULL;
+         hw_subpass->load_op = NULL;
+
+         ok = pvr_clone_mrt_setup(alloc,
+                                  scope,
+                                  &src_subpass->setup,
+                                  &hw_subpass->setup);
+         ok = ok && pvr_clone_array(alloc,
+                                    scope,
+                                    src_subpass->color_initops,
+                                    sizeof(src_subpass->color_initops[0U]) *
+                                       input_subpass->color_count,
+                                    (void **)&hw_subpass->color_initops);
+         ok = ok && pvr_clone_array(alloc,
+                                    scope,
+                                    src_subpass->input_access,
+                                    sizeof(src_subpass->input_access[0U]) *
+                                       input_subpass->input_count,
+                                    (void **)&hw_subpass->input_access);
+         if (!ok)
+            goto err_destroy_hw_setup;
+      }
+   }
+
+   *hw_setup_out = hw_setup;
+
+   return VK_SUCCESS;
+
+err_destroy_hw_setup:
+   pvr_destroy_renderpass_hwsetup(alloc, hw_setup);
+
+   return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+}
+
+/* Adds a copy of a freshly computed setup to the device cache. Failing to do
+ * so isn't an error, the setup will just be computed again next time.
+ */
+static void
+pvr_renderpass_hwsetup_cache_add(struct pvr_device *device,
+                                 const struct pvr_render_pass *pass,
+                                 const unsigned char sha1[SHA1_DIGEST_LENGTH],
+                                 const struct pvr_renderpass_hwsetup *hw_setup)
+{
+   struct pvr_renderpass_hwsetup_cache *const cache = &device->hwsetup_cache;
+   struct pvr_renderpass_hwsetup_cache_entry *entry;
+   VkResult result;
+   bool full;
+
+   simple_mtx_lock(&cache->mutex);
+   full = cache->entries->entries >= PVR_RENDERPASS_HWSETUP_CACHE_MAX_ENTRIES;
+   simple_mtx_unlock(&cache->mutex);
+
+   if (full)
+      return;
+
+   entry = vk_alloc(&device->vk.alloc,
+                    sizeof(*entry),
+                    8U,
+                    VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+   if (!entry)
+      return;
+
+   memcpy(entry->sha1, sha1, SHA1_DIGEST_LENGTH);
+
+   result = pvr_clone_renderpass_hwsetup(device,
+                                         &device->vk.alloc,
+                                         VK_SYSTEM_ALLOCATION_SCOPE_DEVICE,
+                                         pass,
+                                         hw_setup,
+                                         &entry->hw_setup);
+   if (result != VK_SUCCESS) {
+      vk_free(&device->vk.alloc, entry);
+      return;
+   }
+
+   simple_mtx_lock(&cache->mutex);
+
+   /* Another thread may have raced us to it. */
+   if (cache->entries->entries < PVR_RENDERPASS_HWSETUP_CACHE_MAX_ENTRIES &&
+       !_mesa_hash_table_search(cache->entries, entry->sha1)) {
+      _mesa_hash_table_insert(cache->entries, entry->sha1, entry);
+      entry = NULL;
+   }
+
+   simple_mtx_unlock(&cache->mutex);
+
+   if (entry) {
+      pvr_destroy_renderpass_hwsetup(&device->vk.alloc, entry->hw_setup);
+      vk_free(&device->vk.alloc, entry);
+   }
+}
+
+VkResult pvr_create_renderpass_hwsetup(
+   struct pvr_device *device,
+   const VkAllocationCallbacks *alloc,
+   struct pvr_render_pass *pass,
+   bool disable_merge,
+   struct pvr_renderpass_hwsetup **const hw_setup_out)
+{
+   struct pvr_renderpass_hwsetup_cache *const cache = &device->hwsetup_cache;
+   unsigned char sha1[SHA1_DIGEST_LENGTH];
+   struct hash_entry *hash_entry;
+   VkResult result;
+
+   /* Render passes with the same attachment and subpass layout always end up
+    * with the same setup, so reuse the one computed for an earlier pass rather
+    * than running the whole storage allocation again.
+    */
+   pvr_renderpass_hwsetup_cache_key(pass, disable_merge, sha1);
+
+   simple_mtx_lock(&cache->mutex);
+
+   hash_entry = _mesa_hash_table_search(cache->entries, sha1);
+   if (hash_entry) {
+      const struct pvr_renderpass_hwsetup_cache_entry *const entry =
+         hash_entry->data;
+
+      result = pvr_clone_renderpass_hwsetup(device,
+                                            alloc,
+                                            VK_SYSTEM_ALLOCATION_SCOPE_OBJECT,
+                                            pass,
+                                            entry->hw_setup,
+                                            hw_setup_out);
+      simple_mtx_unlock(&cache->mutex);
+
+      return result;
+   }
+
+   simple_mtx_unlock(&cache->mutex);
+
+   result = pvr_compute_renderpass_hwsetup(device,
+                                           alloc,
+                                           pass,
+                                           disable_merge,
+                                           hw_setup_out);
+   if (result != VK_SUCCESS)
+      return result;
+
+   pvr_renderpass_hwsetup_cache_add(device, pass, sha1, *hw_setup_out);
+
+   return VK_SUCCESS;
+}
+
+static const char *
+pvr_renderpass_split_reason_str(enum pvr_renderpass_split_reason reason)
+{
+   switch (reason) {
+   case PVR_RENDERPASS_SPLIT_REASON_NONE:
+      return "none";
+   case PVR_RENDERPASS_SPLIT_REASON_DISABLED:
+      return "merging disabled";
+   case PVR_RENDERPASS_SPLIT_REASON_STENCIL_INPUT:
+      return "stencil used as input attachment";
+   case PVR_RENDERPASS_SPLIT_REASON_SAMPLE_COUNT:
+      return "sample count mismatch";
+   case PVR_RENDERPASS_SPLIT_REASON_DEPTH_CONFLICT:
+      return "depth load/store conflict";
+   case PVR_RENDERPASS_SPLIT_REASON_DEPENDENCY:
+      return "non framebuffer-local dependency";
+   case PVR_RENDERPASS_SPLIT_REASON_PENDING_RESOLVE:
+      return "pending MSAA resolve";
+   case PVR_RENDERPASS_SPLIT_REASON_PBE_REGISTERS:
+      return "PBE emits exhausted";
+   case PVR_RENDERPASS_SPLIT_REASON_STORAGE:
+      return "on-chip storage exhausted";
+   default:
+      unreachable("Invalid split reason");
+   }
+}
+
+/* The report always goes to the log with PVR_DEBUG=hw_pass, since vk_logi()
+ * only prints to it in debug builds, and is forwarded to any messengers.
+ */
+#define pvr_hw_pass_log(to_log, has_messengers, pass, format, ...)      \
+   do {                                                                 \
+      if (to_log)                                                       \
+         mesa_logi(format, ##__VA_ARGS__);                              \
+      if (has_messengers)                                               \
+         vk_logi(VK_LOG_OBJS(&(pass)->base), format, ##__VA_ARGS__);    \
+   } while (0)
+
+/**
+ * \brief Reports how the subpasses of a render pass were merged.
+ *
+ * For each hardware render this gives the subpasses it contains, why it
+ * couldn't be merged with the previous render and how much on-chip storage it
+ * uses. The report goes to the log with PVR_DEBUG=hw_pass and to any
+ * VK_EXT_debug_utils messengers.
+ *
+ * \param[in] device Device the render pass was created on.
+ * \param[in] pass   Render pass with its hardware setup.
+ */
+void pvr_renderpass_hwsetup_report(struct pvr_device *device,
+                                   const struct pvr_render_pass *pass)
+{
+   const struct pvr_renderpass_hwsetup *hw_setup = pass->hw_setup;
+   const bool has_messengers =
+      !list_is_empty(&device->instance->vk.debug_utils.callbacks);
+   const bool to_log = PVR_IS_DEBUG_SET(HW_PASS);
+
+   if (!to_log && !has_messengers)
+      return;
+
+   pvr_hw_pass_log(to_log,
+                   has_messengers,
+                   pass,
+                   "Render pass %p: %u subpasses in %u HW renders",
+                   (const void *)pass,
+                   pass->subpass_count,
+                   hw_setup->render_count);
+
+   for (uint32_t i = 0U; i < hw_setup->render_count; i++) {
+      const struct pvr_renderpass_hwsetup_render *hw_render =
+         &hw_setup->renders[i];
+      const uint32_t tile_buffer_bytes =
+         hw_render->tile_buffers_count * hw_render->eot_setup.tile_buffer_size;
+
+      pvr_hw_pass_log(
+         to_log,
+         has_messengers,
+         pass,
+         "  HW render %u: %u subpasses, split reason: %s, "
+         "output registers: %u bytes/pixel, tile buffers: %u (%u bytes)",
+         i,
+         hw_render->subpass_count,
+         pvr_renderpass_split_reason_str(hw_render->split_reason),
+         PVR_DW_TO_BYTES(hw_render->output_regs_count),
+         hw_render->tile_buffers_count,
+         tile_buffer_bytes);
+   }
+}
+
+#undef pvr_hw_pass_log
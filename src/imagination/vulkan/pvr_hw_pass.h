@@ -28,6 +28,9 @@
 #include <stdint.h>
 #include <vulkan/vulkan.h>
 
+#include "util/simple_mtx.h"
+
+struct hash_table;
 struct pvr_device;
 struct pvr_render_pass;
 
@@ -55,6 +58,36 @@ enum pvr_renderpass_hwsetup_input_access {
    PVR_RENDERPASS_HWSETUP_INPUT_ACCESS_ONCHIP_ZREPLICATE,
 };
 
+/* Why a subpass was put in a new hardware render rather than being merged
+ * into the render of the previous subpass.
+ */
+enum pvr_renderpass_split_reason {
+   /* First render of the pass. */
+   PVR_RENDERPASS_SPLIT_REASON_NONE = 0,
+   /* Subpass merging is disabled. */
+   PVR_RENDERPASS_SPLIT_REASON_DISABLED,
+   /* A depth/stencil attachment with stencil is used as an input attachment
+    * and the stencil can't be replicated.
+    */
+   PVR_RENDERPASS_SPLIT_REASON_STENCIL_INPUT,
+   /* The subpass has a different sample count to the render. */
+   PVR_RENDERPASS_SPLIT_REASON_SAMPLE_COUNT,
+   /* The depth would need to be stored or loaded mid-render. */
+   PVR_RENDERPASS_SPLIT_REASON_DEPTH_CONFLICT,
+   /* A dependency on a subpass in the render isn't framebuffer local or
+    * involves multisampled input attachments.
+    */
+   PVR_RENDERPASS_SPLIT_REASON_DEPENDENCY,
+   /* An attachment is the source or destination of an MSAA resolve in the
+    * render.
+    */
+   PVR_RENDERPASS_SPLIT_REASON_PENDING_RESOLVE,
+   /* The render would need more PBE emits than are available. */
+   PVR_RENDERPASS_SPLIT_REASON_PBE_REGISTERS,
+   /* There isn't enough output register or tile buffer space left. */
+   PVR_RENDERPASS_SPLIT_REASON_STORAGE,
+};
+
 #define PVR_USC_RENDER_TARGET_MAXIMUM_SIZE_IN_DWORDS (4)
 
 struct usc_mrt_desc {
@@ -254,6 +287,11 @@ struct pvr_renderpass_hwsetup_render {
    /* true if this HW render has lasting effects on its attachments. */
    bool has_side_effects;
 
+   /* Why this render was started instead of merging its first subpass into
+    * the previous render.
+    */
+   enum pvr_renderpass_split_reason split_reason;
+
    struct pvr_load_op *load_op;
 };
 
@@ -278,6 +316,20 @@ struct pvr_renderpass_hwsetup {
    bool *surface_allocate;
 };
 
+/* Device-wide cache of hardware setups, keyed by a hash of the render pass
+ * attachment and subpass layout. Render passes with the same layout share the
+ * result of the tile buffer/output register allocation.
+ */
+struct pvr_renderpass_hwsetup_cache {
+   simple_mtx_t mutex;
+
+   /* SHA1 of the layout -> struct pvr_renderpass_hwsetup_cache_entry. */
+   struct hash_table *entries;
+};
+
+VkResult pvr_renderpass_hwsetup_cache_init(struct pvr_device *device);
+void pvr_renderpass_hwsetup_cache_finish(struct pvr_device *device);
+
 VkResult pvr_create_renderpass_hwsetup(
    struct pvr_device *device,
    const VkAllocationCallbacks *alloc,
@@ -288,6 +340,9 @@ VkResult pvr_create_renderpass_hwsetup(
 void pvr_destroy_renderpass_hwsetup(const VkAllocationCallbacks *alloc,
                                     struct pvr_renderpass_hwsetup *hw_setup);
 
+void pvr_renderpass_hwsetup_report(struct pvr_device *device,
+                                   const struct pvr_render_pass *pass);
+
 uint32_t pvr_get_tile_buffer_size(const struct pvr_device *device);
 
 #endif /* PVR_HW_PASS_H */
@@ -296,6 +296,35 @@ static void pvr_adjust_non_compressed_view(const struct pvr_image *image,
    info->base_level = 0;
 }
 
+/* Packs the texture state the load op programs use to read back an attachment.
+ * It only depends on the view, so it's done once here rather than on every
+ * render using the view.
+ */
+static VkResult
+pvr_image_view_pack_load_op_state(struct pvr_device *device,
+                                  struct pvr_image_view *iview)
+{
+   const struct pvr_image *image = pvr_image_view_get_image(iview);
+   struct pvr_texture_state_info info = {
+      .format = iview->vk.format,
+      .mem_layout = image->memlayout,
+      .type = iview->vk.view_type,
+      .is_cube = iview->vk.view_type == VK_IMAGE_VIEW_TYPE_CUBE ||
+                 iview->vk.view_type == VK_IMAGE_VIEW_TYPE_CUBE_ARRAY,
+      .tex_state_type = PVR_TEXTURE_STATE_SAMPLE,
+      .extent = iview->vk.extent,
+      .mip_levels = 1,
+      .sample_count = image->vk.samples,
+      .stride = image->physical_extent.width,
+      .addr = image->dev_addr,
+   };
+   const uint8_t *const swizzle = pvr_get_format_swizzle(info.format);
+
+   memcpy(&info.swizzle, swizzle, sizeof(info.swizzle));
+
+   return pvr_pack_tex_state(device, &info, iview->load_op_texture_state);
+}
+
 VkResult pvr_CreateImageView(VkDevice _device,
                              const VkImageViewCreateInfo *pCreateInfo,
                              const VkAllocationCallbacks *pAllocator,
@@ -394,6 +423,13 @@ VkResult pvr_CreateImageView(VkDevice _device,
          goto err_vk_image_view_destroy;
    }
 
+   if (image->vk.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                          VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) {
+      result = pvr_image_view_pack_load_op_state(device, iview);
+      if (result != VK_SUCCESS)
+         goto err_vk_image_view_destroy;
+   }
+
    *pView = pvr_image_view_to_handle(iview);
 
    return VK_SUCCESS;
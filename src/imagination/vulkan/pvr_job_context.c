@@ -36,7 +36,6 @@
 #include "pvr_job_context.h"
 #include "pvr_pds.h"
 #include "pvr_private.h"
-#include "pvr_transfer_frag_store.h"
 #include "pvr_types.h"
 #include "usc/pvr_uscgen.h"
 #include "usc/programs/pvr_vdm_load_sr.h"
@@ -1258,35 +1257,6 @@ static void pvr_transfer_eot_shaders_fini(struct pvr_device *device,
       pvr_bo_suballoc_free(ctx->usc_eot_bos[i]);
 }
 
-static VkResult pvr_transfer_ctx_shaders_init(struct pvr_device *device,
-                                              struct pvr_transfer_ctx *ctx)
-{
-   VkResult result;
-
-   result = pvr_transfer_frag_store_init(device, &ctx->frag_store);
-   if (result != VK_SUCCESS)
-      goto err_out;
-
-   result = pvr_transfer_eot_shaders_init(device, ctx);
-   if (result != VK_SUCCESS)
-      goto err_frag_store_fini;
-
-   return VK_SUCCESS;
-
-err_frag_store_fini:
-   pvr_transfer_frag_store_fini(device, &ctx->frag_store);
-
-err_out:
-   return result;
-}
-
-static void pvr_transfer_ctx_shaders_fini(struct pvr_device *device,
-                                          struct pvr_transfer_ctx *ctx)
-{
-   pvr_transfer_eot_shaders_fini(device, ctx);
-   pvr_transfer_frag_store_fini(device, &ctx->frag_store);
-}
-
 VkResult pvr_transfer_ctx_create(struct pvr_device *const device,
                                  enum pvr_winsys_ctx_priority priority,
                                  struct pvr_transfer_ctx **const ctx_out)
@@ -1316,7 +1286,7 @@ VkResult pvr_transfer_ctx_create(struct pvr_device *const device,
    if (result != VK_SUCCESS)
       goto err_fini_reset_cmd;
 
-   result = pvr_transfer_ctx_shaders_init(device, ctx);
+   result = pvr_transfer_eot_shaders_init(device, ctx);
    if (result != VK_SUCCESS)
       goto err_destroy_transfer_ctx;
 
@@ -1348,11 +1318,12 @@ err_free_pds_unitex_bos:
          if (!ctx->pds_unitex_code[i][j].pvr_bo)
             continue;
 
-         pvr_bo_suballoc_free(ctx->pds_unitex_code[i][j].pvr_bo);
+         pvr_gpu_upload_pds_cached_release(device,
+                                           &ctx->pds_unitex_code[i][j]);
       }
    }
 
-   pvr_transfer_ctx_shaders_fini(device, ctx);
+   pvr_transfer_eot_shaders_fini(device, ctx);
 
 err_destroy_transfer_ctx:
    device->ws->ops->transfer_ctx_destroy(ctx->ws_ctx);
@@ -1375,11 +1346,12 @@ void pvr_transfer_ctx_destroy(struct pvr_transfer_ctx *const ctx)
          if (!ctx->pds_unitex_code[i][j].pvr_bo)
             continue;
 
-         pvr_bo_suballoc_free(ctx->pds_unitex_code[i][j].pvr_bo);
+         pvr_gpu_upload_pds_cached_release(device,
+                                           &ctx->pds_unitex_code[i][j]);
       }
    }
 
-   pvr_transfer_ctx_shaders_fini(device, ctx);
+   pvr_transfer_eot_shaders_fini(device, ctx);
    device->ws->ops->transfer_ctx_destroy(ctx->ws_ctx);
    pvr_ctx_reset_cmd_fini(device, &ctx->reset_cmd);
    vk_free(&device->vk.alloc, ctx);
@@ -26,7 +26,6 @@
 
 #include "pvr_common.h"
 #include "pvr_private.h"
-#include "pvr_transfer_frag_store.h"
 #include "pvr_types.h"
 #include "usc/pvr_uscgen.h"
 #include "pvr_winsys.h"
@@ -146,8 +145,6 @@ struct pvr_transfer_ctx {
 
    struct pvr_winsys_transfer_ctx *ws_ctx;
 
-   struct pvr_transfer_frag_store frag_store;
-
    struct pvr_suballoc_bo *usc_eot_bos[PVR_TRANSFER_MAX_RENDER_TARGETS];
 
    struct pvr_pds_upload pds_unitex_code[PVR_TRANSFER_MAX_TEXSTATE_DMA]
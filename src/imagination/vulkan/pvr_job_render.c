@@ -43,7 +43,9 @@
 #include "pvr_winsys.h"
 #include "util/compiler.h"
 #include "util/format/format_utils.h"
+#include "util/list.h"
 #include "util/macros.h"
+#include "util/simple_mtx.h"
 #include "util/u_math.h"
 #include "vk_alloc.h"
 #include "vk_log.h"
@@ -65,6 +67,11 @@
 
 #define ROGUE_NUM_PT_ENTRIES_PER_PAGE 0x200U
 
+/* Max number of idle RT datasets kept around for reuse. The least recently
+ * released ones are destroyed first.
+ */
+#define PVR_RT_DATASET_CACHE_MAX_IDLE 8U
+
 struct pvr_free_list {
    struct pvr_device *device;
 
@@ -78,6 +85,9 @@ struct pvr_free_list {
 struct pvr_rt_dataset {
    struct pvr_device *device;
 
+   /* Link in pvr_rt_dataset_cache::idle_list while not in use. */
+   struct list_head link;
+
    /* RT dataset information */
    uint32_t width;
    uint32_t height;
@@ -930,6 +940,105 @@ void pvr_render_target_dataset_destroy(struct pvr_rt_dataset *rt_dataset)
    vk_free(&device->vk.alloc, rt_dataset);
 }
 
+void pvr_rt_dataset_cache_init(struct pvr_device *device)
+{
+   struct pvr_rt_dataset_cache *cache = &device->rt_dataset_cache;
+
+   simple_mtx_init(&cache->mtx, mtx_plain);
+   list_inithead(&cache->idle_list);
+   cache->idle_count = 0;
+}
+
+void pvr_rt_dataset_cache_finish(struct pvr_device *device)
+{
+   struct pvr_rt_dataset_cache *cache = &device->rt_dataset_cache;
+
+   list_for_each_entry_safe (struct pvr_rt_dataset,
+                             rt_dataset,
+                             &cache->idle_list,
+                             link) {
+      list_del(&rt_dataset->link);
+      pvr_render_target_dataset_destroy(rt_dataset);
+   }
+
+   cache->idle_count = 0;
+
+   simple_mtx_destroy(&cache->mtx);
+}
+
+VkResult
+pvr_render_target_dataset_acquire(struct pvr_device *device,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  uint32_t samples,
+                                  uint32_t layers,
+                                  struct pvr_rt_dataset **const rt_dataset_out)
+{
+   struct pvr_rt_dataset_cache *cache = &device->rt_dataset_cache;
+
+   simple_mtx_lock(&cache->mtx);
+
+   list_for_each_entry (struct pvr_rt_dataset,
+                        rt_dataset,
+                        &cache->idle_list,
+                        link) {
+      if (rt_dataset->width != width || rt_dataset->height != height ||
+          rt_dataset->samples != samples || rt_dataset->layers != layers) {
+         continue;
+      }
+
+      list_del(&rt_dataset->link);
+      cache->idle_count--;
+
+      simple_mtx_unlock(&cache->mtx);
+
+      *rt_dataset_out = rt_dataset;
+
+      return VK_SUCCESS;
+   }
+
+   simple_mtx_unlock(&cache->mtx);
+
+   return pvr_render_target_dataset_create(device,
+                                           width,
+                                           height,
+                                           samples,
+                                           layers,
+                                           rt_dataset_out);
+}
+
+void pvr_render_target_dataset_release(struct pvr_rt_dataset *rt_dataset)
+{
+   struct pvr_device *device = rt_dataset->device;
+   struct pvr_rt_dataset_cache *cache = &device->rt_dataset_cache;
+   struct pvr_rt_dataset *evicted = NULL;
+
+   /* A dataset with a pending fragment kick still holds the state of a
+    * partially submitted render, so it can't be handed out again.
+    */
+   if (rt_dataset->need_frag) {
+      pvr_render_target_dataset_destroy(rt_dataset);
+      return;
+   }
+
+   simple_mtx_lock(&cache->mtx);
+
+   list_add(&rt_dataset->link, &cache->idle_list);
+   cache->idle_count++;
+
+   if (cache->idle_count > PVR_RT_DATASET_CACHE_MAX_IDLE) {
+      evicted =
+         list_last_entry(&cache->idle_list, struct pvr_rt_dataset, link);
+      list_del(&evicted->link);
+      cache->idle_count--;
+   }
+
+   simple_mtx_unlock(&cache->mtx);
+
+   if (evicted)
+      pvr_render_target_dataset_destroy(evicted);
+}
+
 static void pvr_geom_state_stream_init(struct pvr_render_ctx *ctx,
                                        struct pvr_render_job *job,
                                        struct pvr_winsys_geometry_state *state)
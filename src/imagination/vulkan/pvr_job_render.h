@@ -32,6 +32,8 @@
 #include "pvr_csb.h"
 #include "pvr_limits.h"
 #include "pvr_types.h"
+#include "util/list.h"
+#include "util/simple_mtx.h"
 
 struct pvr_device;
 struct pvr_device_info;
@@ -188,6 +190,31 @@ pvr_render_target_dataset_create(struct pvr_device *device,
                                  struct pvr_rt_dataset **const rt_dataset_out);
 void pvr_render_target_dataset_destroy(struct pvr_rt_dataset *dataset);
 
+/* Cache of idle RT datasets. Datasets are returned here when their render
+ * target is destroyed so that a later render target of the same dimensions
+ * can reuse them instead of reallocating all the RT data buffers, e.g. on
+ * swapchain recreation.
+ */
+struct pvr_rt_dataset_cache {
+   simple_mtx_t mtx;
+
+   /* Idle datasets, most recently released first. */
+   struct list_head idle_list;
+   uint32_t idle_count;
+};
+
+void pvr_rt_dataset_cache_init(struct pvr_device *device);
+void pvr_rt_dataset_cache_finish(struct pvr_device *device);
+
+VkResult
+pvr_render_target_dataset_acquire(struct pvr_device *device,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  uint32_t samples,
+                                  uint32_t layers,
+                                  struct pvr_rt_dataset **const rt_dataset_out);
+void pvr_render_target_dataset_release(struct pvr_rt_dataset *rt_dataset);
+
 VkResult pvr_render_job_submit(struct pvr_render_ctx *ctx,
                                struct pvr_render_job *job,
                                struct vk_sync *wait_geom,
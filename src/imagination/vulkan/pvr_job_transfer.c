@@ -2787,12 +2787,12 @@ static VkResult pvr_3d_copy_blit_core(struct pvr_transfer_ctx *ctx,
       } else {
          pvr_dev_addr_t kick_usc_pds_dev_addr;
 
-         result =
-            pvr_transfer_frag_store_get_shader_info(device,
-                                                    &ctx->frag_store,
-                                                    &state->shader_props,
-                                                    &kick_usc_pds_dev_addr,
-                                                    &sh_reg_layout);
+         result = pvr_transfer_frag_store_get_shader_info(
+            device,
+            &device->transfer_frag_store,
+            &state->shader_props,
+            &kick_usc_pds_dev_addr,
+            &sh_reg_layout);
          if (result != VK_SUCCESS)
             return result;
 
@@ -4129,7 +4129,7 @@ static VkResult pvr_isp_ctrl_stream(const struct pvr_device_info *dev_info,
 
             result = pvr_transfer_frag_store_get_shader_info(
                transfer_cmd->cmd_buffer->device,
-               &ctx->frag_store,
+               &transfer_cmd->cmd_buffer->device->transfer_frag_store,
                shader_props,
                &dev_offset,
                &sh_reg_layout);
@@ -5789,32 +5789,49 @@ static VkResult pvr_submit_transfer(struct pvr_transfer_ctx *ctx,
                                                 signal_sync);
 }
 
+/* Kick the prepares accumulated so far. The wait sync is only needed by the
+ * first kick since the fw synchronizes kicks on the same context in
+ * submission order, so it's cleared once used.
+ */
+static VkResult pvr_flush_transfer(struct pvr_transfer_ctx *ctx,
+                                   struct pvr_transfer_submit *submit,
+                                   struct vk_sync **const wait,
+                                   struct vk_sync *signal_sync)
+{
+   VkResult result;
+
+   result = pvr_submit_transfer(ctx, submit, *wait, signal_sync);
+   if (result != VK_SUCCESS)
+      return result;
+
+   submit->prep_count = 0U;
+   *wait = NULL;
+
+   return VK_SUCCESS;
+}
+
 static VkResult pvr_queue_transfer(struct pvr_transfer_ctx *ctx,
                                    struct pvr_transfer_cmd *transfer_cmd,
-                                   struct vk_sync *wait,
-                                   struct vk_sync *signal_sync)
+                                   struct pvr_transfer_submit *submit,
+                                   struct vk_sync **const wait)
 {
    struct pvr_transfer_prep_data *prep_data = NULL;
    struct pvr_transfer_prep_data *prev_prep_data;
-   struct pvr_transfer_submit submit = { 0U };
    bool finished = false;
    uint32_t pass = 0U;
    VkResult result;
 
    /* Transfer queue might decide to do a blit in multiple passes. When the
     * prepare doesn't set the finished flag this code will keep calling the
-    * prepare with increasing pass. If queued transfers are submitted from
-    * here we submit them straight away. That's why we only need a single
-    * prepare for the blit rather then one for each pass. Otherwise we insert
-    * each prepare into the prepare array. When the client does blit batching
-    * and we split the blit into multiple passes each pass in each queued
-    * transfer adds one more prepare. Thus the prepare array after 2
-    * pvr_queue_transfer calls might look like:
+    * prepare with increasing pass. Each pass of each queued transfer adds one
+    * more prepare to the shared prepare array, which is only kicked once it's
+    * full or all the transfers of the sub command have been queued. Thus the
+    * prepare array after 2 pvr_queue_transfer calls might look like:
     *
     * +------+------++-------+-------+-------+
     * |B0/P0 |B0/P1 || B1/P0 | B1/P1 | B1/P2 |
     * +------+------++-------+-------+-------+
-    * F           S/U F                    S/U
+    * F                                    S/U
     *
     * Bn/Pm : nth blit (queue transfer call) / mth prepare
     * F     : fence point
@@ -5822,8 +5839,17 @@ static VkResult pvr_queue_transfer(struct pvr_transfer_ctx *ctx,
     */
 
    while (!finished) {
+      /* Kick what we have if we are out of prepares. prev_prep_data remains
+       * valid since the array isn't cleared, only reused from the start.
+       */
+      if (submit->prep_count == ARRAY_SIZE(submit->prep_array)) {
+         result = pvr_flush_transfer(ctx, submit, wait, NULL);
+         if (result != VK_SUCCESS)
+            return result;
+      }
+
       prev_prep_data = prep_data;
-      prep_data = &submit.prep_array[submit.prep_count++];
+      prep_data = &submit->prep_array[submit->prep_count++];
 
       /* Clear down the memory before we write to this prep. */
       memset(prep_data, 0U, sizeof(*prep_data));
@@ -5848,20 +5874,6 @@ static VkResult pvr_queue_transfer(struct pvr_transfer_ctx *ctx,
       if (result != VK_SUCCESS)
          return result;
 
-      /* Submit if we have finished the blit or if we are out of prepares. */
-      if (finished || submit.prep_count == ARRAY_SIZE(submit.prep_array)) {
-         result = pvr_submit_transfer(ctx,
-                                      &submit,
-                                      wait,
-                                      finished ? signal_sync : NULL);
-         if (result != VK_SUCCESS)
-            return result;
-
-         /* Check if we need to reset prep_count. */
-         if (submit.prep_count == ARRAY_SIZE(submit.prep_array))
-            submit.prep_count = 0U;
-      }
-
       pass++;
    }
 
@@ -5873,37 +5885,24 @@ VkResult pvr_transfer_job_submit(struct pvr_transfer_ctx *ctx,
                                  struct vk_sync *wait_sync,
                                  struct vk_sync *signal_sync)
 {
-   list_for_each_entry_safe (struct pvr_transfer_cmd,
-                             transfer_cmd,
-                             sub_cmd->transfer_cmds,
-                             link) {
-      /* The fw guarantees that any kick on the same context will be
-       * synchronized in submission order. This means only the first kick must
-       * wait, and only the last kick need signal.
-       */
-      struct vk_sync *first_cmd_wait_sync = NULL;
-      struct vk_sync *last_cmd_signal_sync = NULL;
-      VkResult result;
-
-      if (list_first_entry(sub_cmd->transfer_cmds,
-                           struct pvr_transfer_cmd,
-                           link) == transfer_cmd) {
-         first_cmd_wait_sync = wait_sync;
-      }
-
-      if (list_last_entry(sub_cmd->transfer_cmds,
-                          struct pvr_transfer_cmd,
-                          link) == transfer_cmd) {
-         last_cmd_signal_sync = signal_sync;
-      }
+   /* Prepares of all the transfer cmds are batched into as few kicks as
+    * possible rather than kicking each transfer cmd on its own, to cut down
+    * on per-kick submission overhead when many small transfers are queued.
+    */
+   struct pvr_transfer_submit submit = { 0U };
+   VkResult result;
 
-      result = pvr_queue_transfer(ctx,
-                                  transfer_cmd,
-                                  first_cmd_wait_sync,
-                                  last_cmd_signal_sync);
+   list_for_each_entry (struct pvr_transfer_cmd,
+                        transfer_cmd,
+                        sub_cmd->transfer_cmds,
+                        link) {
+      result = pvr_queue_transfer(ctx, transfer_cmd, &submit, &wait_sync);
       if (result != VK_SUCCESS)
          return result;
    }
 
-   return VK_SUCCESS;
+   if (submit.prep_count == 0U)
+      return VK_SUCCESS;
+
+   return pvr_flush_transfer(ctx, &submit, &wait_sync, signal_sync);
 }
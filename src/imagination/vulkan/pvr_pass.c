@@ -161,15 +161,15 @@ VkResult pvr_pds_unitex_state_program_create_and_upload(
    pvr_pds_generate_pixel_shader_sa_code_segment(&program, staging_buffer);
 
    /* FIXME: Figure out the define for alignment of 16. */
-   result = pvr_gpu_upload_pds(device,
-                               NULL,
-                               0U,
-                               0U,
-                               staging_buffer,
-                               program.code_size,
-                               16U,
-                               16U,
-                               pds_upload_out);
+   result = pvr_gpu_upload_pds_cached(device,
+                                      NULL,
+                                      0U,
+                                      0U,
+                                      staging_buffer,
+                                      program.code_size,
+                                      16U,
+                                      16U,
+                                      pds_upload_out);
    if (result != VK_SUCCESS) {
       vk_free2(&device->vk.alloc, allocator, staging_buffer);
       return result;
@@ -359,7 +359,7 @@ static void pvr_load_op_destroy(struct pvr_device *device,
                                 const VkAllocationCallbacks *allocator,
                                 struct pvr_load_op *load_op)
 {
-   pvr_bo_suballoc_free(load_op->pds_tex_state_prog.pvr_bo);
+   pvr_gpu_upload_pds_cached_release(device, &load_op->pds_tex_state_prog);
    pvr_bo_suballoc_free(load_op->pds_frag_prog.pvr_bo);
    pvr_bo_suballoc_free(load_op->usc_frag_prog_bo);
    vk_free2(&device->vk.alloc, allocator, load_op);
@@ -716,6 +716,9 @@ VkResult pvr_CreateRenderPass2(VkDevice _device,
 
    *pRenderPass = pvr_render_pass_to_handle(pass);
 
+   /* Only once the handle exists is the pass visible to the messengers. */
+   pvr_renderpass_hwsetup_report(device, pass);
+
    return VK_SUCCESS;
 
 err_load_op_destroy:
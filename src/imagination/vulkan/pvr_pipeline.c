@@ -107,15 +107,15 @@ static VkResult pvr_pds_coeff_program_create_and_upload(
                                PDS_GENERATE_CODEDATA_SEGMENTS);
 
    /* FIXME: Figure out the define for alignment of 16. */
-   result = pvr_gpu_upload_pds(device,
-                               &staging_buffer[0],
-                               program->data_size,
-                               16,
-                               &staging_buffer[program->data_size],
-                               program->code_size,
-                               16,
-                               16,
-                               &fragment_state->pds_coeff_program);
+   result = pvr_gpu_upload_pds_cached(device,
+                                      &staging_buffer[0],
+                                      program->data_size,
+                                      16,
+                                      &staging_buffer[program->data_size],
+                                      program->code_size,
+                                      16,
+                                      16,
+                                      &fragment_state->pds_coeff_program);
    if (result != VK_SUCCESS) {
       vk_free2(&device->vk.alloc, allocator, staging_buffer);
       return result;
@@ -346,15 +346,15 @@ static VkResult pvr_pds_vertex_attrib_program_create_and_upload(
    info->entries_size_in_bytes = info->entries_written_size_in_bytes;
 
    /* FIXME: Figure out the define for alignment of 16. */
-   result = pvr_gpu_upload_pds(device,
-                               NULL,
-                               0,
-                               0,
-                               staging_buffer,
-                               info->code_size_in_dwords,
-                               16,
-                               16,
-                               program);
+   result = pvr_gpu_upload_pds_cached(device,
+                                      NULL,
+                                      0,
+                                      0,
+                                      staging_buffer,
+                                      info->code_size_in_dwords,
+                                      16,
+                                      16,
+                                      program);
    if (result != VK_SUCCESS)
       goto err_free_staging_buffer;
 
@@ -377,7 +377,7 @@ static inline void pvr_pds_vertex_attrib_program_destroy(
    const struct VkAllocationCallbacks *const allocator,
    struct pvr_pds_attrib_program *const program)
 {
-   pvr_bo_suballoc_free(program->program.pvr_bo);
+   pvr_gpu_upload_pds_cached_release(device, &program->program);
    vk_free2(&device->vk.alloc, allocator, program->info.entries);
 }
 
@@ -540,6 +540,8 @@ static VkResult pvr_pds_descriptor_program_create_and_upload(
    const struct pvr_pipeline_layout *const layout,
    enum pvr_stage_allocation stage,
    const struct pvr_sh_reg_layout *sh_reg_layout,
+   pvr_dev_addr_t preamble_dev_addr,
+   uint32_t preamble_temps,
    struct pvr_stage_allocation_descriptor_state *const descriptor_state)
 {
    const size_t const_entries_size_in_bytes =
@@ -583,6 +585,15 @@ static VkResult pvr_pds_descriptor_program_create_and_upload(
 
    program.addr_literal_count = addr_literals;
 
+   if (sh_reg_layout->preamble.present) {
+      program.secondary_program_present = true;
+      pvr_pds_setup_doutu(&program.secondary_task_control,
+                          preamble_dev_addr.addr,
+                          preamble_temps,
+                          ROGUE_PDSINST_DOUTU_SAMPLE_RATE_INSTANCE,
+                          false);
+   }
+
    pds_info->entries = vk_alloc2(&device->vk.alloc,
                                  allocator,
                                  const_entries_size_in_bytes,
@@ -639,15 +650,15 @@ static VkResult pvr_pds_descriptor_program_create_and_upload(
    pds_info->entries_size_in_bytes = pds_info->entries_written_size_in_bytes;
 
    /* FIXME: Figure out the define for alignment of 16. */
-   result = pvr_gpu_upload_pds(device,
-                               NULL,
-                               0,
-                               0,
-                               staging_buffer,
-                               pds_info->code_size_in_dwords,
-                               16,
-                               16,
-                               &descriptor_state->pds_code);
+   result = pvr_gpu_upload_pds_cached(device,
+                                      NULL,
+                                      0,
+                                      0,
+                                      staging_buffer,
+                                      pds_info->code_size_in_dwords,
+                                      16,
+                                      16,
+                                      &descriptor_state->pds_code);
    if (result != VK_SUCCESS)
       goto err_free_staging_buffer;
 
@@ -675,7 +686,7 @@ static void pvr_pds_descriptor_program_destroy(
    if (!descriptor_state)
       return;
 
-   pvr_bo_suballoc_free(descriptor_state->pds_code.pvr_bo);
+   pvr_gpu_upload_pds_cached_release(device, &descriptor_state->pds_code);
    vk_free2(&device->vk.alloc, allocator, descriptor_state->pds_info.entries);
    pvr_bo_suballoc_free(descriptor_state->static_consts);
 }
@@ -855,15 +866,15 @@ static VkResult pvr_pds_compute_base_workgroup_variant_program_init(
                           dev_info);
 
    /* FIXME: Figure out the define for alignment of 16. */
-   result = pvr_gpu_upload_pds(device,
-                               NULL,
-                               0,
-                               0,
-                               buffer,
-                               program.code_size,
-                               16,
-                               16,
-                               &program_out->code_upload);
+   result = pvr_gpu_upload_pds_cached(device,
+                                      NULL,
+                                      0,
+                                      0,
+                                      buffer,
+                                      program.code_size,
+                                      16,
+                                      16,
+                                      &program_out->code_upload);
    if (result != VK_SUCCESS) {
       vk_free2(&device->vk.alloc, allocator, buffer);
       return result;
@@ -895,7 +906,7 @@ static void pvr_pds_compute_base_workgroup_variant_program_finish(
    const VkAllocationCallbacks *const allocator,
    struct pvr_pds_base_workgroup_program *const state)
 {
-   pvr_bo_suballoc_free(state->code_upload.pvr_bo);
+   pvr_gpu_upload_pds_cached_release(device, &state->code_upload);
    vk_free2(&device->vk.alloc, allocator, state->data_section);
 }
 
@@ -1009,6 +1020,8 @@ static VkResult pvr_compute_pipeline_compile(
       layout,
       PVR_STAGE_ALLOCATION_COMPUTE,
       sh_reg_layout,
+      PVR_DEV_ADDR_INVALID,
+      0,
       &compute_pipeline->descriptor_state);
    if (result != VK_SUCCESS)
       goto err_free_shader;
@@ -1215,8 +1228,9 @@ pvr_graphics_pipeline_destroy(struct pvr_device *const device,
 
    pvr_bo_suballoc_free(
       gfx_pipeline->shader_state.fragment.pds_fragment_program.pvr_bo);
-   pvr_bo_suballoc_free(
-      gfx_pipeline->shader_state.fragment.pds_coeff_program.pvr_bo);
+   pvr_gpu_upload_pds_cached_release(
+      device,
+      &gfx_pipeline->shader_state.fragment.pds_coeff_program);
 
    pvr_bo_suballoc_free(gfx_pipeline->shader_state.fragment.bo);
    pvr_bo_suballoc_free(gfx_pipeline->shader_state.vertex.bo);
@@ -2079,6 +2093,76 @@ pvr_postprocess_shader_data(pco_data *data,
    /* TODO: common things, like large constants being put into shareds. */
 }
 
+/* Upper bound on the sh regs a shader preamble may use, to avoid eating into
+ * the shared register space available for tiles in flight.
+ */
+#define PVR_PREAMBLE_MAX_SH_REGS 64U
+
+static struct pvr_sh_reg_layout *
+pvr_graphics_pipeline_stage_sh_reg_layout(gl_shader_stage stage,
+                                          struct pvr_sh_reg_layout *vert,
+                                          struct pvr_sh_reg_layout *frag)
+{
+   switch (stage) {
+   case MESA_SHADER_VERTEX:
+      return vert;
+
+   case MESA_SHADER_FRAGMENT:
+      return frag;
+
+   default:
+      return NULL;
+   }
+}
+
+/* Tells the compiler which sh regs are free for the shader preamble to store
+ * hoisted uniform values in, i.e. those after the sh_reg_count regs allocated
+ * by pvr_graphics_pipeline_alloc_shareds().
+ */
+static void
+pvr_graphics_pipeline_setup_preamble(const struct pvr_device *device,
+                                     gl_shader_stage stage,
+                                     uint32_t sh_reg_count,
+                                     pco_data *data)
+{
+   const struct pvr_device_runtime_info *dev_runtime_info =
+      &device->pdevice->dev_runtime_info;
+   const uint32_t available_shareds = dev_runtime_info->reserved_shared_size -
+                                      dev_runtime_info->max_coeffs;
+
+   data->common.preamble.start = 0;
+   data->common.preamble.max = 0;
+
+   if (stage != MESA_SHADER_VERTEX && stage != MESA_SHADER_FRAGMENT)
+      return;
+
+   if (sh_reg_count >= available_shareds)
+      return;
+
+   data->common.preamble.start = sh_reg_count;
+   data->common.preamble.max =
+      MIN2(available_shareds - sh_reg_count, PVR_PREAMBLE_MAX_SH_REGS);
+}
+
+static void
+pvr_graphics_pipeline_save_preamble(gl_shader_stage stage,
+                                    struct pvr_sh_reg_layout *vert_layout,
+                                    struct pvr_sh_reg_layout *frag_layout,
+                                    const pco_data *data)
+{
+   struct pvr_sh_reg_layout *sh_reg_layout =
+      pvr_graphics_pipeline_stage_sh_reg_layout(stage,
+                                                vert_layout,
+                                                frag_layout);
+
+   if (!sh_reg_layout)
+      return;
+
+   sh_reg_layout->preamble.present = !!data->common.preamble.count;
+   sh_reg_layout->preamble.offset = data->common.preamble.start;
+   sh_reg_layout->preamble.count = data->common.preamble.count;
+}
+
 /* Compiles and uploads shaders and PDS programs. */
 static VkResult
 pvr_graphics_pipeline_compile(struct pvr_device *const device,
@@ -2109,6 +2193,7 @@ pvr_graphics_pipeline_compile(struct pvr_device *const device,
    nir_shader *producer = NULL;
    nir_shader *consumer = NULL;
    pco_data shader_data[MESA_SHADER_STAGES] = { 0 };
+   uint32_t sh_reg_counts[MESA_SHADER_STAGES] = { 0 };
    nir_shader *nir_shaders[MESA_SHADER_STAGES] = { 0 };
    pco_shader *pco_shaders[MESA_SHADER_STAGES] = { 0 };
    pco_shader **vs = &pco_shaders[MESA_SHADER_VERTEX];
@@ -2161,6 +2246,17 @@ pvr_graphics_pipeline_compile(struct pvr_device *const device,
       consumer = nir_shaders[stage];
    }
 
+   sh_reg_counts[MESA_SHADER_VERTEX] =
+      pvr_graphics_pipeline_alloc_shareds(device,
+                                          gfx_pipeline,
+                                          PVR_STAGE_ALLOCATION_VERTEX_GEOMETRY,
+                                          sh_reg_layout_vert);
+   sh_reg_counts[MESA_SHADER_FRAGMENT] =
+      pvr_graphics_pipeline_alloc_shareds(device,
+                                          gfx_pipeline,
+                                          PVR_STAGE_ALLOCATION_FRAGMENT,
+                                          sh_reg_layout_frag);
+
    for (gl_shader_stage stage = 0; stage < MESA_SHADER_STAGES; ++stage) {
       if (!nir_shaders[stage])
          continue;
@@ -2169,6 +2265,11 @@ pvr_graphics_pipeline_compile(struct pvr_device *const device,
                                  nir_shaders[stage],
                                  pCreateInfo);
 
+      pvr_graphics_pipeline_setup_preamble(device,
+                                           stage,
+                                           sh_reg_counts[stage],
+                                           &shader_data[stage]);
+
       pco_lower_nir(pco_ctx, nir_shaders[stage], &shader_data[stage]);
       pvr_lower_nir(pco_ctx, layout, nir_shaders[stage]);
 
@@ -2177,13 +2278,12 @@ pvr_graphics_pipeline_compile(struct pvr_device *const device,
       pvr_postprocess_shader_data(&shader_data[stage],
                                   nir_shaders[stage],
                                   pCreateInfo);
-   }
 
-   /* TODO NEXT: setup shareds/for descriptors, here or in
-    * pvr_{pre,post}process_shader_data.
-    */
-   memset(sh_reg_layout_vert, 0, sizeof(*sh_reg_layout_vert));
-   memset(sh_reg_layout_frag, 0, sizeof(*sh_reg_layout_frag));
+      pvr_graphics_pipeline_save_preamble(stage,
+                                          sh_reg_layout_vert,
+                                          sh_reg_layout_frag,
+                                          &shader_data[stage]);
+   }
 
    for (gl_shader_stage stage = 0; stage < MESA_SHADER_STAGES; ++stage) {
       pco_shader **pco = &pco_shaders[stage];
@@ -2265,6 +2365,8 @@ pvr_graphics_pipeline_compile(struct pvr_device *const device,
          layout,
          PVR_STAGE_ALLOCATION_FRAGMENT,
          sh_reg_layout_frag,
+         fragment_state->bo->dev_addr,
+         shader_data[MESA_SHADER_FRAGMENT].common.preamble.temps,
          &fragment_state->descriptor_state);
       if (result != VK_SUCCESS)
          goto err_free_frag_program;
@@ -2291,6 +2393,8 @@ pvr_graphics_pipeline_compile(struct pvr_device *const device,
       layout,
       PVR_STAGE_ALLOCATION_VERTEX_GEOMETRY,
       sh_reg_layout_vert,
+      vertex_state->bo->dev_addr,
+      shader_data[MESA_SHADER_VERTEX].common.preamble.temps,
       &vertex_state->descriptor_state);
    if (result != VK_SUCCESS)
       goto err_free_vertex_attrib_program;
@@ -2321,7 +2425,8 @@ err_free_frag_descriptor_program:
 err_free_frag_program:
    pvr_bo_suballoc_free(fragment_state->pds_fragment_program.pvr_bo);
 err_free_coeff_program:
-   pvr_bo_suballoc_free(fragment_state->pds_coeff_program.pvr_bo);
+   pvr_gpu_upload_pds_cached_release(device,
+                                     &fragment_state->pds_coeff_program);
 err_free_fragment_bo:
    pvr_bo_suballoc_free(fragment_state->bo);
 err_free_vertex_bo:
@@ -2409,6 +2514,15 @@ pvr_graphics_pipeline_init(struct pvr_device *device,
    if (state.rs->rasterizer_discard_enable)
       dynamic_state->ms.rasterization_samples = VK_SAMPLE_COUNT_1_BIT;
 
+   pvr_csb_pack (&gfx_pipeline->ppp_control, TA_STATE_PPP_CTRL, control) {
+      control.drawclippededges = true;
+      control.wclampen = true;
+   }
+
+   pvr_ppp_control_repack(&gfx_pipeline->ppp_control,
+                          dynamic_state,
+                          dynamic_state->set);
+
    memset(gfx_pipeline->stage_indices, ~0, sizeof(gfx_pipeline->stage_indices));
 
    for (uint32_t i = 0; i < pCreateInfo->stageCount; i++) {
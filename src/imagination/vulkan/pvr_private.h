@@ -52,6 +52,8 @@
 #include "pvr_pds.h"
 #include "usc/programs/pvr_shader_factory.h"
 #include "pvr_spm.h"
+#include "pvr_transfer_frag_store.h"
+#include "pvr_twiddle.h"
 #include "pvr_types.h"
 #include "pvr_winsys.h"
 #include "rogue/rogue.h"
@@ -65,6 +67,7 @@
 #include "vk_buffer.h"
 #include "vk_buffer_view.h"
 #include "vk_command_buffer.h"
+#include "vk_command_pool.h"
 #include "vk_device.h"
 #include "vk_enum_to_str.h"
 #include "vk_graphics_state.h"
@@ -109,6 +112,9 @@ struct pvr_physical_device {
 
    VkPhysicalDeviceMemoryProperties memory;
 
+   /* Bytes of device memory in use, including the driver's internal
+    * allocations. Updated atomically.
+    */
    uint64_t heap_used;
 
    struct wsi_device wsi_device;
@@ -135,6 +141,22 @@ struct pvr_queue {
 
    struct vk_sync *last_job_signal_sync[PVR_JOB_TYPE_MAX];
    struct vk_sync *next_job_wait_sync[PVR_JOB_TYPE_MAX];
+
+   /* Syncs signalled by the null jobs carrying the semaphore waits of the last
+    * submission. They're waited on by the next submission so waits without a
+    * job to apply to still take effect.
+    */
+   struct vk_sync *submit_wait_syncs[PVR_JOB_TYPE_MAX + 1];
+   uint32_t submit_wait_sync_count;
+
+   /* One of submit_wait_syncs for each job type whose first job in the
+    * submission hasn't been submitted yet, or NULL.
+    */
+   struct vk_sync *submit_wait_sync[PVR_JOB_TYPE_MAX];
+
+   /* Transfer sub commands performed by the CPU instead of the GPU. */
+   uint64_t cpu_transfer_sub_cmd_count;
+   uint64_t cpu_transfer_bytes;
 };
 
 struct pvr_vertex_binding {
@@ -165,6 +187,20 @@ struct pvr_compute_query_shader {
    struct pvr_pds_upload pds_sec_code;
 };
 
+/* Device-wide cache of PDS uploads which don't embed any per-object state
+ * (e.g. code only programs). Identical programs generated by different
+ * pipelines, render passes or transfer contexts share a single refcounted
+ * suballocation instead of each uploading their own copy.
+ */
+struct pvr_pds_upload_cache {
+   simple_mtx_t mutex;
+
+   /* SHA1 of the upload contents -> struct pvr_pds_upload_cache_entry. */
+   struct hash_table *entries;
+   /* struct pvr_suballoc_bo * -> struct pvr_pds_upload_cache_entry. */
+   struct hash_table *bo_entries;
+};
+
 struct pvr_device {
    struct vk_device vk;
    struct pvr_instance *instance;
@@ -175,6 +211,40 @@ struct pvr_device {
 
    struct pvr_free_list *global_free_list;
 
+   /* Global free list sizing policy and parameter buffer usage statistics.
+    * See pvr_device_free_list_note_render().
+    */
+   struct pvr_free_list_stats {
+      simple_mtx_t mutex;
+
+      /* Sizes the global free list was created with. */
+      uint32_t initial_size;
+      uint32_t grow_size;
+      uint32_t max_size;
+
+      /* Estimated size of the free list after any firmware grow operations,
+       * i.e. the largest of initial_size and the demand seen so far, rounded
+       * up to grow_size.
+       */
+      uint64_t estimated_size;
+
+      /* Peak demand recorded for the app in previous runs, if any. */
+      uint32_t recorded_peak_demand;
+
+      /* Largest estimated parameter buffer demand of a single render. */
+      uint64_t peak_demand;
+
+      uint64_t render_count;
+
+      /* Renders estimated to need the firmware to grow the free list. */
+      uint64_t grow_events;
+
+      /* Renders estimated to exceed the free list's max size, requiring a
+       * partial render (SPM) to complete.
+       */
+      uint64_t partial_renders;
+   } free_list_stats;
+
    struct pvr_queue *queues;
    uint32_t queue_count;
 
@@ -202,6 +272,14 @@ struct pvr_device {
    struct pvr_suballocator suballoc_usc;
    struct pvr_suballocator suballoc_vis_test;
 
+   struct pvr_pds_upload_cache pds_upload_cache;
+   struct pvr_renderpass_hwsetup_cache hwsetup_cache;
+
+   /* Transfer fragment shaders, shared by the transfer contexts of all the
+    * queues.
+    */
+   struct pvr_transfer_frag_store transfer_frag_store;
+
    struct {
       struct pvr_pds_upload pds;
       struct pvr_suballoc_bo *usc;
@@ -276,7 +354,10 @@ struct pvr_device {
 
    struct pvr_spm_scratch_buffer_store spm_scratch_buffer_store;
 
+   struct pvr_rt_dataset_cache rt_dataset_cache;
+
    struct pvr_bo_store *bo_store;
+   struct pvr_bo_heap_usage bo_heap_usage;
 
    struct pvr_bo *robustness_buffer;
 
@@ -345,6 +426,12 @@ struct pvr_image_view {
     * attachment cases.
     */
    uint64_t texture_state[PVR_TEXTURE_STATE_MAX_ENUM][2];
+
+   /* Prepacked Texture Image dword 0 and 1 used by the load op programs to
+    * read back the attachment at the start of a render. Only valid if the
+    * image has a color or depth/stencil attachment usage.
+    */
+   uint64_t load_op_texture_state[2];
 };
 
 struct pvr_buffer_view {
@@ -441,6 +528,40 @@ struct pvr_transfer_cmd {
     * cannot be freed directly.
     */
    bool is_deferred_clear;
+
+   /* Set on small buffer copies and fills, which the queue may perform with
+    * the CPU at submit time instead if no GPU work precedes them.
+    */
+   struct pvr_transfer_cmd_cpu {
+      bool enabled;
+      bool is_fill;
+      uint32_t fill_data;
+      VkDeviceSize size;
+
+      /* Source, either persistently mapped upload memory or a buffer, which
+       * only needs to be mapped by the time the command buffer is submitted.
+       */
+      const void *src_map;
+      const struct pvr_buffer *src_buffer;
+      VkDeviceSize src_offset;
+
+      const struct pvr_buffer *dst_buffer;
+      VkDeviceSize dst_offset;
+
+      /* Set instead of dst_buffer for buffer to image copies, with dst_offset
+       * being the offset of the subresource within the image. The copy is
+       * limited to a region of a single slice, in elements of region.cpp bytes
+       * with region.row_pitch being the pitch of the source buffer.
+       * dst_width and dst_height are the extent of a twiddled mip level and
+       * dst_row_pitch the pitch of a linear one.
+       */
+      const struct pvr_image *dst_image;
+      struct pvr_twiddle_region region;
+      bool dst_twiddled;
+      uint32_t dst_width;
+      uint32_t dst_height;
+      VkDeviceSize dst_row_pitch;
+   } cpu;
 };
 
 struct pvr_sub_cmd_gfx {
@@ -475,6 +596,11 @@ struct pvr_sub_cmd_gfx {
    /* Required iff pvr_sub_cmd_gfx_requires_split_submit() returns true. */
    struct pvr_bo *terminate_ctrl_stream;
 
+   /* Device copy of a deferred control stream which doesn't need patching on
+    * execution. Primaries link to it instead of copying the stream.
+    */
+   struct pvr_suballoc_bo *deferred_ctrl_stream;
+
    uint32_t hw_render_idx;
 
    uint32_t max_tiles_in_flight;
@@ -506,6 +632,11 @@ struct pvr_sub_cmd_gfx {
    bool has_occlusion_query;
 
    bool wait_on_previous_transfer;
+
+   /* Number of vertices submitted by direct draws, used to estimate the
+    * parameter buffer usage of the render. Indirect draws aren't counted.
+    */
+   uint64_t geometry_vertices;
 };
 
 struct pvr_sub_cmd_compute {
@@ -686,6 +817,50 @@ struct pvr_cmd_buffer_draw_state {
    bool draw_indexed;
 };
 
+/* Number of uploaded PDS vertex attrib data sections a command buffer keeps
+ * track of for reuse.
+ */
+#define PVR_PDS_VERTEX_ATTRIB_DATA_CACHE_SIZE 4U
+
+/* The PDS vertex attrib data section only depends on the attrib program
+ * variant, the bound vertex buffers and the base vertex/instance.
+ */
+struct pvr_pds_vertex_attrib_data_key {
+   const struct pvr_pds_info *info;
+   uint32_t vertex_bindings_generation;
+   uint32_t base_instance;
+   uint32_t base_vertex;
+};
+
+struct pvr_query_info {
+   enum pvr_query_type type;
+
+   union {
+      struct {
+         uint32_t num_query_indices;
+         struct pvr_suballoc_bo *index_bo;
+         uint32_t num_queries;
+         struct pvr_suballoc_bo *availability_bo;
+      } availability_write;
+
+      struct {
+         VkQueryPool query_pool;
+         uint32_t first_query;
+         uint32_t query_count;
+      } reset_query_pool;
+
+      struct {
+         VkQueryPool query_pool;
+         uint32_t first_query;
+         uint32_t query_count;
+         VkBuffer dst_buffer;
+         VkDeviceSize dst_offset;
+         VkDeviceSize stride;
+         VkQueryResultFlags flags;
+      } copy_query_results;
+   };
+};
+
 struct pvr_cmd_buffer_state {
    /* Pipeline binding. */
    const struct pvr_graphics_pipeline *gfx_pipeline;
@@ -702,6 +877,9 @@ struct pvr_cmd_buffer_state {
 
    struct pvr_vertex_binding vertex_bindings[PVR_MAX_VERTEX_INPUT_BINDINGS];
 
+   /* Incremented whenever vertex_bindings changes. */
+   uint32_t vertex_bindings_generation;
+
    struct {
       struct pvr_buffer *buffer;
       VkDeviceSize offset;
@@ -768,11 +946,42 @@ struct pvr_cmd_buffer_state {
 
    struct util_dynarray query_indices;
 
+   /* Reset/copy query program recorded but not yet emitted, so that
+    * consecutive operations on the same query pool can be folded into a
+    * single compute dispatch. Flushed by
+    * pvr_cmd_buffer_flush_pending_query().
+    */
+   struct pvr_query_info pending_query;
+   bool has_pending_query;
+
    uint32_t max_shared_regs;
 
    /* Address of data segment for vertex attrib upload program. */
    uint32_t pds_vertex_attrib_offset;
 
+   /* Recently uploaded vertex attrib data segments, replaced round robin. */
+   struct {
+      struct pvr_pds_vertex_attrib_data_key
+         keys[PVR_PDS_VERTEX_ATTRIB_DATA_CACHE_SIZE];
+      uint32_t offsets[PVR_PDS_VERTEX_ATTRIB_DATA_CACHE_SIZE];
+      uint32_t next;
+   } pds_vertex_attrib_data_cache;
+
+   /* VDM state last emitted into the current control stream, so draws only
+    * emit the state words that changed. Invalidated by
+    * pvr_reset_graphics_dirty_state().
+    */
+   struct {
+      bool valid;
+
+      /* VDM_STATE0 without any of the *_present bits set. */
+      uint32_t state0;
+      uint32_t cut_index;
+      uint32_t vs_pds_data_offset;
+      const struct pvr_pds_info *vs_pds_info;
+      uint32_t vs_pds_code_offset;
+   } vdm_state;
+
    uint32_t pds_fragment_descriptor_data_offset;
    uint32_t pds_compute_descriptor_data_offset;
 };
@@ -797,6 +1006,15 @@ struct pvr_scissor_words {
    uint32_t w1;
 };
 
+struct pvr_cmd_pool {
+   struct vk_command_pool vk;
+
+   /* Control stream buffer objects recycled across the command buffers
+    * allocated from this pool.
+    */
+   struct pvr_csb_bo_pool csb_bo_pool;
+};
+
 struct pvr_cmd_buffer {
    struct vk_command_buffer vk;
 
@@ -942,6 +1160,12 @@ struct pvr_graphics_pipeline {
    /* Derived and other state */
    size_t stage_indices[MESA_SHADER_STAGES];
 
+   /* TA_STATE_PPP_CTRL with the fields derived from static state packed.
+    * Copied at draw time, when the fields derived from dynamic state are
+    * repacked on top.
+    */
+   uint32_t ppp_control;
+
    pco_data vs_data;
    pco_data fs_data;
 
@@ -986,35 +1210,6 @@ struct pvr_private_compute_pipeline {
    pvr_dev_addr_t const_buffer_addr;
 };
 
-struct pvr_query_info {
-   enum pvr_query_type type;
-
-   union {
-      struct {
-         uint32_t num_query_indices;
-         struct pvr_suballoc_bo *index_bo;
-         uint32_t num_queries;
-         struct pvr_suballoc_bo *availability_bo;
-      } availability_write;
-
-      struct {
-         VkQueryPool query_pool;
-         uint32_t first_query;
-         uint32_t query_count;
-      } reset_query_pool;
-
-      struct {
-         VkQueryPool query_pool;
-         uint32_t first_query;
-         uint32_t query_count;
-         VkBuffer dst_buffer;
-         VkDeviceSize dst_offset;
-         VkDeviceSize stride;
-         VkQueryResultFlags flags;
-      } copy_query_results;
-   };
-};
-
 struct pvr_render_target {
    struct pvr_rt_dataset *rt_dataset;
 
@@ -1198,6 +1393,9 @@ VkResult pvr_queues_create(struct pvr_device *device,
                            const VkDeviceCreateInfo *pCreateInfo);
 void pvr_queues_destroy(struct pvr_device *device);
 
+void pvr_device_free_list_note_render(struct pvr_device *device,
+                                      const struct pvr_sub_cmd_gfx *sub_cmd);
+
 VkResult pvr_bind_memory(struct pvr_device *device,
                          struct pvr_device_memory *mem,
                          VkDeviceSize offset,
@@ -1221,6 +1419,18 @@ VkResult pvr_gpu_upload_pds(struct pvr_device *device,
                             uint32_t code_alignment,
                             uint64_t min_alignment,
                             struct pvr_pds_upload *const pds_upload_out);
+VkResult pvr_gpu_upload_pds_cached(struct pvr_device *device,
+                                   const uint32_t *data,
+                                   uint32_t data_size_dwords,
+                                   uint32_t data_alignment,
+                                   const uint32_t *code,
+                                   uint32_t code_size_dwords,
+                                   uint32_t code_alignment,
+                                   uint64_t min_alignment,
+                                   struct pvr_pds_upload *const pds_upload_out);
+void pvr_gpu_upload_pds_cached_release(
+   struct pvr_device *device,
+   const struct pvr_pds_upload *const pds_upload);
 VkResult pvr_gpu_upload_usc(struct pvr_device *device,
                             const void *code,
                             size_t code_size,
@@ -1331,6 +1541,15 @@ pvr_stage_mask_dst(VkPipelineStageFlags2 stage_mask)
    return pvr_stage_mask(stage_mask);
 }
 
+static inline struct pvr_csb_bo_pool *
+pvr_cmd_buffer_get_csb_bo_pool(const struct pvr_cmd_buffer *cmd_buffer)
+{
+   struct pvr_cmd_pool *pool =
+      container_of(cmd_buffer->vk.pool, struct pvr_cmd_pool, vk);
+
+   return &pool->csb_bo_pool;
+}
+
 static inline bool pvr_sub_cmd_gfx_requires_split_submit(
    const struct pvr_sub_cmd_gfx *const sub_cmd)
 {
@@ -1426,10 +1645,17 @@ void pvr_device_destroy_compute_query_programs(struct pvr_device *device);
 
 VkResult pvr_add_query_program(struct pvr_cmd_buffer *cmd_buffer,
                                const struct pvr_query_info *query_info);
+VkResult
+pvr_cmd_buffer_flush_pending_query(struct pvr_cmd_buffer *cmd_buffer);
 
 void pvr_reset_graphics_dirty_state(struct pvr_cmd_buffer *const cmd_buffer,
                                     bool start_geom);
 
+void
+pvr_ppp_control_repack(uint32_t *ppp_control,
+                       const struct vk_dynamic_graphics_state *dynamic_state,
+                       const BITSET_WORD *states);
+
 const struct pvr_renderpass_hwsetup_subpass *
 pvr_get_hw_subpass(const struct pvr_render_pass *pass, const uint32_t subpass);
 
@@ -1456,6 +1682,10 @@ VK_DEFINE_HANDLE_CASTS(pvr_physical_device,
                        VK_OBJECT_TYPE_PHYSICAL_DEVICE)
 VK_DEFINE_HANDLE_CASTS(pvr_queue, vk.base, VkQueue, VK_OBJECT_TYPE_QUEUE)
 
+VK_DEFINE_NONDISP_HANDLE_CASTS(pvr_cmd_pool,
+                               vk.base,
+                               VkCommandPool,
+                               VK_OBJECT_TYPE_COMMAND_POOL)
 VK_DEFINE_NONDISP_HANDLE_CASTS(pvr_device_memory,
                                base,
                                VkDeviceMemory,
@@ -1482,6 +1712,10 @@ VK_DEFINE_NONDISP_HANDLE_CASTS(pvr_descriptor_set,
                                VkDescriptorSet,
                                VK_OBJECT_TYPE_DESCRIPTOR_SET)
 VK_DEFINE_NONDISP_HANDLE_CASTS(pvr_event, base, VkEvent, VK_OBJECT_TYPE_EVENT)
+VK_DEFINE_NONDISP_HANDLE_CASTS(pvr_descriptor_update_template,
+                               base,
+                               VkDescriptorUpdateTemplate,
+                               VK_OBJECT_TYPE_DESCRIPTOR_UPDATE_TEMPLATE)
 VK_DEFINE_NONDISP_HANDLE_CASTS(pvr_descriptor_pool,
                                base,
                                VkDescriptorPool,
@@ -36,6 +36,7 @@
 #include "pvr_private.h"
 #include "util/macros.h"
 #include "util/os_time.h"
+#include "util/u_atomic.h"
 #include "vk_log.h"
 #include "vk_object.h"
 
@@ -132,9 +133,14 @@ void pvr_DestroyQueryPool(VkDevice _device,
 static inline bool pvr_query_is_available(const struct pvr_query_pool *pool,
                                           uint32_t query_idx)
 {
-   volatile uint32_t *available =
+   uint32_t *available =
       pvr_bo_suballoc_get_map_addr(pool->availability_buffer);
-   return !!available[query_idx];
+
+   /* The device writes the query values before the availability, so an
+    * ordered load here is enough to make sure the values read afterwards are
+    * complete without having to take any lock.
+    */
+   return !!p_atomic_read(&available[query_idx]);
 }
 
 #define NSEC_PER_SEC UINT64_C(1000000000)
@@ -234,13 +240,14 @@ VkResult pvr_GetQueryPoolResults(VkDevice _device,
          is_available = true;
       }
 
-      for (uint32_t j = 0; j < core_count; j++)
-         count += query_results[pool->result_stride * j + firstQuery + i];
+      if (is_available || (flags & VK_QUERY_RESULT_PARTIAL_BIT)) {
+         for (uint32_t j = 0; j < core_count; j++)
+            count += query_results[pool->result_stride * j + firstQuery + i];
 
-      if (is_available || (flags & VK_QUERY_RESULT_PARTIAL_BIT))
          pvr_write_query_to_buffer(data, flags, 0, count);
-      else
+      } else {
          result = VK_NOT_READY;
+      }
 
       if (flags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT)
          pvr_write_query_to_buffer(data, flags, 1, is_available);
@@ -260,6 +267,205 @@ VkResult pvr_GetQueryPoolResults(VkDevice _device,
    return result;
 }
 
+static VkResult
+pvr_cmd_buffer_emit_copy_query_results(struct pvr_cmd_buffer *cmd_buffer,
+                                       const struct pvr_query_info *query_info)
+{
+   VkResult result;
+
+   result = pvr_cmd_buffer_start_sub_cmd(cmd_buffer, PVR_SUB_CMD_TYPE_EVENT);
+   if (result != VK_SUCCESS)
+      return result;
+
+   /* The Vulkan 1.3.231 spec says:
+    *
+    *    "vkCmdCopyQueryPoolResults is considered to be a transfer operation,
+    *    and its writes to buffer memory must be synchronized using
+    *    VK_PIPELINE_STAGE_TRANSFER_BIT and VK_ACCESS_TRANSFER_WRITE_BIT before
+    *    using the results."
+    *
+    */
+   /* We record barrier event sub commands to sync the compute job used for the
+    * copy query results program with transfer jobs to prevent an overlapping
+    * transfer job with the compute job.
+    */
+
+   cmd_buffer->state.current_sub_cmd->event = (struct pvr_sub_cmd_event){
+      .type = PVR_EVENT_TYPE_BARRIER,
+      .barrier = {
+         .wait_for_stage_mask = PVR_PIPELINE_STAGE_TRANSFER_BIT,
+         .wait_at_stage_mask = PVR_PIPELINE_STAGE_OCCLUSION_QUERY_BIT,
+      },
+   };
+
+   result = pvr_cmd_buffer_end_sub_cmd(cmd_buffer);
+   if (result != VK_SUCCESS)
+      return result;
+
+   result = pvr_add_query_program(cmd_buffer, query_info);
+   if (result != VK_SUCCESS)
+      return result;
+
+   result = pvr_cmd_buffer_start_sub_cmd(cmd_buffer, PVR_SUB_CMD_TYPE_EVENT);
+   if (result != VK_SUCCESS)
+      return result;
+
+   cmd_buffer->state.current_sub_cmd->event = (struct pvr_sub_cmd_event){
+      .type = PVR_EVENT_TYPE_BARRIER,
+      .barrier = {
+         .wait_for_stage_mask = PVR_PIPELINE_STAGE_OCCLUSION_QUERY_BIT,
+         .wait_at_stage_mask = PVR_PIPELINE_STAGE_TRANSFER_BIT,
+      },
+   };
+
+   return VK_SUCCESS;
+}
+
+/**
+ * \brief Emits the reset/copy query program held back by
+ * pvr_cmd_buffer_add_pending_query(), if any.
+ *
+ * Must be called before anything that depends on the ordering of recorded
+ * work, i.e. starting a new sub command, barriers, executing secondary
+ * command buffers and ending the command buffer.
+ *
+ * \param[in] cmd_buffer Command buffer being recorded.
+ * \return VK_SUCCESS or the error raised while emitting the program.
+ */
+VkResult pvr_cmd_buffer_flush_pending_query(struct pvr_cmd_buffer *cmd_buffer)
+{
+   struct pvr_cmd_buffer_state *state = &cmd_buffer->state;
+   struct pvr_query_info query_info;
+
+   if (!state->has_pending_query)
+      return VK_SUCCESS;
+
+   /* Clear it first as emitting the program starts new sub commands, which
+    * flush again.
+    */
+   query_info = state->pending_query;
+   state->has_pending_query = false;
+
+   switch (query_info.type) {
+   case PVR_QUERY_TYPE_RESET_QUERY_POOL:
+      return pvr_add_query_program(cmd_buffer, &query_info);
+
+   case PVR_QUERY_TYPE_COPY_QUERY_RESULTS:
+      return pvr_cmd_buffer_emit_copy_query_results(cmd_buffer, &query_info);
+
+   default:
+      unreachable("Invalid pending query type");
+   }
+}
+
+/* Returns the offset into the destination buffer at which the copy query
+ * results program starts writing, matching pvr_add_query_program().
+ */
+static inline VkDeviceSize
+pvr_copy_query_results_dst_start(const struct pvr_query_info *query_info)
+{
+   return query_info->copy_query_results.dst_offset +
+          query_info->copy_query_results.first_query *
+             query_info->copy_query_results.stride;
+}
+
+/* Tries to fold next into pending so that both are handled by a single
+ * dispatch. Only operations on consecutive query ranges of the same pool are
+ * merged, and for copies the destination ranges must follow on from each other
+ * with the same stride and flags.
+ */
+static bool pvr_query_info_merge(struct pvr_query_info *pending,
+                                 const struct pvr_query_info *next)
+{
+   if (pending->type != next->type)
+      return false;
+
+   switch (next->type) {
+   case PVR_QUERY_TYPE_RESET_QUERY_POOL: {
+      const uint32_t pending_first = pending->reset_query_pool.first_query;
+      const uint32_t pending_end =
+         pending_first + pending->reset_query_pool.query_count;
+      const uint32_t next_first = next->reset_query_pool.first_query;
+      const uint32_t next_end =
+         next_first + next->reset_query_pool.query_count;
+
+      if (pending->reset_query_pool.query_pool !=
+          next->reset_query_pool.query_pool) {
+         return false;
+      }
+
+      /* Resetting is idempotent so overlapping ranges are fine too. */
+      if (next_first > pending_end || pending_first > next_end)
+         return false;
+
+      pending->reset_query_pool.first_query = MIN2(pending_first, next_first);
+      pending->reset_query_pool.query_count =
+         MAX2(pending_end, next_end) - pending->reset_query_pool.first_query;
+
+      return true;
+   }
+
+   case PVR_QUERY_TYPE_COPY_QUERY_RESULTS: {
+      const VkDeviceSize stride = pending->copy_query_results.stride;
+      const VkDeviceSize pending_dst_end =
+         pvr_copy_query_results_dst_start(pending) +
+         pending->copy_query_results.query_count * stride;
+
+      if (pending->copy_query_results.query_pool !=
+             next->copy_query_results.query_pool ||
+          pending->copy_query_results.dst_buffer !=
+             next->copy_query_results.dst_buffer ||
+          pending->copy_query_results.flags !=
+             next->copy_query_results.flags ||
+          stride != next->copy_query_results.stride) {
+         return false;
+      }
+
+      if (next->copy_query_results.first_query !=
+          pending->copy_query_results.first_query +
+             pending->copy_query_results.query_count) {
+         return false;
+      }
+
+      if (pvr_copy_query_results_dst_start(next) != pending_dst_end)
+         return false;
+
+      pending->copy_query_results.query_count +=
+         next->copy_query_results.query_count;
+
+      return true;
+   }
+
+   default:
+      return false;
+   }
+}
+
+/* Records a reset or copy query program. The program is held back in the
+ * command buffer state so that the per-query operations issued back to back
+ * by e.g. visibility culling end up in a single compute dispatch rather than
+ * one compute job each.
+ */
+static void
+pvr_cmd_buffer_add_pending_query(struct pvr_cmd_buffer *cmd_buffer,
+                                 const struct pvr_query_info *query_info)
+{
+   struct pvr_cmd_buffer_state *state = &cmd_buffer->state;
+   VkResult result;
+
+   if (state->has_pending_query &&
+       pvr_query_info_merge(&state->pending_query, query_info)) {
+      return;
+   }
+
+   result = pvr_cmd_buffer_flush_pending_query(cmd_buffer);
+   if (result != VK_SUCCESS)
+      return;
+
+   state->pending_query = *query_info;
+   state->has_pending_query = true;
+}
+
 void pvr_CmdResetQueryPool(VkCommandBuffer commandBuffer,
                            VkQueryPool queryPool,
                            uint32_t firstQuery,
@@ -276,7 +482,7 @@ void pvr_CmdResetQueryPool(VkCommandBuffer commandBuffer,
    query_info.reset_query_pool.first_query = firstQuery;
    query_info.reset_query_pool.query_count = queryCount;
 
-   pvr_add_query_program(cmd_buffer, &query_info);
+   pvr_cmd_buffer_add_pending_query(cmd_buffer, &query_info);
 }
 
 void pvr_ResetQueryPool(VkDevice _device,
@@ -302,7 +508,6 @@ void pvr_CmdCopyQueryPoolResults(VkCommandBuffer commandBuffer,
 {
    PVR_FROM_HANDLE(pvr_cmd_buffer, cmd_buffer, commandBuffer);
    struct pvr_query_info query_info;
-   VkResult result;
 
    PVR_CHECK_COMMAND_BUFFER_BUILDING_STATE(cmd_buffer);
 
@@ -316,48 +521,7 @@ void pvr_CmdCopyQueryPoolResults(VkCommandBuffer commandBuffer,
    query_info.copy_query_results.stride = stride;
    query_info.copy_query_results.flags = flags;
 
-   result = pvr_cmd_buffer_start_sub_cmd(cmd_buffer, PVR_SUB_CMD_TYPE_EVENT);
-   if (result != VK_SUCCESS)
-      return;
-
-   /* The Vulkan 1.3.231 spec says:
-    *
-    *    "vkCmdCopyQueryPoolResults is considered to be a transfer operation,
-    *    and its writes to buffer memory must be synchronized using
-    *    VK_PIPELINE_STAGE_TRANSFER_BIT and VK_ACCESS_TRANSFER_WRITE_BIT before
-    *    using the results."
-    *
-    */
-   /* We record barrier event sub commands to sync the compute job used for the
-    * copy query results program with transfer jobs to prevent an overlapping
-    * transfer job with the compute job.
-    */
-
-   cmd_buffer->state.current_sub_cmd->event = (struct pvr_sub_cmd_event){
-      .type = PVR_EVENT_TYPE_BARRIER,
-      .barrier = {
-         .wait_for_stage_mask = PVR_PIPELINE_STAGE_TRANSFER_BIT,
-         .wait_at_stage_mask = PVR_PIPELINE_STAGE_OCCLUSION_QUERY_BIT,
-      },
-   };
-
-   result = pvr_cmd_buffer_end_sub_cmd(cmd_buffer);
-   if (result != VK_SUCCESS)
-      return;
-
-   pvr_add_query_program(cmd_buffer, &query_info);
-
-   result = pvr_cmd_buffer_start_sub_cmd(cmd_buffer, PVR_SUB_CMD_TYPE_EVENT);
-   if (result != VK_SUCCESS)
-      return;
-
-   cmd_buffer->state.current_sub_cmd->event = (struct pvr_sub_cmd_event){
-      .type = PVR_EVENT_TYPE_BARRIER,
-      .barrier = {
-         .wait_for_stage_mask = PVR_PIPELINE_STAGE_OCCLUSION_QUERY_BIT,
-         .wait_at_stage_mask = PVR_PIPELINE_STAGE_TRANSFER_BIT,
-      },
-   };
+   pvr_cmd_buffer_add_pending_query(cmd_buffer, &query_info);
 }
 
 void pvr_CmdBeginQuery(VkCommandBuffer commandBuffer,
@@ -30,18 +30,23 @@
  */
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <vulkan/vulkan.h>
 
+#include "pvr_debug.h"
 #include "pvr_job_compute.h"
 #include "pvr_job_context.h"
 #include "pvr_job_render.h"
 #include "pvr_job_transfer.h"
 #include "pvr_limits.h"
 #include "pvr_private.h"
+#include "pvr_twiddle.h"
+#include "util/bitset.h"
+#include "util/log.h"
 #include "util/macros.h"
 #include "util/u_atomic.h"
 #include "vk_alloc.h"
@@ -168,6 +173,14 @@ err_queues_finish:
 
 static void pvr_queue_finish(struct pvr_queue *queue)
 {
+   if (PVR_IS_DEBUG_SET(INFO) && queue->cpu_transfer_sub_cmd_count) {
+      mesa_logi("queue %u: %" PRIu64 " transfer sub commands (%" PRIu64
+                " bytes) done on the CPU",
+                queue->vk.index_in_family,
+                queue->cpu_transfer_sub_cmd_count,
+                queue->cpu_transfer_bytes);
+   }
+
    for (uint32_t i = 0; i < ARRAY_SIZE(queue->next_job_wait_sync); i++) {
       if (queue->next_job_wait_sync[i])
          vk_sync_destroy(&queue->device->vk, queue->next_job_wait_sync[i]);
@@ -178,6 +191,9 @@ static void pvr_queue_finish(struct pvr_queue *queue)
          vk_sync_destroy(&queue->device->vk, queue->last_job_signal_sync[i]);
    }
 
+   for (uint32_t i = 0; i < queue->submit_wait_sync_count; i++)
+      vk_sync_destroy(&queue->device->vk, queue->submit_wait_syncs[i]);
+
    pvr_render_ctx_destroy(queue->gfx_ctx);
    pvr_compute_ctx_destroy(queue->query_ctx);
    pvr_compute_ctx_destroy(queue->compute_ctx);
@@ -194,11 +210,24 @@ void pvr_queues_destroy(struct pvr_device *device)
    vk_free(&device->vk.alloc, device->queues);
 }
 
+/* Returns the sync the next job of job_type needs to wait on, if any. */
+static inline struct vk_sync *
+pvr_queue_get_job_wait_sync(const struct pvr_queue *queue,
+                            enum pvr_job_type job_type)
+{
+   if (queue->next_job_wait_sync[job_type])
+      return queue->next_job_wait_sync[job_type];
+
+   return queue->submit_wait_sync[job_type];
+}
+
 static void pvr_update_job_syncs(struct pvr_device *device,
                                  struct pvr_queue *queue,
                                  struct vk_sync *new_signal_sync,
                                  enum pvr_job_type submitted_job_type)
 {
+   queue->submit_wait_sync[submitted_job_type] = NULL;
+
    if (queue->next_job_wait_sync[submitted_job_type]) {
       vk_sync_destroy(&device->vk,
                       queue->next_job_wait_sync[submitted_job_type]);
@@ -263,7 +292,8 @@ static VkResult pvr_process_graphics_cmd(struct pvr_device *device,
       result =
          pvr_render_job_submit(queue->gfx_ctx,
                                &sub_cmd->job,
-                               queue->next_job_wait_sync[PVR_JOB_TYPE_GEOM],
+                               pvr_queue_get_job_wait_sync(queue,
+                                                           PVR_JOB_TYPE_GEOM),
                                NULL,
                                NULL,
                                NULL);
@@ -284,12 +314,13 @@ static VkResult pvr_process_graphics_cmd(struct pvr_device *device,
          sub_cmd->terminate_ctrl_stream->vma->dev_addr;
    }
 
-   result = pvr_render_job_submit(queue->gfx_ctx,
-                                  &sub_cmd->job,
-                                  queue->next_job_wait_sync[PVR_JOB_TYPE_GEOM],
-                                  queue->next_job_wait_sync[PVR_JOB_TYPE_FRAG],
-                                  geom_signal_sync,
-                                  frag_signal_sync);
+   result = pvr_render_job_submit(
+      queue->gfx_ctx,
+      &sub_cmd->job,
+      pvr_queue_get_job_wait_sync(queue, PVR_JOB_TYPE_GEOM),
+      pvr_queue_get_job_wait_sync(queue, PVR_JOB_TYPE_FRAG),
+      geom_signal_sync,
+      frag_signal_sync);
 
    if (original_ctrl_stream_addr.addr > 0)
       sub_cmd->job.ctrl_stream_addr = original_ctrl_stream_addr;
@@ -302,6 +333,8 @@ static VkResult pvr_process_graphics_cmd(struct pvr_device *device,
    if (sub_cmd->job.run_frag)
       pvr_update_job_syncs(device, queue, frag_signal_sync, PVR_JOB_TYPE_FRAG);
 
+   pvr_device_free_list_note_render(device, sub_cmd);
+
    /* FIXME: DoShadowLoadOrStore() */
 
    return VK_SUCCESS;
@@ -330,11 +363,11 @@ static VkResult pvr_process_compute_cmd(struct pvr_device *device,
    if (result != VK_SUCCESS)
       return result;
 
-   result =
-      pvr_compute_job_submit(queue->compute_ctx,
-                             sub_cmd,
-                             queue->next_job_wait_sync[PVR_JOB_TYPE_COMPUTE],
-                             sync);
+   result = pvr_compute_job_submit(
+      queue->compute_ctx,
+      sub_cmd,
+      pvr_queue_get_job_wait_sync(queue, PVR_JOB_TYPE_COMPUTE),
+      sync);
    if (result != VK_SUCCESS) {
       vk_sync_destroy(&device->vk, sync);
       return result;
@@ -360,11 +393,11 @@ static VkResult pvr_process_transfer_cmds(struct pvr_device *device,
    if (result != VK_SUCCESS)
       return result;
 
-   result =
-      pvr_transfer_job_submit(queue->transfer_ctx,
-                              sub_cmd,
-                              queue->next_job_wait_sync[PVR_JOB_TYPE_TRANSFER],
-                              sync);
+   result = pvr_transfer_job_submit(
+      queue->transfer_ctx,
+      sub_cmd,
+      pvr_queue_get_job_wait_sync(queue, PVR_JOB_TYPE_TRANSFER),
+      sync);
    if (result != VK_SUCCESS) {
       vk_sync_destroy(&device->vk, sync);
       return result;
@@ -375,6 +408,125 @@ static VkResult pvr_process_transfer_cmds(struct pvr_device *device,
    return result;
 }
 
+/* Returns the CPU address of a buffer's or image's contents, or NULL if the
+ * memory it's bound to isn't currently mapped.
+ */
+static void *pvr_vma_get_map_addr(const struct pvr_winsys_vma *vma,
+                                  VkDeviceSize offset)
+{
+   if (!vma || !vma->bo || !vma->bo->map || vma->bo->is_imported)
+      return NULL;
+
+   return (uint8_t *)vma->bo->map + vma->bo_offset + offset;
+}
+
+static bool
+pvr_transfer_cmd_get_cpu_addrs(const struct pvr_transfer_cmd *transfer_cmd,
+                               const void **const src_out,
+                               void **const dst_out)
+{
+   const struct pvr_transfer_cmd_cpu *cpu = &transfer_cmd->cpu;
+
+   if (!cpu->enabled)
+      return false;
+
+   if (cpu->dst_image)
+      *dst_out = pvr_vma_get_map_addr(cpu->dst_image->vma, cpu->dst_offset);
+   else
+      *dst_out = pvr_vma_get_map_addr(cpu->dst_buffer->vma, cpu->dst_offset);
+
+   if (!*dst_out)
+      return false;
+
+   if (cpu->is_fill) {
+      *src_out = NULL;
+   } else if (cpu->src_map) {
+      *src_out = cpu->src_map;
+   } else {
+      *src_out = pvr_vma_get_map_addr(cpu->src_buffer->vma, cpu->src_offset);
+      if (!*src_out)
+         return false;
+   }
+
+   return true;
+}
+
+static void
+pvr_copy_buffer_to_image_on_cpu(const struct pvr_transfer_cmd_cpu *cpu,
+                                const void *src,
+                                void *dst)
+{
+   const struct pvr_twiddle_region *region = &cpu->region;
+
+   if (cpu->dst_twiddled) {
+      struct pvr_twiddle_layout layout;
+
+      pvr_twiddle_layout_init(&layout, cpu->dst_width, cpu->dst_height, 1);
+      pvr_twiddle_store(&layout, region, dst, src);
+
+      return;
+   }
+
+   for (uint32_t y = 0; y < region->height; y++) {
+      memcpy((uint8_t *)dst + (region->y + y) * cpu->dst_row_pitch +
+                region->x * region->cpp,
+             (const uint8_t *)src + y * region->row_pitch,
+             region->width * region->cpp);
+   }
+}
+
+/* Performs a transfer sub command with the CPU if all its transfers are small
+ * buffer copies or fills, or buffer to image copies, into currently mapped
+ * memory. All memory is host coherent so no flushing is needed.
+ *
+ * The caller must make sure that no GPU work the transfers depend on is still
+ * pending.
+ */
+static bool
+pvr_process_transfer_cmds_on_cpu(struct pvr_queue *queue,
+                                 struct pvr_sub_cmd_transfer *sub_cmd)
+{
+   VkDeviceSize bytes = 0;
+
+   list_for_each_entry (struct pvr_transfer_cmd,
+                        transfer_cmd,
+                        sub_cmd->transfer_cmds,
+                        link) {
+      const void *src;
+      void *dst;
+
+      if (!pvr_transfer_cmd_get_cpu_addrs(transfer_cmd, &src, &dst))
+         return false;
+   }
+
+   list_for_each_entry (struct pvr_transfer_cmd,
+                        transfer_cmd,
+                        sub_cmd->transfer_cmds,
+                        link) {
+      const struct pvr_transfer_cmd_cpu *cpu = &transfer_cmd->cpu;
+      const void *src;
+      void *dst;
+
+      pvr_transfer_cmd_get_cpu_addrs(transfer_cmd, &src, &dst);
+
+      if (cpu->is_fill) {
+         for (VkDeviceSize i = 0; i < cpu->size; i += 4U)
+            memcpy((uint8_t *)dst + i, &cpu->fill_data, 4U);
+      } else if (cpu->dst_image) {
+         pvr_copy_buffer_to_image_on_cpu(cpu, src, dst);
+      } else {
+         memcpy(dst, src, cpu->size);
+      }
+
+      bytes += cpu->size;
+   }
+
+   queue->cpu_transfer_sub_cmd_count++;
+   queue->cpu_transfer_bytes += bytes;
+
+   return true;
+}
+
 static VkResult
 pvr_process_occlusion_query_cmd(struct pvr_device *device,
                                 struct pvr_queue *queue,
@@ -400,7 +552,7 @@ pvr_process_occlusion_query_cmd(struct pvr_device *device,
    result = pvr_compute_job_submit(
       queue->query_ctx,
       sub_cmd,
-      queue->next_job_wait_sync[PVR_JOB_TYPE_OCCLUSION_QUERY],
+      pvr_queue_get_job_wait_sync(queue, PVR_JOB_TYPE_OCCLUSION_QUERY),
       sync);
    if (result != VK_SUCCESS) {
       vk_sync_destroy(&device->vk, sync);
@@ -461,9 +613,9 @@ pvr_process_event_cmd_barrier(struct pvr_device *device,
          .signal_value = 0,
       };
 
-      if (queue->next_job_wait_sync[stage]) {
+      if (pvr_queue_get_job_wait_sync(queue, stage)) {
          wait_syncs[wait_count++] = (struct vk_sync_wait){
-            .sync = queue->next_job_wait_sync[stage],
+            .sync = pvr_queue_get_job_wait_sync(queue, stage),
             .stage_mask = ~(VkPipelineStageFlags2)0,
             .wait_value = 0,
          };
@@ -482,6 +634,7 @@ pvr_process_event_cmd_barrier(struct pvr_device *device,
          vk_sync_destroy(&device->vk, queue->next_job_wait_sync[stage]);
 
       queue->next_job_wait_sync[stage] = signal_sync;
+      queue->submit_wait_sync[stage] = NULL;
    }
 
    return VK_SUCCESS;
@@ -617,9 +770,9 @@ pvr_process_event_cmd_wait(struct pvr_device *device,
       if (!wait_count)
          continue;
 
-      if (queue->next_job_wait_sync[stage]) {
+      if (pvr_queue_get_job_wait_sync(queue, stage)) {
          waits[wait_count++] = (struct vk_sync_wait){
-            .sync = queue->next_job_wait_sync[stage],
+            .sync = pvr_queue_get_job_wait_sync(queue, stage),
             .stage_mask = ~(VkPipelineStageFlags2)0,
             .wait_value = 0,
          };
@@ -654,6 +807,7 @@ pvr_process_event_cmd_wait(struct pvr_device *device,
          vk_sync_destroy(&device->vk, queue->next_job_wait_sync[stage]);
 
       queue->next_job_wait_sync[stage] = signal.sync;
+      queue->submit_wait_sync[stage] = NULL;
    }
 
    STACK_ARRAY_FINISH(waits);
@@ -684,9 +838,15 @@ static VkResult pvr_process_event_cmd(struct pvr_device *device,
    };
 }
 
+/* gpu_idle_inout tracks whether any GPU work has been submitted yet as part of
+ * the current queue submission. Since all previous submissions are waited on
+ * before processing a new one, transfers can be done with the CPU while it's
+ * still true and nothing is waiting on a semaphore before the transfer stage.
+ */
 static VkResult pvr_process_cmd_buffer(struct pvr_device *device,
                                        struct pvr_queue *queue,
-                                       struct pvr_cmd_buffer *cmd_buffer)
+                                       struct pvr_cmd_buffer *cmd_buffer,
+                                       bool *const gpu_idle_inout)
 {
    VkResult result;
 
@@ -694,6 +854,15 @@ static VkResult pvr_process_cmd_buffer(struct pvr_device *device,
                              sub_cmd,
                              &cmd_buffer->sub_cmds,
                              link) {
+      if (sub_cmd->type == PVR_SUB_CMD_TYPE_TRANSFER && *gpu_idle_inout &&
+          !pvr_queue_get_job_wait_sync(queue, PVR_JOB_TYPE_TRANSFER) &&
+          !sub_cmd->transfer.serialize_with_frag &&
+          pvr_process_transfer_cmds_on_cpu(queue, &sub_cmd->transfer)) {
+         continue;
+      }
+
+      *gpu_idle_inout = false;
+
       switch (sub_cmd->type) {
       case PVR_SUB_CMD_TYPE_GRAPHICS: {
          /* If the fragment job utilizes occlusion queries, for data integrity
@@ -786,10 +955,18 @@ static VkResult pvr_process_cmd_buffer(struct pvr_device *device,
 
 static VkResult pvr_clear_last_submits_syncs(struct pvr_queue *queue)
 {
-   struct vk_sync_wait waits[PVR_JOB_TYPE_MAX * 2];
+   struct vk_sync_wait waits[PVR_JOB_TYPE_MAX * 3 + 1];
    uint32_t wait_count = 0;
    VkResult result;
 
+   for (uint32_t i = 0; i < queue->submit_wait_sync_count; i++) {
+      waits[wait_count++] = (struct vk_sync_wait){
+         .sync = queue->submit_wait_syncs[i],
+         .stage_mask = ~(VkPipelineStageFlags2)0,
+         .wait_value = 0,
+      };
+   }
+
    for (uint32_t i = 0; i < PVR_JOB_TYPE_MAX; i++) {
       if (queue->next_job_wait_sync[i]) {
          waits[wait_count++] = (struct vk_sync_wait){
@@ -817,6 +994,12 @@ static VkResult pvr_clear_last_submits_syncs(struct pvr_queue *queue)
    if (result != VK_SUCCESS)
       return vk_error(queue, result);
 
+   for (uint32_t i = 0; i < queue->submit_wait_sync_count; i++)
+      vk_sync_destroy(&queue->device->vk, queue->submit_wait_syncs[i]);
+
+   queue->submit_wait_sync_count = 0;
+   memset(queue->submit_wait_sync, 0, sizeof(queue->submit_wait_sync));
+
    for (uint32_t i = 0; i < PVR_JOB_TYPE_MAX; i++) {
       if (queue->next_job_wait_sync[i]) {
          vk_sync_destroy(&queue->device->vk, queue->next_job_wait_sync[i]);
@@ -832,69 +1015,148 @@ static VkResult pvr_clear_last_submits_syncs(struct pvr_queue *queue)
    return VK_SUCCESS;
 }
 
-static VkResult pvr_process_queue_signals(struct pvr_queue *queue,
-                                          struct vk_sync_signal *signals,
-                                          uint32_t signal_count)
+/* Returns the mask of job types the command buffers will submit jobs for. The
+ * submission's semaphore waits only need to be applied to those, see
+ * pvr_process_queue_waits().
+ */
+static uint32_t pvr_submit_get_job_types(const struct vk_queue_submit *submit)
+{
+   uint32_t job_types = 0;
+
+   for (uint32_t i = 0U; i < submit->command_buffer_count; i++) {
+      const struct pvr_cmd_buffer *cmd_buffer =
+         container_of(submit->command_buffers[i], struct pvr_cmd_buffer, vk);
+
+      list_for_each_entry (struct pvr_sub_cmd,
+                           sub_cmd,
+                           &cmd_buffer->sub_cmds,
+                           link) {
+         switch (sub_cmd->type) {
+         case PVR_SUB_CMD_TYPE_GRAPHICS:
+            job_types |= BITFIELD_BIT(PVR_JOB_TYPE_GEOM) |
+                         BITFIELD_BIT(PVR_JOB_TYPE_FRAG);
+            break;
+
+         case PVR_SUB_CMD_TYPE_COMPUTE:
+            job_types |= BITFIELD_BIT(PVR_JOB_TYPE_COMPUTE);
+            break;
+
+         case PVR_SUB_CMD_TYPE_TRANSFER:
+            job_types |= BITFIELD_BIT(PVR_JOB_TYPE_TRANSFER);
+            break;
+
+         case PVR_SUB_CMD_TYPE_OCCLUSION_QUERY:
+            job_types |= BITFIELD_BIT(PVR_JOB_TYPE_OCCLUSION_QUERY);
+            break;
+
+         default:
+            break;
+         }
+      }
+   }
+
+   return job_types;
+}
+
+/* Submits a null job waiting on the given semaphore waits, signalling a new
+ * sync owned by the queue until the next submission.
+ */
+static VkResult pvr_queue_submit_wait_null_job(struct pvr_queue *queue,
+                                               struct vk_sync_wait *waits,
+                                               uint32_t wait_count,
+                                               struct vk_sync **const sync_out)
 {
-   struct vk_sync_wait signal_waits[PVR_JOB_TYPE_MAX];
    struct pvr_device *device = queue->device;
+   struct vk_sync_signal signal;
+   struct vk_sync *sync;
    VkResult result;
 
-   for (uint32_t signal_idx = 0; signal_idx < signal_count; signal_idx++) {
-      struct vk_sync_signal *signal = &signals[signal_idx];
-      const enum pvr_pipeline_stage_bits signal_stage_src =
-         pvr_stage_mask_src(signal->stage_mask);
-      uint32_t wait_count = 0;
-
-      for (uint32_t i = 0; i < PVR_JOB_TYPE_MAX; i++) {
-         /* Exception for occlusion query jobs since that's something internal,
-          * so the user provided syncs won't ever have it as a source stage.
-          */
-         if (!(signal_stage_src & BITFIELD_BIT(i)) &&
-             i != PVR_JOB_TYPE_OCCLUSION_QUERY)
-            continue;
+   assert(queue->submit_wait_sync_count <
+          ARRAY_SIZE(queue->submit_wait_syncs));
 
-         if (!queue->last_job_signal_sync[i])
-            continue;
+   result = vk_sync_create(&device->vk,
+                           &device->pdevice->ws->syncobj_type,
+                           0U,
+                           0UL,
+                           &sync);
+   if (result != VK_SUCCESS)
+      return result;
 
-         signal_waits[wait_count++] = (struct vk_sync_wait){
-            .sync = queue->last_job_signal_sync[i],
-            .stage_mask = ~(VkPipelineStageFlags2)0,
-            .wait_value = 0,
-         };
-      }
+   signal = (struct vk_sync_signal){
+      .sync = sync,
+      .stage_mask = ~(VkPipelineStageFlags2)0,
+      .signal_value = 0,
+   };
 
-      result = device->ws->ops->null_job_submit(device->ws,
-                                                signal_waits,
-                                                wait_count,
-                                                signal);
-      if (result != VK_SUCCESS)
-         return result;
+   result =
+      device->ws->ops->null_job_submit(device->ws, waits, wait_count, &signal);
+   if (result != VK_SUCCESS) {
+      vk_sync_destroy(&device->vk, sync);
+      return result;
    }
 
+   queue->submit_wait_syncs[queue->submit_wait_sync_count++] = sync;
+   *sync_out = sync;
+
    return VK_SUCCESS;
 }
 
+/* Makes the first job of each type the submission uses wait on the semaphore
+ * waits with a matching dst stage. The wait is carried by that job through
+ * submit_wait_sync[type], and types waiting on exactly the same semaphores
+ * share a single null job. Waits with no job to apply to are gathered in one
+ * more null job. All of these are waited on by the semaphore signals and by
+ * the next submission, see pvr_clear_last_submits_syncs().
+ */
 static VkResult pvr_process_queue_waits(struct pvr_queue *queue,
-                                        struct vk_sync_wait *waits,
-                                        uint32_t wait_count)
+                                        const struct vk_sync_wait *waits,
+                                        uint32_t wait_count,
+                                        uint32_t job_types)
 {
-   struct pvr_device *device = queue->device;
+   uint32_t used_wait_count = 0;
    VkResult result;
 
    STACK_ARRAY(struct vk_sync_wait, stage_waits, wait_count);
-   if (!stage_waits)
-      return vk_error(queue, VK_ERROR_OUT_OF_HOST_MEMORY);
+   STACK_ARRAY(uint32_t, dst_masks, wait_count);
+   if (!stage_waits || !dst_masks) {
+      result = vk_error(queue, VK_ERROR_OUT_OF_HOST_MEMORY);
+      goto out_free_arrays;
+   }
 
-   for (uint32_t i = 0; i < PVR_JOB_TYPE_MAX; i++) {
-      struct vk_sync_signal next_job_wait_signal_sync;
+   for (uint32_t wait_idx = 0; wait_idx < wait_count; wait_idx++) {
+      dst_masks[wait_idx] =
+         pvr_stage_mask_dst(waits[wait_idx].stage_mask) & job_types;
+
+      if (dst_masks[wait_idx])
+         used_wait_count++;
+   }
+
+   u_foreach_bit (i, job_types) {
       uint32_t stage_wait_count = 0;
 
+      /* Share the null job of an earlier type waiting on the same semaphores.
+       */
+      for (uint32_t j = 0; j < i; j++) {
+         bool same_waits = !!queue->submit_wait_sync[j];
+
+         for (uint32_t wait_idx = 0; same_waits && wait_idx < wait_count;
+              wait_idx++) {
+            same_waits = !(dst_masks[wait_idx] & BITFIELD_BIT(i)) ==
+                         !(dst_masks[wait_idx] & BITFIELD_BIT(j));
+         }
+
+         if (same_waits) {
+            queue->submit_wait_sync[i] = queue->submit_wait_sync[j];
+            break;
+         }
+      }
+
+      if (queue->submit_wait_sync[i])
+         continue;
+
       for (uint32_t wait_idx = 0; wait_idx < wait_count; wait_idx++) {
-         if (!(pvr_stage_mask_dst(waits[wait_idx].stage_mask) &
-               BITFIELD_BIT(i))) {
+         if (!(dst_masks[wait_idx] & BITFIELD_BIT(i)))
             continue;
-         }
 
          stage_waits[stage_wait_count++] = (struct vk_sync_wait){
             .sync = waits[wait_idx].sync,
@@ -906,43 +1168,135 @@ static VkResult pvr_process_queue_waits(struct pvr_queue *queue,
       if (!stage_wait_count)
          continue;
 
-      result = vk_sync_create(&device->vk,
-                              &device->pdevice->ws->syncobj_type,
-                              0U,
-                              0UL,
-                              &queue->next_job_wait_sync[i]);
+      result = pvr_queue_submit_wait_null_job(queue,
+                                              stage_waits,
+                                              stage_wait_count,
+                                              &queue->submit_wait_sync[i]);
       if (result != VK_SUCCESS)
-         goto err_free_waits;
+         goto out_free_arrays;
+   }
 
-      next_job_wait_signal_sync = (struct vk_sync_signal){
-         .sync = queue->next_job_wait_sync[i],
-         .stage_mask = ~(VkPipelineStageFlags2)0,
-         .signal_value = 0,
-      };
+   if (used_wait_count < wait_count) {
+      uint32_t stage_wait_count = 0;
+      struct vk_sync *sync;
 
-      result = device->ws->ops->null_job_submit(device->ws,
-                                                stage_waits,
-                                                stage_wait_count,
-                                                &next_job_wait_signal_sync);
+      for (uint32_t wait_idx = 0; wait_idx < wait_count; wait_idx++) {
+         if (dst_masks[wait_idx])
+            continue;
+
+         stage_waits[stage_wait_count++] = (struct vk_sync_wait){
+            .sync = waits[wait_idx].sync,
+            .stage_mask = ~(VkPipelineStageFlags2)0,
+            .wait_value = waits[wait_idx].wait_value,
+         };
+      }
+
+      result = pvr_queue_submit_wait_null_job(queue,
+                                              stage_waits,
+                                              stage_wait_count,
+                                              &sync);
       if (result != VK_SUCCESS)
-         goto err_free_waits;
+         goto out_free_arrays;
    }
 
-   STACK_ARRAY_FINISH(stage_waits);
-
-   return VK_SUCCESS;
+   result = VK_SUCCESS;
 
-err_free_waits:
+out_free_arrays:
+   STACK_ARRAY_FINISH(dst_masks);
    STACK_ARRAY_FINISH(stage_waits);
 
    return result;
 }
 
+static uint32_t
+pvr_queue_get_signal_waits(const struct pvr_queue *queue,
+                           const enum pvr_pipeline_stage_bits signal_stage_src,
+                           struct vk_sync_wait *signal_waits)
+{
+   uint32_t signal_wait_count = 0;
+
+   for (uint32_t i = 0; i < PVR_JOB_TYPE_MAX; i++) {
+      /* Exception for occlusion query jobs since that's something internal,
+       * so the user provided syncs won't ever have it as a source stage.
+       */
+      if (!(signal_stage_src & BITFIELD_BIT(i)) &&
+          i != PVR_JOB_TYPE_OCCLUSION_QUERY)
+         continue;
+
+      if (!queue->last_job_signal_sync[i])
+         continue;
+
+      signal_waits[signal_wait_count++] = (struct vk_sync_wait){
+         .sync = queue->last_job_signal_sync[i],
+         .stage_mask = ~(VkPipelineStageFlags2)0,
+         .wait_value = 0,
+      };
+   }
+
+   for (uint32_t i = 0; i < queue->submit_wait_sync_count; i++) {
+      signal_waits[signal_wait_count++] = (struct vk_sync_wait){
+         .sync = queue->submit_wait_syncs[i],
+         .stage_mask = ~(VkPipelineStageFlags2)0,
+         .wait_value = 0,
+      };
+   }
+
+   return signal_wait_count;
+}
+
+/* Signals are submitted after all the jobs and wait on the last job of each
+ * type in their src stages, as well as on the null jobs carrying the semaphore
+ * waits so none of them is skipped. Signals with the same src stages as the
+ * previous one only wait on that signal, unless it's a dummy one.
+ */
+static VkResult pvr_process_queue_signals(struct pvr_queue *queue,
+                                          struct vk_sync_signal *signals,
+                                          uint32_t signal_count)
+{
+   struct pvr_device *device = queue->device;
+   struct vk_sync_wait signal_waits[PVR_JOB_TYPE_MAX * 2 + 1];
+   uint32_t prev_signal_stage_src = 0;
+
+   for (uint32_t signal_idx = 0; signal_idx < signal_count; signal_idx++) {
+      struct vk_sync_signal *signal = &signals[signal_idx];
+      const enum pvr_pipeline_stage_bits signal_stage_src =
+         pvr_stage_mask_src(signal->stage_mask);
+      uint32_t signal_wait_count = 0;
+      VkResult result;
+
+      if (signal_idx > 0 && signal_stage_src == prev_signal_stage_src &&
+          !vk_sync_type_is_dummy(signals[signal_idx - 1].sync->type)) {
+         const struct vk_sync_signal *prev_signal = &signals[signal_idx - 1];
+
+         signal_waits[signal_wait_count++] = (struct vk_sync_wait){
+            .sync = prev_signal->sync,
+            .stage_mask = ~(VkPipelineStageFlags2)0,
+            .wait_value = prev_signal->signal_value,
+         };
+      } else {
+         signal_wait_count =
+            pvr_queue_get_signal_waits(queue, signal_stage_src, signal_waits);
+      }
+
+      result = device->ws->ops->null_job_submit(device->ws,
+                                                signal_waits,
+                                                signal_wait_count,
+                                                signal);
+      if (result != VK_SUCCESS)
+         return result;
+
+      prev_signal_stage_src = signal_stage_src;
+   }
+
+   return VK_SUCCESS;
+}
+
 static VkResult pvr_driver_queue_submit(struct vk_queue *queue,
                                         struct vk_queue_submit *submit)
 {
    struct pvr_queue *driver_queue = container_of(queue, struct pvr_queue, vk);
    struct pvr_device *device = driver_queue->device;
+   bool gpu_idle = true;
    VkResult result;
 
    result = pvr_clear_last_submits_syncs(driver_queue);
@@ -952,7 +1306,8 @@ static VkResult pvr_driver_queue_submit(struct vk_queue *queue,
    if (submit->wait_count) {
       result = pvr_process_queue_waits(driver_queue,
                                        submit->waits,
-                                       submit->wait_count);
+                                       submit->wait_count,
+                                       pvr_submit_get_job_types(submit));
       if (result != VK_SUCCESS)
          return result;
    }
@@ -961,16 +1316,13 @@ static VkResult pvr_driver_queue_submit(struct vk_queue *queue,
       result = pvr_process_cmd_buffer(
          device,
          driver_queue,
-         container_of(submit->command_buffers[i], struct pvr_cmd_buffer, vk));
+         container_of(submit->command_buffers[i], struct pvr_cmd_buffer, vk),
+         &gpu_idle);
       if (result != VK_SUCCESS)
          return result;
    }
 
-   result = pvr_process_queue_signals(driver_queue,
-                                      submit->signals,
-                                      submit->signal_count);
-   if (result != VK_SUCCESS)
-      return result;
-
-   return VK_SUCCESS;
+   return pvr_process_queue_signals(driver_queue,
+                                    submit->signals,
+                                    submit->signal_count);
 }
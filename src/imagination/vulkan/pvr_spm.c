@@ -47,13 +47,17 @@
 #include "util/macros.h"
 #include "util/simple_mtx.h"
 #include "util/u_atomic.h"
+#include "util/u_math.h"
 #include "vk_alloc.h"
 #include "vk_log.h"
 
 struct pvr_spm_scratch_buffer {
+   /* Number of framebuffers using the buffer. Protected by the store's mtx. */
    uint32_t ref_count;
    struct pvr_bo *bo;
    uint64_t size;
+
+   uint32_t size_class;
 };
 
 void pvr_spm_init_scratch_buffer_store(struct pvr_device *device)
@@ -62,7 +66,15 @@ void pvr_spm_init_scratch_buffer_store(struct pvr_device *device)
       &device->spm_scratch_buffer_store;
 
    simple_mtx_init(&store->mtx, mtx_plain);
-   store->head_ref = NULL;
+   memset(store->buffers, 0, sizeof(store->buffers));
+   store->idle_buffer = NULL;
+}
+
+static void pvr_spm_scratch_buffer_free(struct pvr_device *device,
+                                        struct pvr_spm_scratch_buffer *buffer)
+{
+   pvr_bo_free(device, buffer->bo);
+   vk_free(&device->vk.alloc, buffer);
 }
 
 void pvr_spm_finish_scratch_buffer_store(struct pvr_device *device)
@@ -70,18 +82,14 @@ void pvr_spm_finish_scratch_buffer_store(struct pvr_device *device)
    struct pvr_spm_scratch_buffer_store *store =
       &device->spm_scratch_buffer_store;
 
-   /* Either a framebuffer was never created so no scratch buffer was ever
-    * created or all framebuffers have been freed so only the store's reference
-    * remains.
-    */
-   assert(!store->head_ref || p_atomic_read(&store->head_ref->ref_count) == 1);
-
    simple_mtx_destroy(&store->mtx);
 
-   if (store->head_ref) {
-      pvr_bo_free(device, store->head_ref->bo);
-      vk_free(&device->vk.alloc, store->head_ref);
-   }
+   /* All framebuffers have been freed so only the idle buffer can remain. */
+   for (uint32_t i = 0; i < ARRAY_SIZE(store->buffers); i++)
+      assert(!store->buffers[i] || store->buffers[i] == store->idle_buffer);
+
+   if (store->idle_buffer)
+      pvr_spm_scratch_buffer_free(device, store->idle_buffer);
 }
 
 uint64_t
@@ -117,13 +125,69 @@ pvr_spm_scratch_buffer_calc_required_size(const struct pvr_render_pass *pass,
    return buffer_size;
 }
 
+static uint32_t pvr_spm_scratch_buffer_size_class(uint64_t size)
+{
+   const uint32_t fine_class_base = PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_LOG2 -
+                                    PVR_SPM_SCRATCH_BUFFER_MIN_CLASS_LOG2;
+   const uint32_t size_log2 = util_logbase2_ceil64(size);
+   uint32_t octave_log2;
+   uint32_t step;
+
+   if (size_log2 <= PVR_SPM_SCRATCH_BUFFER_MIN_CLASS_LOG2)
+      return 0;
+
+   if (size_log2 <= PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_LOG2)
+      return size_log2 - PVR_SPM_SCRATCH_BUFFER_MIN_CLASS_LOG2;
+
+   /* 1 << octave_log2 < size <= 2 << octave_log2, split into steps of
+    * (1 << octave_log2) / PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_STEPS.
+    */
+   octave_log2 = size_log2 - 1U;
+   step = DIV_ROUND_UP(size * PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_STEPS,
+                       BITFIELD64_BIT(octave_log2)) -
+          PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_STEPS;
+   assert(step >= 1U && step <= PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_STEPS);
+
+   assert(octave_log2 < PVR_SPM_SCRATCH_BUFFER_MAX_CLASS_LOG2);
+
+   return fine_class_base +
+          (octave_log2 - PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_LOG2) *
+             PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_STEPS +
+          step;
+}
+
+static uint64_t pvr_spm_scratch_buffer_class_size(uint32_t size_class)
+{
+   const uint32_t fine_class_base = PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_LOG2 -
+                                    PVR_SPM_SCRATCH_BUFFER_MIN_CLASS_LOG2;
+   uint32_t octave_log2;
+   uint32_t step;
+
+   assert(size_class < PVR_SPM_SCRATCH_BUFFER_CLASS_COUNT);
+
+   if (size_class <= fine_class_base)
+      return BITFIELD64_BIT(PVR_SPM_SCRATCH_BUFFER_MIN_CLASS_LOG2 + size_class);
+
+   octave_log2 = PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_LOG2 +
+                 (size_class - fine_class_base - 1U) /
+                    PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_STEPS;
+   step = (size_class - fine_class_base - 1U) %
+             PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_STEPS +
+          1U;
+
+   return BITFIELD64_BIT(octave_log2) /
+          PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_STEPS *
+          (PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_STEPS + step);
+}
+
 static VkResult
 pvr_spm_scratch_buffer_alloc(struct pvr_device *device,
-                             uint64_t size,
+                             uint32_t size_class,
                              struct pvr_spm_scratch_buffer **const buffer_out)
 {
    const uint32_t cache_line_size =
       rogue_get_slc_cache_line_size(&device->pdevice->dev_info);
+   const uint64_t size = pvr_spm_scratch_buffer_class_size(size_class);
    struct pvr_spm_scratch_buffer *scratch_buffer;
    struct pvr_bo *bo;
    VkResult result;
@@ -141,8 +205,8 @@ pvr_spm_scratch_buffer_alloc(struct pvr_device *device,
 
    scratch_buffer = vk_alloc(&device->vk.alloc,
                              sizeof(*scratch_buffer),
-                             4,
-                             VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+                             8,
+                             VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
    if (!scratch_buffer) {
       pvr_bo_free(device, bo);
       *buffer_out = NULL;
@@ -152,6 +216,7 @@ pvr_spm_scratch_buffer_alloc(struct pvr_device *device,
    *scratch_buffer = (struct pvr_spm_scratch_buffer){
       .bo = bo,
       .size = size,
+      .size_class = size_class,
    };
 
    *buffer_out = scratch_buffer;
@@ -159,54 +224,34 @@ pvr_spm_scratch_buffer_alloc(struct pvr_device *device,
    return VK_SUCCESS;
 }
 
-static void
-pvr_spm_scratch_buffer_release_locked(struct pvr_device *device,
-                                      struct pvr_spm_scratch_buffer *buffer)
-{
-   struct pvr_spm_scratch_buffer_store *store =
-      &device->spm_scratch_buffer_store;
-
-   simple_mtx_assert_locked(&store->mtx);
-
-   if (p_atomic_dec_zero(&buffer->ref_count)) {
-      pvr_bo_free(device, buffer->bo);
-      vk_free(&device->vk.alloc, buffer);
-   }
-}
-
 void pvr_spm_scratch_buffer_release(struct pvr_device *device,
                                     struct pvr_spm_scratch_buffer *buffer)
 {
    struct pvr_spm_scratch_buffer_store *store =
       &device->spm_scratch_buffer_store;
+   struct pvr_spm_scratch_buffer *prev_idle_buffer = NULL;
 
    simple_mtx_lock(&store->mtx);
 
-   pvr_spm_scratch_buffer_release_locked(device, buffer);
+   assert(store->buffers[buffer->size_class] == buffer);
+   assert(buffer->ref_count > 0);
 
-   simple_mtx_unlock(&store->mtx);
-}
-
-static void pvr_spm_scratch_buffer_store_set_head_ref_locked(
-   struct pvr_spm_scratch_buffer_store *store,
-   struct pvr_spm_scratch_buffer *buffer)
-{
-   simple_mtx_assert_locked(&store->mtx);
-   assert(!store->head_ref);
-
-   p_atomic_inc(&buffer->ref_count);
-   store->head_ref = buffer;
-}
+   /* Keep the most recently released buffer for a framebuffer of the same
+    * size class being created next, e.g. when they're recreated every frame,
+    * and free the one kept before it.
+    */
+   if (--buffer->ref_count == 0) {
+      prev_idle_buffer = store->idle_buffer;
+      store->idle_buffer = buffer;
 
-static void pvr_spm_scratch_buffer_store_release_head_ref_locked(
-   struct pvr_device *device,
-   struct pvr_spm_scratch_buffer_store *store)
-{
-   simple_mtx_assert_locked(&store->mtx);
+      if (prev_idle_buffer)
+         store->buffers[prev_idle_buffer->size_class] = NULL;
+   }
 
-   pvr_spm_scratch_buffer_release_locked(device, store->head_ref);
+   simple_mtx_unlock(&store->mtx);
 
-   store->head_ref = NULL;
+   if (prev_idle_buffer)
+      pvr_spm_scratch_buffer_free(device, prev_idle_buffer);
 }
 
 VkResult pvr_spm_scratch_buffer_get_buffer(
@@ -216,6 +261,7 @@ VkResult pvr_spm_scratch_buffer_get_buffer(
 {
    struct pvr_spm_scratch_buffer_store *store =
       &device->spm_scratch_buffer_store;
+   const uint32_t size_class = pvr_spm_scratch_buffer_size_class(size);
    struct pvr_spm_scratch_buffer *buffer;
 
    simple_mtx_lock(&store->mtx);
@@ -226,16 +272,16 @@ VkResult pvr_spm_scratch_buffer_get_buffer(
     * Thus we can safely use the same scratch buffer across multiple
     * framebuffers as the scratch buffer is only used during PRs and only one PR
     * can ever be executed at any one time.
+    *
+    * Framebuffers only share buffers within a size class, so alternating
+    * between framebuffer sizes doesn't reallocate and a buffer is reclaimed
+    * once the framebuffers of its class are gone.
     */
-   if (store->head_ref && store->head_ref->size <= size) {
-      buffer = store->head_ref;
-   } else {
+   buffer = store->buffers[size_class];
+   if (!buffer) {
       VkResult result;
 
-      if (store->head_ref)
-         pvr_spm_scratch_buffer_store_release_head_ref_locked(device, store);
-
-      result = pvr_spm_scratch_buffer_alloc(device, size, &buffer);
+      result = pvr_spm_scratch_buffer_alloc(device, size_class, &buffer);
       if (result != VK_SUCCESS) {
          simple_mtx_unlock(&store->mtx);
          *buffer_out = NULL;
@@ -243,10 +289,16 @@ VkResult pvr_spm_scratch_buffer_get_buffer(
          return result;
       }
 
-      pvr_spm_scratch_buffer_store_set_head_ref_locked(store, buffer);
+      store->buffers[size_class] = buffer;
    }
 
-   p_atomic_inc(&buffer->ref_count);
+   assert(buffer->size >= size);
+
+   if (buffer == store->idle_buffer)
+      store->idle_buffer = NULL;
+
+   buffer->ref_count++;
+
    simple_mtx_unlock(&store->mtx);
    *buffer_out = buffer;
 
@@ -53,9 +53,36 @@ struct pvr_render_pass;
 struct pvr_renderpass_hwsetup_render;
 struct pvr_spm_scratch_buffer;
 
+/* Scratch buffers are pooled in size classes, starting at
+ * 1 << PVR_SPM_SCRATCH_BUFFER_MIN_CLASS_LOG2 bytes. Classes are powers of two
+ * up to 1 << PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_LOG2 bytes and a quarter of an
+ * octave apart above that, so that large buffers are over-allocated by at most
+ * 25% rather than up to 100%.
+ */
+#define PVR_SPM_SCRATCH_BUFFER_MIN_CLASS_LOG2 16U
+#define PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_LOG2 24U
+#define PVR_SPM_SCRATCH_BUFFER_MAX_CLASS_LOG2 40U
+#define PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_STEPS 4U
+#define PVR_SPM_SCRATCH_BUFFER_CLASS_COUNT                                 \
+   (PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_LOG2 -                               \
+    PVR_SPM_SCRATCH_BUFFER_MIN_CLASS_LOG2 + 1U +                           \
+    (PVR_SPM_SCRATCH_BUFFER_MAX_CLASS_LOG2 -                               \
+     PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_LOG2) *                             \
+       PVR_SPM_SCRATCH_BUFFER_FINE_CLASS_STEPS)
+
 struct pvr_spm_scratch_buffer_store {
    simple_mtx_t mtx;
-   struct pvr_spm_scratch_buffer *head_ref;
+
+   /* Lazily allocated buffer of each size class, shared by all framebuffers
+    * in that class. A buffer is freed once the last framebuffer using it
+    * releases it, unless it's the most recently released one.
+    */
+   struct pvr_spm_scratch_buffer *buffers[PVR_SPM_SCRATCH_BUFFER_CLASS_COUNT];
+
+   /* The one buffer kept around with no framebuffer using it, so that
+    * framebuffers recreated every frame don't reallocate it each time.
+    */
+   struct pvr_spm_scratch_buffer *idle_buffer;
 };
 
 struct pvr_spm_eot_state {
@@ -36,11 +36,17 @@
 #include "pvr_transfer_frag_store.h"
 #include "pvr_types.h"
 #include "usc/pvr_uscgen.h"
+#include "util/disk_cache.h"
 #include "util/hash_table.h"
+#include "util/log.h"
 #include "util/macros.h"
+#include "util/mesa-sha1.h"
 #include "util/ralloc.h"
+#include "util/u_atomic.h"
+#include "util/u_debug.h"
 #include "util/u_dynarray.h"
 #include "util/u_math.h"
+#include "util/u_thread.h"
 #include "vk_log.h"
 
 #define PVR_TRANSFER_BYTE_UNWIND_MAX 16U
@@ -58,22 +64,6 @@ struct pvr_transfer_frag_store_entry_data {
             struct hash_entry *: (struct pvr_transfer_frag_store_entry_data *)((_entry)->data), \
             const struct hash_entry *: (const struct pvr_transfer_frag_store_entry_data *)((_entry)->data))
 
-VkResult pvr_transfer_frag_store_init(struct pvr_device *device,
-                                      struct pvr_transfer_frag_store *store)
-{
-   const struct pvr_device_info *dev_info = &device->pdevice->dev_info;
-
-   *store = (struct pvr_transfer_frag_store){
-      .max_multisample = PVR_GET_FEATURE_VALUE(dev_info, max_multisample, 1U),
-      .hash_table = _mesa_hash_table_create_u32_keys(NULL),
-   };
-
-   if (!store->hash_table)
-      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
-
-   return VK_SUCCESS;
-}
-
 /**
  * \brief Returns a key based on shader properties.
  *
@@ -171,8 +161,117 @@ static uint32_t pvr_transfer_frag_shader_key(
 
 #define to_hash_table_key(_key) ((void *)(uintptr_t)(_key))
 
+/* Header of the transfer fragment shader blobs kept in the disk cache. The USC
+ * binary follows it.
+ */
+struct pvr_transfer_frag_cache_blob {
+   uint32_t num_usc_temps;
+   struct pvr_tq_frag_sh_reg_layout sh_reg_layout;
+};
+
+static bool pvr_transfer_frag_store_cache_key(const struct pvr_device *device,
+                                              uint32_t key,
+                                              cache_key cache_key_out)
+{
+   const uint32_t blob_size = sizeof(struct pvr_transfer_frag_cache_blob);
+   struct disk_cache *cache = device->pdevice->vk.disk_cache;
+   const char *const tag = "pvr_transfer_frag";
+   struct mesa_sha1 sha1_ctx;
+
+   if (!cache)
+      return false;
+
+   /* The disk cache is already keyed on the driver build, so the shader key
+    * and the layout of the blob header are enough to identify a shader.
+    */
+   _mesa_sha1_init(&sha1_ctx);
+   _mesa_sha1_update(&sha1_ctx, tag, strlen(tag));
+   _mesa_sha1_update(&sha1_ctx, &key, sizeof(key));
+   _mesa_sha1_update(&sha1_ctx, &blob_size, sizeof(blob_size));
+   _mesa_sha1_final(&sha1_ctx, cache_key_out);
+
+   return true;
+}
+
+static bool pvr_transfer_frag_store_cache_load(
+   struct pvr_device *device,
+   uint32_t key,
+   struct pvr_transfer_frag_store_entry_data *const entry_data,
+   uint32_t *const num_usc_temps_out,
+   struct util_dynarray *const shader_out)
+{
+   struct pvr_transfer_frag_cache_blob blob;
+   cache_key cache_key;
+   size_t size;
+   void *data;
+
+   if (!pvr_transfer_frag_store_cache_key(device, key, cache_key))
+      return false;
+
+   data = disk_cache_get(device->pdevice->vk.disk_cache, cache_key, &size);
+   if (!data)
+      return false;
+
+   if (size <= sizeof(blob)) {
+      free(data);
+      return false;
+   }
+
+   memcpy(&blob, data, sizeof(blob));
+
+   util_dynarray_init(shader_out, NULL);
+   if (!util_dynarray_grow_bytes(shader_out, 1, size - sizeof(blob))) {
+      util_dynarray_fini(shader_out);
+      free(data);
+      return false;
+   }
+
+   memcpy(util_dynarray_begin(shader_out),
+          (uint8_t *)data + sizeof(blob),
+          size - sizeof(blob));
+   free(data);
+
+   entry_data->sh_reg_layout = blob.sh_reg_layout;
+   *num_usc_temps_out = blob.num_usc_temps;
+
+   return true;
+}
+
+static void pvr_transfer_frag_store_cache_store(
+   struct pvr_device *device,
+   uint32_t key,
+   const struct pvr_transfer_frag_store_entry_data *const entry_data,
+   uint32_t num_usc_temps,
+   const struct util_dynarray *const shader)
+{
+   const size_t shader_size = util_dynarray_num_elements(shader, uint8_t);
+   struct pvr_transfer_frag_cache_blob *blob;
+   cache_key cache_key;
+
+   if (!pvr_transfer_frag_store_cache_key(device, key, cache_key))
+      return;
+
+   blob = malloc(sizeof(*blob) + shader_size);
+   if (!blob)
+      return;
+
+   memset(blob, 0, sizeof(*blob));
+   blob->num_usc_temps = num_usc_temps;
+   blob->sh_reg_layout = entry_data->sh_reg_layout;
+   memcpy(blob + 1, util_dynarray_begin(shader), shader_size);
+
+   disk_cache_put(device->pdevice->vk.disk_cache,
+                  cache_key,
+                  blob,
+                  sizeof(*blob) + shader_size,
+                  NULL);
+
+   free(blob);
+}
+
 static VkResult pvr_transfer_frag_store_entry_data_compile(
    struct pvr_device *device,
+   uint32_t key,
    struct pvr_transfer_frag_store_entry_data *const entry_data,
    const struct pvr_tq_shader_properties *shader_props,
    uint32_t *const num_usc_temps_out)
@@ -208,11 +307,26 @@ static VkResult pvr_transfer_frag_store_entry_data_compile(
 
    sh_reg_layout->driver_total = next_free_sh_reg;
 
+   if (pvr_transfer_frag_store_cache_load(device,
+                                          key,
+                                          entry_data,
+                                          num_usc_temps_out,
+                                          &shader)) {
+      goto upload;
+   }
+
    pvr_uscgen_tq_frag(shader_props,
                       &entry_data->sh_reg_layout,
                       num_usc_temps_out,
                       &shader);
 
+   pvr_transfer_frag_store_cache_store(device,
+                                       key,
+                                       entry_data,
+                                       *num_usc_temps_out,
+                                       &shader);
+
+upload:
    result = pvr_gpu_upload_usc(device,
                                util_dynarray_begin(&shader),
                                util_dynarray_num_elements(&shader, uint8_t),
@@ -227,7 +341,7 @@ static VkResult pvr_transfer_frag_store_entry_data_compile(
 
 static VkResult pvr_transfer_frag_store_entry_data_create(
    struct pvr_device *device,
-   struct pvr_transfer_frag_store *store,
+   uint32_t key,
    const struct pvr_tq_shader_properties *shader_props,
    const struct pvr_transfer_frag_store_entry_data **const entry_data_out)
 {
@@ -237,11 +351,15 @@ static VkResult pvr_transfer_frag_store_entry_data_create(
    uint32_t num_usc_temps;
    VkResult result;
 
-   entry_data = ralloc(store->hash_table, __typeof__(*entry_data));
+   /* Created without the store lock held, so it's only parented to the hash
+    * table once inserted.
+    */
+   entry_data = ralloc(NULL, __typeof__(*entry_data));
    if (!entry_data)
       return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
 
    result = pvr_transfer_frag_store_entry_data_compile(device,
+                                                       key,
                                                        entry_data,
                                                        shader_props,
                                                        &num_usc_temps);
@@ -320,33 +438,155 @@ static VkResult pvr_transfer_frag_store_get_entry(
 {
    const uint32_t key =
       pvr_transfer_frag_shader_key(store->max_multisample, shader_props);
-   const struct hash_entry *entry;
+   const struct pvr_transfer_frag_store_entry_data *entry_data = NULL;
+   struct hash_entry *entry;
    VkResult result;
 
+   simple_mtx_lock(&store->mutex);
    entry = _mesa_hash_table_search(store->hash_table, to_hash_table_key(key));
+   if (entry)
+      entry_data = to_pvr_entry_data(entry);
+   simple_mtx_unlock(&store->mutex);
+
+   if (entry_data) {
+      *entry_data_out = entry_data;
+      return VK_SUCCESS;
+   }
+
+   /* Compile without holding the lock, so that looking up a shader never
+    * waits for the warm-up thread or another queue compiling a different one.
+    * If two threads race to compile the same shader, the loser's copy is
+    * discarded.
+    */
+   result = pvr_transfer_frag_store_entry_data_create(device,
+                                                      key,
+                                                      shader_props,
+                                                      &entry_data);
+   if (result != VK_SUCCESS)
+      return result;
+
+   assert(entry_data);
+
+   simple_mtx_lock(&store->mutex);
+
+   entry = _mesa_hash_table_search(store->hash_table, to_hash_table_key(key));
+   if (entry) {
+      const struct pvr_transfer_frag_store_entry_data *const loser =
+         entry_data;
+
+      entry_data = to_pvr_entry_data(entry);
+      simple_mtx_unlock(&store->mutex);
+
+      pvr_transfer_frag_store_entry_data_destroy(device, loser);
+      *entry_data_out = entry_data;
+
+      return VK_SUCCESS;
+   }
+
+   entry = _mesa_hash_table_insert(store->hash_table,
+                                   to_hash_table_key(key),
+                                   (void *)entry_data);
    if (!entry) {
-      /* Init so that gcc stops complaining. */
-      const struct pvr_transfer_frag_store_entry_data *entry_data = NULL;
-
-      result = pvr_transfer_frag_store_entry_data_create(device,
-                                                         store,
-                                                         shader_props,
-                                                         &entry_data);
-      if (result != VK_SUCCESS)
-         return result;
-
-      assert(entry_data);
-
-      entry = _mesa_hash_table_insert(store->hash_table,
-                                      to_hash_table_key(key),
-                                      (void *)entry_data);
-      if (!entry) {
-         pvr_transfer_frag_store_entry_data_destroy(device, entry_data);
-         return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+      result = vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+      goto err_unlock;
+   }
+
+   ralloc_steal(store->hash_table, (void *)entry_data);
+
+   simple_mtx_unlock(&store->mutex);
+
+   *entry_data_out = entry_data;
+
+   return VK_SUCCESS;
+
+err_unlock:
+   simple_mtx_unlock(&store->mutex);
+   pvr_transfer_frag_store_entry_data_destroy(device, entry_data);
+
+   return result;
+}
+
+DEBUG_GET_ONCE_BOOL_OPTION(transfer_warmup, "PVR_TRANSFER_WARMUP", true)
+
+/* Plain copies are mapped to raw PBE formats, which are also the only ones
+ * pvr_uscgen_tq_frag() currently supports.
+ */
+static const enum pvr_transfer_pbe_pixel_src pvr_transfer_warmup_formats[] = {
+   PVR_TRANSFER_PBE_PIXEL_SRC_RAW64,
+   PVR_TRANSFER_PBE_PIXEL_SRC_RAW128,
+};
+
+static int pvr_transfer_frag_store_warmup(void *data)
+{
+   struct pvr_transfer_frag_store *store = data;
+   struct pvr_device *device = store->device;
+
+   for (uint32_t i = 0; i < ARRAY_SIZE(pvr_transfer_warmup_formats); i++) {
+      const struct pvr_transfer_frag_store_entry_data *entry_data;
+      struct pvr_tq_shader_properties shader_props;
+      VkResult result;
+
+      if (p_atomic_read(&store->warmup_cancel))
+         return 0;
+
+      /* Set up like pvr_3d_copy_blit_core() does for an unscaled, single
+       * sampled copy from a non twiddled 2D source. Unused properties must be
+       * zero so that the key matches the one produced on the submit path.
+       */
+      memset(&shader_props, 0, sizeof(shader_props));
+      shader_props.layer_props.pbe_format = pvr_transfer_warmup_formats[i];
+      shader_props.layer_props.layer_floats = PVR_INT_COORD_SET_FLOATS_0;
+      shader_props.iterated = false;
+      shader_props.layer_props.sample = false;
+
+      /* See pvr_msaa_state() for S -> S. */
+      shader_props.full_rate = false;
+      shader_props.layer_props.sample_count = 1U;
+      shader_props.layer_props.resolve_op = PVR_RESOLVE_BLEND;
+      shader_props.layer_props.msaa = false;
+
+      shader_props.pick_component = false;
+      shader_props.layer_props.linear = false;
+
+      result = pvr_transfer_frag_store_get_entry(device,
+                                                 store,
+                                                 &shader_props,
+                                                 &entry_data);
+      if (result != VK_SUCCESS) {
+         mesa_logw("Transfer: shader warm-up failed.");
+         return 0;
       }
    }
 
-   *entry_data_out = to_pvr_entry_data(entry);
+   return 0;
+}
+
+VkResult pvr_transfer_frag_store_init(struct pvr_device *device,
+                                      struct pvr_transfer_frag_store *store)
+{
+   const struct pvr_device_info *dev_info = &device->pdevice->dev_info;
+
+   *store = (struct pvr_transfer_frag_store){
+      .device = device,
+      .max_multisample = PVR_GET_FEATURE_VALUE(dev_info, max_multisample, 1U),
+      .hash_table = _mesa_hash_table_create_u32_keys(NULL),
+   };
+
+   if (!store->hash_table)
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+
+   simple_mtx_init(&store->mutex, mtx_plain);
+
+   /* Precompile the common shaders in the background so that the first blits
+    * don't stall on shader compilation. The store is device wide, so this is
+    * only done once for all the queues.
+    */
+   if (debug_get_option_transfer_warmup()) {
+      store->warmup_running =
+         u_thread_create(&store->warmup_thread,
+                         pvr_transfer_frag_store_warmup,
+                         store) == thrd_success;
+   }
 
    return VK_SUCCESS;
 }
@@ -378,6 +618,11 @@ VkResult pvr_transfer_frag_store_get_shader_info(
 void pvr_transfer_frag_store_fini(struct pvr_device *device,
                                   struct pvr_transfer_frag_store *store)
 {
+   if (store->warmup_running) {
+      p_atomic_set(&store->warmup_cancel, true);
+      thrd_join(store->warmup_thread, NULL);
+   }
+
    hash_table_foreach_remove(store->hash_table, entry)
    {
       /* ralloc_free() in _mesa_hash_table_destroy() will free each entry's
@@ -390,4 +635,5 @@ void pvr_transfer_frag_store_fini(struct pvr_device *device,
    }
 
    _mesa_hash_table_destroy(store->hash_table, NULL);
+   simple_mtx_destroy(&store->mutex);
 }
@@ -27,19 +27,34 @@
 #include <stdint.h>
 #include <vulkan/vulkan_core.h>
 
+#include "c11/threads.h"
 #include "pvr_device_info.h"
 #include "usc/pvr_uscgen.h"
 #include "pvr_types.h"
 #include "util/hash_table.h"
+#include "util/simple_mtx.h"
 
 struct pvr_device;
 
 struct pvr_transfer_frag_store {
+   struct pvr_device *device;
+
    uint32_t max_multisample;
+
+   /* Protects hash_table, which is accessed from the submit path of every
+    * queue and from the warm-up thread. It isn't held while compiling.
+    */
+   simple_mtx_t mutex;
    /* Hash table mapping keys, produced by pvr_transfer_frag_shader_key(), to
     * pvr_transfer_frag_store_entry_data entries.
     */
    struct hash_table *hash_table;
+
+   /* Background thread precompiling commonly used shaders at device creation.
+    */
+   bool warmup_running;
+   bool warmup_cancel;
+   thrd_t warmup_thread;
 };
 
 VkResult pvr_transfer_frag_store_init(struct pvr_device *device,
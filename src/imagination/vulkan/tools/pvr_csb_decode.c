@@ -0,0 +1,286 @@
+/*
+ * Copyright © 2024 Imagination Technologies Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file pvr_csb_decode.c
+ *
+ * \brief Offline decoder for control stream captures.
+ *
+ * Decodes the captures written by the driver to PVR_CSB_CAPTURE_DIR (see
+ * pvr_dump_csb.h) with the same code as the driver's control stream dumps.
+ * The dumps are written to stderr.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pvr_bo.h"
+#include "pvr_csb.h"
+#include "pvr_device_info.h"
+#include "pvr_dump.h"
+#include "pvr_dump_csb.h"
+#include "pvr_private.h"
+#include "pvr_winsys.h"
+#include "util/list.h"
+#include "util/macros.h"
+#include "util/os_file.h"
+#include "util/u_math.h"
+
+struct pvr_csb_decode_bo {
+   struct pvr_bo bo;
+   struct pvr_winsys_bo ws_bo;
+   struct pvr_winsys_vma vma;
+};
+
+/* BOs of the capture being decoded, used in place of the driver's BO store. */
+static struct pvr_csb_decode_bo *decode_bos;
+static uint32_t decode_nr_bos;
+
+/* The decoder only ever reads BOs which are all mapped when they're loaded,
+ * so these only need to provide the BO functions it links against.
+ */
+VkResult pvr_bo_cpu_map(struct pvr_device *device, struct pvr_bo *bo)
+{
+   return bo->bo->map ? VK_SUCCESS : VK_ERROR_MEMORY_MAP_FAILED;
+}
+
+#if defined(HAVE_VALGRIND)
+VkResult pvr_bo_cpu_map_unchanged(struct pvr_device *device,
+                                  struct pvr_bo *pvr_bo)
+{
+   return pvr_bo_cpu_map(device, pvr_bo);
+}
+#endif /* defined(HAVE_VALGRIND) */
+
+void pvr_bo_cpu_unmap(struct pvr_device *device, struct pvr_bo *bo) { }
+
+struct pvr_bo *pvr_bo_store_lookup(struct pvr_device *device,
+                                   pvr_dev_addr_t addr)
+{
+   for (uint32_t i = 0; i < decode_nr_bos; i++) {
+      const struct pvr_winsys_vma *const vma = &decode_bos[i].vma;
+
+      if (addr.addr >= vma->dev_addr.addr &&
+          addr.addr - vma->dev_addr.addr < vma->size) {
+         return &decode_bos[i].bo;
+      }
+   }
+
+   return NULL;
+}
+
+static void pvr_csb_decode_bo_line(struct pvr_dump_ctx *const ctx,
+                                   const struct pvr_bo *const bo,
+                                   const uint32_t index,
+                                   const uint32_t nr_bos_log10)
+{
+   pvr_dump_println(ctx,
+                    "[%0*" PRIu32 "] " PVR_DEV_ADDR_FMT " (0x%" PRIx64
+                    " bytes)",
+                    nr_bos_log10,
+                    index,
+                    bo->vma->dev_addr.addr,
+                    bo->vma->size);
+}
+
+bool pvr_bo_store_dump(struct pvr_device *device, FILE *file)
+{
+   const uint32_t nr_bos_log10 = u32_dec_digits(decode_nr_bos);
+   struct pvr_dump_ctx ctx;
+
+   pvr_dump_begin(&ctx, file, "CAPTURED BOS", 1);
+
+   pvr_dump_println(&ctx, "Dumping %" PRIu32 " captured BOs...", decode_nr_bos);
+
+   pvr_dump_indent(&ctx);
+   for (uint32_t i = 0; i < decode_nr_bos; i++)
+      pvr_csb_decode_bo_line(&ctx, &decode_bos[i].bo, i, nr_bos_log10);
+   pvr_dump_dedent(&ctx);
+
+   return pvr_dump_end(&ctx);
+}
+
+void pvr_bo_list_dump(struct pvr_dump_ctx *ctx,
+                      const struct list_head *bo_list,
+                      uint32_t nr_bos)
+{
+   const uint32_t real_nr_bos = nr_bos ? nr_bos : list_length(bo_list);
+   const uint32_t nr_bos_log10 = u32_dec_digits(real_nr_bos);
+   uint32_t bo_idx = 0;
+
+   list_for_each_entry (struct pvr_bo, bo, bo_list, link)
+      pvr_csb_decode_bo_line(ctx, bo, bo_idx++, nr_bos_log10);
+}
+
+static bool pvr_csb_decode_load_bos(char *const data,
+                                    const size_t size,
+                                    const struct pvr_csb_capture_header *header)
+{
+   size_t offset = sizeof(*header);
+
+   decode_bos = calloc(header->nr_bos, sizeof(*decode_bos));
+   if (!decode_bos)
+      return false;
+
+   for (uint32_t i = 0; i < header->nr_bos; i++) {
+      struct pvr_csb_decode_bo *const decode_bo = &decode_bos[i];
+      struct pvr_csb_capture_bo capture_bo;
+
+      if (size - offset < sizeof(capture_bo))
+         return false;
+
+      memcpy(&capture_bo, data + offset, sizeof(capture_bo));
+      offset += sizeof(capture_bo);
+
+      if (size - offset < capture_bo.size)
+         return false;
+
+      decode_bo->ws_bo.map = data + offset;
+      decode_bo->ws_bo.size = capture_bo.size;
+
+      decode_bo->vma.bo = &decode_bo->ws_bo;
+      decode_bo->vma.dev_addr = PVR_DEV_ADDR(capture_bo.dev_addr);
+      decode_bo->vma.size = capture_bo.size;
+      decode_bo->vma.mapped_size = capture_bo.size;
+
+      decode_bo->bo.bo = &decode_bo->ws_bo;
+      decode_bo->bo.vma = &decode_bo->vma;
+      decode_bo->bo.ref_count = 1;
+
+      offset += capture_bo.size;
+      decode_nr_bos++;
+   }
+
+   return true;
+}
+
+static bool pvr_csb_decode_file(const char *const path)
+{
+   struct pvr_csb_capture_header header;
+   struct pvr_physical_device *pdevice;
+   struct pvr_winsys_heap pds_heap = { 0 };
+   struct pvr_device *device;
+   struct pvr_csb csb = { 0 };
+   bool ret = false;
+   size_t size;
+   char *data;
+
+   data = os_read_file(path, &size);
+   if (!data) {
+      fprintf(stderr, "Failed to read file \"%s\".\n", path);
+      return false;
+   }
+
+   if (size < sizeof(header)) {
+      fprintf(stderr, "\"%s\" is not a control stream capture.\n", path);
+      goto err_free_data;
+   }
+
+   memcpy(&header, data, sizeof(header));
+
+   if (memcmp(header.magic, PVR_CSB_CAPTURE_MAGIC, sizeof(header.magic)) ||
+       header.nr_stream_bos > header.nr_bos) {
+      fprintf(stderr, "\"%s\" is not a control stream capture.\n", path);
+      goto err_free_data;
+   }
+
+   /* The dump only needs the device info and PDS heap base from the device,
+    * everything else comes from the capture.
+    */
+   pdevice = calloc(1, sizeof(*pdevice));
+   device = calloc(1, sizeof(*device));
+   if (!pdevice || !device) {
+      fprintf(stderr, "Failed to allocate device.\n");
+      goto err_free_device;
+   }
+
+   if (pvr_device_info_init(&pdevice->dev_info, header.bvnc)) {
+      fprintf(stderr,
+              "\"%s\": unsupported BVNC %u.%u.%u.%u.\n",
+              path,
+              PVR_BVNC_UNPACK_B(header.bvnc),
+              PVR_BVNC_UNPACK_V(header.bvnc),
+              PVR_BVNC_UNPACK_N(header.bvnc),
+              PVR_BVNC_UNPACK_C(header.bvnc));
+      goto err_free_device;
+   }
+
+   pds_heap.base_addr = PVR_DEV_ADDR(header.pds_heap_base);
+
+   device->pdevice = pdevice;
+   device->heaps.pds_heap = &pds_heap;
+
+   if (!pvr_csb_decode_load_bos(data, size, &header)) {
+      fprintf(stderr, "\"%s\": truncated capture.\n", path);
+      goto err_free_bos;
+   }
+
+   csb.device = device;
+   csb.status = header.status;
+   csb.stream_type = header.stream_type;
+   list_inithead(&csb.pvr_bo_list);
+
+   for (uint32_t i = 0; i < header.nr_stream_bos; i++)
+      list_addtail(&decode_bos[i].bo.link, &csb.pvr_bo_list);
+
+   pvr_csb_dump(&csb, header.frame_num, header.job_num);
+
+   ret = true;
+
+err_free_bos:
+   free(decode_bos);
+   decode_bos = NULL;
+   decode_nr_bos = 0;
+
+err_free_device:
+   free(device);
+   free(pdevice);
+
+err_free_data:
+   free(data);
+
+   return ret;
+}
+
+int main(int argc, char *argv[])
+{
+   bool ret = true;
+
+   if (argc < 2) {
+      printf("Decodes PowerVR control stream captures.\n");
+      printf("Usage: %s <capture file>...\n", argv[0]);
+      return 1;
+   }
+
+   /* Don't capture the streams again while decoding them. */
+   unsetenv("PVR_CSB_CAPTURE_DIR");
+
+   for (int i = 1; i < argc; i++)
+      ret &= pvr_csb_decode_file(argv[i]);
+
+   return ret ? 0 : 1;
+}